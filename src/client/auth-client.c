@@ -12,6 +12,9 @@
 #include <assert.h>
 #include <signal.h>
 #include <semaphore.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
 
 #include "options.h"
 #include "user.h"
@@ -19,7 +22,10 @@
 
 #include "../share/utils.h"
 #include "../share/shmem.h"
+#include "../share/watch.h"
 #include "../share/protocol.h"
+#include "../share/fdpass.h"
+#include "../share/shard.h"
 
 /**
  * @brief Program name.
@@ -37,6 +43,11 @@ volatile sig_atomic_t running = true;
  */
 void *shmem = NULL;
 
+/**
+ * @brief The size of the shared memory.
+ */
+size_t shmlen = 0;
+
 /**
  * @brief The file descriptor used to open the shared memory.
  */
@@ -55,11 +66,47 @@ sem_t *sem1 = NULL;
 sem_t *sem2 = NULL;
 
 /**
- * @brief The client semaphore.
- * @details This semaphore is used to make sure only one client can communicate with the server at a time.
+ * @brief The third server semaphore.
+ * @details This semaphore is used to tell the server that a client reached the head of its lane.
  */
 sem_t *sem3 = NULL;
 
+/**
+ * @brief The client semaphores of the lanes.
+ * @details These semaphores are used to make sure only one client per lane waits for the shared memory at a time.
+ */
+sem_t *lane_queues[LANES] = { NULL };
+
+/**
+ * @brief The semaphores granting the shared memory to the lanes.
+ * @details These semaphores are used on the client side to wait for the turn of its lane.
+ */
+sem_t *lane_grants[LANES] = { NULL };
+
+/**
+ * @brief The semaphores admitting clients to the lanes.
+ * @details These semaphores are used to turn clients away at once if their lane is full.
+ */
+sem_t *lane_admits[LANES] = { NULL };
+
+/**
+ * @brief The socket connected to the server, if the socket transport is used.
+ * @details The socket is negative if the shared memory is used.
+ */
+int transport_sock = -1;
+
+/**
+ * @brief The socket connected to the read-only replica, if one is used.
+ * @details The socket is negative if secrets are read from the server.
+ */
+int replica_sock = -1;
+
+/**
+ * @brief The watch table shared by the server.
+ * @details The table is mapped read-only, and is `NULL` if the server does not offer it.
+ */
+uint32_t *watch_table = NULL;
+
 /**
  * @brief Signal handler for the client.
  * @details The `running` variable is set to `false` on `SIGTERM` or `SIGINT` signal interruption.
@@ -78,17 +125,35 @@ static void cleanup(void)
 {
 	int errind;
 
+	// cleanup read-only replica
+	if (replica_sock >= 0)
+		close(replica_sock);
+
+	// cleanup socket transport
+	if (transport_sock >= 0) {
+		close(transport_sock);
+		free(shmem);
+	}
+
 	// cleanup shared memory
 	if (memfd >= 0) {
-		errind = close_shared_memory(SHM_NAME, SHM_LEN, memfd, false);
+		errind = close_shared_memory(shard_name(SHM_NAME), shmlen, memfd, false);
 		if (errind != 0)
 			print_error("failed closing shared memory");
 	}
 
+	watch_close(watch_table, false);
+
 	// cleanup semaphores
 	sem_cleanup(sem1, NULL);
 	sem_cleanup(sem2, NULL);
 	sem_cleanup(sem3, NULL);
+
+	for (size_t i = 0; i < LANES; i++) {
+		sem_cleanup(lane_queues[i], NULL);
+		sem_cleanup(lane_grants[i], NULL);
+		sem_cleanup(lane_admits[i], NULL);
+	}
 }
 
 /**
@@ -100,8 +165,15 @@ static void print_menu(void)
 	printf("Commands:\n");
 	printf("  1) write secret\n");
 	printf("  2) read secret\n");
-	printf("  3) logout\n");
-	printf("Please select a command (1-3): ");
+	printf("  3) write key\n");
+	printf("  4) read key\n");
+	printf("  5) delete key\n");
+	printf("  6) list keys\n");
+	printf("  7) list users\n");
+	printf("  8) write secret if unchanged\n");
+	printf("  9) watch secret\n");
+	printf(" 10) logout\n");
+	printf("Please select a command (1-10): ");
 	fflush(stdout);
 }
 
@@ -113,23 +185,25 @@ static void print_menu(void)
 static int get_next_instruction(void)
 {
 	int instruction = 0;
+	char *line = NULL;
+	size_t len_alloc = 0;
 
-	while (instruction < 1 || instruction > 3) {
+	while (instruction < 1 || instruction > 10) {
 		// signal might have arrived
-		if (!running)
+		if (!running) {
+			free(line);
 			return -1;
+		}
 
 		print_menu();
-		char tmp_instr;
-		tmp_instr = getchar();
 
-		if (tmp_instr == EOF)
+		if (getline(&line, &len_alloc, stdin) == -1)
 			continue;
 
-		instruction = tmp_instr - '0';
-		clear_buffer(stdin);
+		instruction = strtol(line, NULL, 10);
 	}
 
+	free(line);
 	return instruction;
 }
 
@@ -183,21 +257,68 @@ int main(int argc, char *argv[])
 	options_t options;
 	parse_arguments(argc, argv, &options);
 
-	sem1 = sem_open(SEM_SERVER1, 0);
-	if (sem1 == SEM_FAILED)
-		print_error_exit("failed opening semaphore");
+	// requests go to the server of the shard the user belongs to
+	unsigned shards = cluster_shards();
+	shard_select(shard_of(options.username, shards), shards);
+
+	if (options.transport) {
+		transport_sock = unix_connect(shard_name(TRANSPORT_SOCKET_NAME), SOCK_SEQPACKET);
+		if (transport_sock < 0)
+			print_error_plain_exit("server is not available");
+
+		// the packet buffer is private, with room for secrets of the default size
+		shmlen = SHM_ARENA_OFFSET + SECRET_CAP_DEFAULT + 1;
+		shmem = calloc(shmlen, 1);
+		if (shmem == NULL)
+			print_error_exit("failed allocating packet buffer");
+
+		// the server serves all reads if the replica is not available
+		if (options.replica >= 0) {
+			char name[sizeof(REPLICA_SOCKET_FORMAT) + 16];
+			snprintf(name, sizeof(name), REPLICA_SOCKET_FORMAT, (unsigned) options.replica);
+			replica_sock = unix_connect(shard_name(name), SOCK_SEQPACKET);
+		}
+	} else {
+		sem1 = sem_open(shard_name(SEM_SERVER1), 0);
+		if (sem1 == SEM_FAILED)
+			print_error_exit("failed opening semaphore");
+
+		sem2 = sem_open(shard_name(SEM_SERVER2), 0);
+		if (sem2 == SEM_FAILED)
+			print_error_exit("failed opening semaphore");
+
+		sem3 = sem_open(shard_name(SEM_SERVER3), 0);
+		if (sem3 == SEM_FAILED)
+			print_error_exit("failed opening semaphore");
+
+		const char *queue_names[LANES] = { SEM_CLIENT1, SEM_CLIENT2 };
+		const char *grant_names[LANES] = { SEM_GRANT1, SEM_GRANT2 };
+		const char *admit_names[LANES] = { SEM_ADMIT1, SEM_ADMIT2 };
+
+		for (size_t i = 0; i < LANES; i++) {
+			lane_queues[i] = sem_open(shard_name(queue_names[i]), 0);
+			if (lane_queues[i] == SEM_FAILED)
+				print_error_exit("failed opening semaphore");
+
+			lane_grants[i] = sem_open(shard_name(grant_names[i]), 0);
+			if (lane_grants[i] == SEM_FAILED)
+				print_error_exit("failed opening semaphore");
+
+			lane_admits[i] = sem_open(shard_name(admit_names[i]), 0);
+			if (lane_admits[i] == SEM_FAILED)
+				print_error_exit("failed opening semaphore");
+		}
 
-	sem2 = sem_open(SEM_SERVER2, 0);
-	if (sem2 == SEM_FAILED)
-		print_error_exit("failed opening semaphore");
+		memfd = create_shared_memory(shard_name(SHM_NAME), &shmlen, false);
+		if (memfd < 0)
+			print_error_exit("failed creating shared memory");
 
-	sem3 = sem_open(SEM_CLIENT1, 0);
-	if (sem3 == SEM_FAILED)
-		print_error_exit("failed opening semaphore");
+		if (shmlen <= SHM_ARENA_OFFSET)
+			print_error_plain_exit("server is not available");
+	}
 
-	memfd = create_shared_memory(SHM_NAME, SHM_LEN, false);
-	if (memfd < 0)
-		print_error_exit("failed creating shared memory");
+	// watching secrets is optional
+	watch_table = watch_open(false);
 
 	if (options.mode == CMD_REGISTER) {
 		errind = register_user(&options);
@@ -210,13 +331,26 @@ int main(int argc, char *argv[])
 		}
 	} else if (options.mode == CMD_LOGIN) {
 		char session_id[SESSION_ID_SIZE + 1];
-		errind = login_user(&options, session_id);
+		char token[TOKEN_SIZE + 1];
+		errind = login_user(&options, session_id, token);
 
 		if (errind) {
 			fprintf(stderr, "Login failed.\n");
 			exit(EXIT_FAILURE);
 		} else {
 			fprintf(stderr, "Login successful.\n");
+			fprintf(stderr, "Resumption token: %s\n", token);
+			run_main_loop(&options, session_id);
+		}
+	} else if (options.mode == CMD_RESUME) {
+		char session_id[SESSION_ID_SIZE + 1];
+		errind = resume_user(&options, session_id);
+
+		if (errind) {
+			fprintf(stderr, "Resumption failed.\n");
+			exit(EXIT_FAILURE);
+		} else {
+			fprintf(stderr, "Resumption successful.\n");
 			run_main_loop(&options, session_id);
 		}
 	} else {
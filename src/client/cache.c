@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for the secret cache.
+ * @details The cache keeps the secret last read from the server. An entry is fresh as long as the counter of its bucket in the watch table did not change, which the client checks without a round trip to the server.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cache.h"
+
+/**
+ * @brief The watch table shared by the server.
+ * @details This global variable is assumed to be available when using this module. It is `NULL` if the server does not offer it.
+ */
+extern uint32_t *watch_table;
+
+const char *cache_lookup(cache_t *cache, const char *username, uint64_t *version)
+{
+	bool fresh = watch_table != NULL &&
+		cache->secret != NULL &&
+		strncmp(cache->username, username, MAX_USERNAME_LEN) == 0 &&
+		__atomic_load_n(&watch_table[cache->bucket], __ATOMIC_ACQUIRE) == cache->sequence &&
+		(cache->expires == 0 || cache->expires > time(NULL));
+
+	if (!fresh) {
+		cache->misses += 1;
+		return NULL;
+	}
+
+	cache->hits += 1;
+	*version = cache->version;
+	return cache->secret;
+}
+
+void cache_store(cache_t *cache, const char *username, const char *secret, uint64_t version, uint32_t bucket, uint32_t sequence, uint32_t expires)
+{
+	cache_clear(cache);
+
+	if (bucket >= WATCH_BUCKETS)
+		return;
+
+	cache->secret = strdup(secret);
+	if (cache->secret == NULL)
+		return;
+
+	strncpy(cache->username, username, MAX_USERNAME_LEN);
+	cache->username[MAX_USERNAME_LEN] = '\0';
+	cache->version = version;
+	cache->bucket = bucket;
+	cache->sequence = sequence;
+	cache->expires = expires;
+}
+
+void cache_clear(cache_t *cache)
+{
+	free(cache->secret);
+	cache->secret = NULL;
+}
+
+void cache_print_stats(cache_t *cache, FILE *fp)
+{
+	unsigned long lookups = cache->hits + cache->misses;
+	double rate = 0.0;
+
+	if (lookups > 0)
+		rate = (double) cache->hits / lookups;
+
+	fprintf(fp, "cache_hits: %lu\n", cache->hits);
+	fprintf(fp, "cache_misses: %lu\n", cache->misses);
+	fprintf(fp, "cache_hit_rate: %f\n", rate);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for the secret cache.
+ * @details The cache keeps the secret last read from the server. An entry is fresh as long as the counter of its bucket in the watch table did not change, which the client checks without a round trip to the server.
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../share/protocol.h"
+
+/**
+ * @brief Representation of the secret cache.
+ */
+typedef struct {
+	char username[MAX_USERNAME_LEN + 1]; ///< Username the cached secret belongs to.
+	char *secret; ///< The cached secret, `NULL` if the cache is empty.
+	uint64_t version; ///< Version of the cached secret.
+	uint32_t bucket; ///< Bucket of the watch table of the user.
+	uint32_t sequence; ///< Value of the counter of the bucket when the secret was read.
+	uint32_t expires; ///< Time in seconds since the epoch at which the secret expires, `0` if it does not.
+	unsigned long hits; ///< Number of lookups answered from the cache.
+	unsigned long misses; ///< Number of lookups that had to go to the server.
+} cache_t;
+
+/**
+ * @brief Look up the secret of the user `username`.
+ * @details This function makes use of the global variable `watch_table`.
+ * @param cache The cache to search.
+ * @param username The username to look for.
+ * @param version Set to the version of the secret on a hit.
+ * @return The cached secret, or `NULL` if it is missing or stale.
+ */
+const char *cache_lookup(cache_t *cache, const char *username, uint64_t *version);
+
+/**
+ * @brief Store the secret of the user `username`.
+ * @param cache The cache to modify.
+ * @param username The username the secret belongs to.
+ * @param secret The secret to store, which is copied.
+ * @param version The version of the secret.
+ * @param bucket The bucket of the watch table of the user.
+ * @param sequence The value of the counter of the bucket when the secret was read.
+ * @param expires Time in seconds since the epoch at which the secret expires, `0` if it does not.
+ */
+void cache_store(cache_t *cache, const char *username, const char *secret, uint64_t version, uint32_t bucket, uint32_t sequence, uint32_t expires);
+
+/**
+ * @brief Remove the cached secret.
+ * @param cache The cache to clear.
+ */
+void cache_clear(cache_t *cache);
+
+/**
+ * @brief Print the hit rate of the cache.
+ * @param cache The cache to consider.
+ * @param fp The stream to print to.
+ */
+void cache_print_stats(cache_t *cache, FILE *fp);
+
+#endif
@@ -3,18 +3,29 @@
  * @author eikendev, https://eiken.dev/
  * @date 2018-01-04
  * @brief This module contains function definitions to handle user instructions.
- * @details The user can instruct to write a new secret or to read the stored one.
+ * @details The user can instruct to write a new secret or to read the stored one, to manage named secrets, and to list names.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
 #include <assert.h>
 #include <signal.h>
 
 #include "user.h"
+#include "cache.h"
 
 #include "../share/utils.h"
 #include "../share/protocol.h"
+#include "../share/watch.h"
+
+/**
+ * @brief Time in milliseconds to wait for a change before checking the secret again.
+ */
+#define WATCH_TIMEOUT 30000
 
 /**
  * @brief Indicator for the program to shut down.
@@ -22,14 +33,47 @@
  */
 extern volatile sig_atomic_t running;
 
+/**
+ * @brief The size of the shared memory.
+ * @details This global variable is assumed to be available when using this module.
+ */
+extern size_t shmlen;
+
+/**
+ * @brief The watch table shared by the server.
+ * @details This global variable is assumed to be available when using this module. It is `NULL` if the server does not offer it.
+ */
+extern uint32_t *watch_table;
+
+/**
+ * @brief The secret cache.
+ */
+static cache_t cache;
+
+/**
+ * @brief Version of the secret when it was last read.
+ */
+static uint64_t read_version;
+
+/**
+ * @brief Whether the secret has been read yet.
+ */
+static bool read_done = false;
+
 /**
  * @brief Write a new secret to the database.
  * @details This function prompts the user to input the new secret and notifies the server about the update.
  * @param options The programs configuration.
  * @param session_id The session id retrieved when logging in on the server.
+ * @param conditional Whether the secret is only written if it did not change since it was last read.
  */
-static void handle_secret_write(options_t *options, char *session_id)
+static void handle_secret_write(options_t *options, char *session_id, bool conditional)
 {
+	if (conditional && !read_done) {
+		fprintf(stderr, "Please read your secret first.\n");
+		return;
+	}
+
 	printf("New secret: ");
 	fflush(stdout);
 
@@ -39,13 +83,15 @@ static void handle_secret_write(options_t *options, char *session_id)
 
 	if (len_line == -1) {
 		fprintf(stderr, "Could not read your input.\n");
-	} else if (len_line > MAX_SECRET_LEN) {
+	} else if ((size_t) len_line >= shmlen - SHM_ARENA_OFFSET) {
 		fprintf(stderr, "Your secret is too long.\n");
 	} else {
-		line[MAX_SECRET_LEN] = '\0';
-		int errind = write_secret(options, session_id, line);
+		str_strip(line);
+		int errind = write_secret(options, session_id, line, conditional ? &read_version : NULL);
 
-		if (errind != 0)
+		if (errind == 2)
+			fprintf(stderr, "Your secret was changed since you read it.\n");
+		else if (errind != 0)
 			fprintf(stderr, "Could not write your new secret.\n");
 	}
 
@@ -55,24 +101,221 @@ static void handle_secret_write(options_t *options, char *session_id)
 
 /**
  * @brief Read the secret stored in the database.
- * @details This function requests the secret and prints it to `stdout`.
+ * @details This function requests the secret and prints it to `stdout`. If caching is enabled, the secret is only requested if the cached copy is stale.
  * @param options The programs configuration.
  * @param session_id The session id retrieved when logging in on the server.
  */
 static void handle_secret_read(options_t *options, char *session_id)
 {
-	char secret[MAX_SECRET_LEN + 1];
-	int errind = read_secret(options, session_id, secret);
+	if (options->cache) {
+		const char *cached = cache_lookup(&cache, options->username, &read_version);
+
+		if (cached != NULL) {
+			printf("Your secret: %s\n", cached);
+			printf("Version: %llu\n", (unsigned long long) read_version);
+			read_done = true;
+			return;
+		}
+	}
+
+	char *secret;
+	secret_meta_t meta;
+	int errind = read_secret(options, session_id, &secret, &meta);
 
-	if (errind == 0)
+	if (errind == 0) {
+		read_version = meta.version;
 		printf("Your secret: %s\n", secret);
-	else
+		printf("Version: %llu\n", (unsigned long long) read_version);
+		read_done = true;
+
+		if (meta.replica)
+			printf("Staleness: %u ms\n", meta.staleness);
+
+		if (options->cache)
+			cache_store(&cache, options->username, secret, meta.version, meta.bucket, meta.sequence, meta.expires);
+
+		free(secret);
+	} else {
 		fprintf(stderr, "Could not read the secret.\n");
+	}
+}
+
+/**
+ * @brief Wait until the secret changes.
+ * @details The secret is watched at the version it had when it was last read, and printed once it changed. While waiting, the client sleeps on the watch table instead of polling the server.
+ * @param options The programs configuration.
+ * @param session_id The session id retrieved when logging in on the server.
+ */
+static void handle_watch(options_t *options, char *session_id)
+{
+	if (watch_table == NULL) {
+		fprintf(stderr, "The server does not offer watching secrets.\n");
+		return;
+	}
+
+	if (!read_done) {
+		fprintf(stderr, "Please read your secret first.\n");
+		return;
+	}
+
+	while (running) {
+		uint32_t bucket;
+		uint32_t sequence;
+		int errind = watch_secret(options, session_id, &read_version, &bucket, &sequence);
+
+		if (errind == 2) {
+			handle_secret_read(options, session_id);
+			return;
+		} else if (errind != 0) {
+			fprintf(stderr, "Could not watch your secret.\n");
+			return;
+		}
+
+		// a wake-up may be caused by another user in the same bucket
+		errind = watch_wait(&watch_table[bucket], sequence, WATCH_TIMEOUT);
+		if (errind != 0 && errno != ETIMEDOUT && errno != EINTR) {
+			fprintf(stderr, "Could not watch your secret.\n");
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Prompt the user for the name of a secret.
+ * @return The name without surrounding whitespace, which has to be freed by the caller, or `NULL` on failure.
+ */
+static char *prompt_key(void)
+{
+	printf("Key: ");
+	fflush(stdout);
+
+	char *line = NULL;
+	size_t len_alloc = 0;
+	ssize_t len_line = getline(&line, &len_alloc, stdin);
+
+	if (len_line == -1) {
+		fprintf(stderr, "Could not read your input.\n");
+		free(line);
+		return NULL;
+	}
+
+	str_strip(line);
+
+	if (strlen(line) == 0 || strlen(line) > MAX_KEY_LEN) {
+		fprintf(stderr, "Your key must have 1 to %d characters.\n", MAX_KEY_LEN);
+		free(line);
+		return NULL;
+	}
+
+	return line;
+}
+
+/**
+ * @brief Write a named secret to the database.
+ * @details This function prompts the user to input the name and the new value and notifies the server about the update.
+ * @param options The programs configuration.
+ * @param session_id The session id retrieved when logging in on the server.
+ */
+static void handle_key_write(options_t *options, char *session_id)
+{
+	char *key = prompt_key();
+	if (key == NULL)
+		return;
+
+	printf("New value: ");
+	fflush(stdout);
+
+	char *line = NULL;
+	size_t len_alloc = 0;
+	ssize_t len_line = getline(&line, &len_alloc, stdin);
+
+	if (len_line == -1) {
+		fprintf(stderr, "Could not read your input.\n");
+	} else if ((size_t) len_line >= shmlen - SHM_ARENA_OFFSET) {
+		fprintf(stderr, "Your value is too long.\n");
+	} else {
+		str_strip(line);
+		int errind = write_key(options, session_id, key, line);
+
+		if (errind != 0)
+			fprintf(stderr, "Could not write the key.\n");
+	}
+
+	free(line);
+	free(key);
+}
+
+/**
+ * @brief Read a named secret stored in the database.
+ * @details This function requests the secret and prints it to `stdout`.
+ * @param options The programs configuration.
+ * @param session_id The session id retrieved when logging in on the server.
+ */
+static void handle_key_read(options_t *options, char *session_id)
+{
+	char *key = prompt_key();
+	if (key == NULL)
+		return;
+
+	char *secret;
+	int errind = read_key(options, session_id, key, &secret);
+
+	if (errind == 0) {
+		printf("Value of %s: %s\n", key, secret);
+		free(secret);
+	} else {
+		fprintf(stderr, "Could not read the key.\n");
+	}
+
+	free(key);
+}
+
+/**
+ * @brief Delete a named secret stored in the database.
+ * @param options The programs configuration.
+ * @param session_id The session id retrieved when logging in on the server.
+ */
+static void handle_key_delete(options_t *options, char *session_id)
+{
+	char *key = prompt_key();
+	if (key == NULL)
+		return;
+
+	int errind = delete_key(options, session_id, key);
+
+	if (errind != 0)
+		fprintf(stderr, "Could not delete the key.\n");
+
+	free(key);
+}
+
+/**
+ * @brief List usernames or names of secrets.
+ * @details The names are requested one page at a time, so that the server is never held for longer than a page.
+ * @param options The programs configuration.
+ * @param session_id The session id retrieved when logging in on the server.
+ * @param target What to list.
+ */
+static void handle_scan(options_t *options, char *session_id, enum scan_e target)
+{
+	char cursor[MAX_CURSOR_LEN + 1] = "";
+	char names[SCAN_PAGE_SIZE][MAX_CURSOR_LEN + 1];
+	uint32_t count;
+
+	do {
+		if (scan_names(options, session_id, target, cursor, names, &count) != 0) {
+			fprintf(stderr, "Could not list the names.\n");
+			return;
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+			printf("  %s\n", names[i]);
+	} while (cursor[0] != '\0');
 }
 
 /**
  * @brief Logout of the server.
- * @details This function notifies the server about the user logout.
+ * @details This function notifies the server about the user logout. If caching is enabled, the hit rate of the cache is printed to `stderr`.
  * @param options The programs configuration.
  * @param session_id The session id retrieved when logging in on the server.
  */
@@ -83,6 +326,11 @@ static void handle_logout(options_t *options, char *session_id)
 	if (errind != 0)
 		fprintf(stderr, "Could not logout correctly.\n");
 
+	if (options->cache) {
+		cache_print_stats(&cache, stderr);
+		cache_clear(&cache);
+	}
+
 	running = false;
 }
 
@@ -90,12 +338,33 @@ void handle_instruction(int instruction, options_t *options, char *session_id)
 {
 	switch (instruction) {
 	case 1:
-		handle_secret_write(options, session_id);
+		handle_secret_write(options, session_id, false);
 		break;
 	case 2:
 		handle_secret_read(options, session_id);
 		break;
 	case 3:
+		handle_key_write(options, session_id);
+		break;
+	case 4:
+		handle_key_read(options, session_id);
+		break;
+	case 5:
+		handle_key_delete(options, session_id);
+		break;
+	case 6:
+		handle_scan(options, session_id, SCAN_KEYS);
+		break;
+	case 7:
+		handle_scan(options, session_id, SCAN_USERS);
+		break;
+	case 8:
+		handle_secret_write(options, session_id, true);
+		break;
+	case 9:
+		handle_watch(options, session_id);
+		break;
+	case 10:
 		handle_logout(options, session_id);
 		break;
 	default:
@@ -3,7 +3,7 @@
  * @author eikendev, https://eiken.dev/
  * @date 2018-01-04
  * @brief This module contains function declarations to handle user instructions.
- * @details The user can instruct to write a new secret or to read the stored one.
+ * @details The user can instruct to write a new secret or to read the stored one, to manage named secrets, and to list names.
  */
 
 #ifndef __INSTRUCTION_H__
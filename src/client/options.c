@@ -13,6 +13,8 @@
 
 #include "options.h"
 
+#include "../share/protocol.h"
+
 /**
  * @brief Program name.
  * @details This variable must be set on program start.
@@ -25,7 +27,7 @@ extern char *progname;
  */
 static void usage(void)
 {
-	fprintf(stderr, "Usage: %s { -r | -l } <username> <password>\n", progname);
+	fprintf(stderr, "Usage: %s { -r | -l | -t } [ -e ttl ] [ -c ] [ -u ] [ -R index ] [ -w wait ] <username> { <password> | <token> }\n", progname);
 	exit(EXIT_FAILURE);
 }
 
@@ -35,9 +37,25 @@ void parse_arguments(int argc, char *argv[], options_t *options)
 
 	bool parsed_register = false;
 	bool parsed_login = false;
+	bool parsed_resume = false;
+	bool parsed_ttl = false;
+	bool parsed_cache = false;
+	bool parsed_transport = false;
+	bool parsed_replica = false;
+	bool parsed_wait = false;
+
+	options->ttl = 0;
+	options->cache = false;
+	options->transport = false;
+	options->replica = -1;
+	options->wait = WAIT_DEFAULT;
 
 	int c;
-	while ((c = getopt(argc, argv, "rl")) != -1) {
+	char *end;
+	unsigned long ttl;
+	unsigned long index;
+	unsigned long wait;
+	while ((c = getopt(argc, argv, "rlte:cuR:w:")) != -1) {
 		switch (c) {
 		case 'r':
 			if (parsed_register)
@@ -53,18 +71,80 @@ void parse_arguments(int argc, char *argv[], options_t *options)
 			options->mode = CMD_LOGIN;
 			parsed_login = true;
 			break;
+		case 't':
+			if (parsed_resume)
+				usage();
+
+			options->mode = CMD_RESUME;
+			parsed_resume = true;
+			break;
+		case 'e':
+			if (parsed_ttl)
+				usage();
+
+			ttl = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' || ttl == 0 || ttl > UINT32_MAX)
+				usage();
+
+			options->ttl = ttl;
+			parsed_ttl = true;
+			break;
+		case 'c':
+			if (parsed_cache)
+				usage();
+
+			options->cache = true;
+			parsed_cache = true;
+			break;
+		case 'u':
+			if (parsed_transport)
+				usage();
+
+			options->transport = true;
+			parsed_transport = true;
+			break;
+		case 'R':
+			if (parsed_replica)
+				usage();
+
+			index = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' || index >= MAX_REPLICAS)
+				usage();
+
+			// writes and sessions still go to the server over the socket transport
+			options->replica = index;
+			options->transport = true;
+			parsed_replica = true;
+			break;
+		case 'w':
+			if (parsed_wait)
+				usage();
+
+			wait = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' || wait > UINT32_MAX)
+				usage();
+
+			options->wait = wait;
+			parsed_wait = true;
+			break;
 		default:
 			usage();
 		}
 	}
 
-	if ((parsed_register && parsed_login) ||
-		(!parsed_register && !parsed_login))
+	if (parsed_register + parsed_login + parsed_resume != 1)
 		usage();
 
 	if (argc - optind != 2)
 		usage();
 
 	options->username = argv[optind++];
-	options->password = argv[optind++];
+
+	if (options->mode == CMD_RESUME) {
+		options->password = NULL;
+		options->token = argv[optind++];
+	} else {
+		options->password = argv[optind++];
+		options->token = NULL;
+	}
 }
@@ -9,13 +9,22 @@
 #ifndef __OPTIONS_H__
 #define __OPTIONS_H__
 
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief The default time in milliseconds to wait for the server to accept a request.
+ */
+#define WAIT_DEFAULT 5000
+
 /**
  * @brief Program modes.
  * @details This enum is used to specify whether to login or to register.
  */
 typedef enum {
 	CMD_REGISTER, ///< Register and exit.
-	CMD_LOGIN ///< Login and wait for instructions.
+	CMD_LOGIN, ///< Login and wait for instructions.
+	CMD_RESUME ///< Resume a session and wait for instructions.
 } umode_t;
 
 /**
@@ -25,12 +34,18 @@ typedef enum {
 typedef struct {
 	char *username; ///< Username used for login or registration.
 	char *password; ///< Password used for login or registration.
+	char *token; ///< Resumption token used to resume a session.
 	umode_t mode; ///< Specifies whether to login or to register.
+	uint32_t ttl; ///< Lifetime in seconds of the secrets written, `0` if they do not expire.
+	bool cache; ///< Whether to cache the secret read.
+	bool transport; ///< Whether to use the socket transport instead of the shared memory.
+	int replica; ///< Index of the read-only replica to read the secret from, `-1` if none.
+	uint32_t wait; ///< Time in milliseconds to wait for the server to accept a request, `0` to wait indefinitely.
 } options_t;
 
 /**
  * @brief Parse program arguments for options.
- * @details First, the POSIX-compliant `getopt()` is used to parse named options, whereupon positional arguments are read. If the program was called violating the synopsis, a usage message is printed and the program is terminated.
+ * @details First, the POSIX-compliant `getopt()` is used to parse named options, whereupon positional arguments are read. The second positional argument is the resumption token when resuming, and the password otherwise. Option `-e` sets the lifetime of the secrets written, option `-c` enables the secret cache, option `-u` selects the socket transport, option `-R` reads the secret from a read-only replica, which implies `-u`, and option `-w` limits the time to wait for the server to accept a request. If the program was called violating the synopsis, a usage message is printed and the program is terminated.
  * @param argc The cardinality of `argv`.
  * @param argv The program argument vector.
  * @param options The options to store the parsed arguments in.
@@ -9,15 +9,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <semaphore.h>
+#include <time.h>
+#include <poll.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
 
 #include "user.h"
 #include "utils.h"
 
 #include "../share/utils.h"
 #include "../share/protocol.h"
+#include "../share/fdpass.h"
+#include "../share/shard.h"
 
 /**
  * @brief The memory shared between the server and the clients.
@@ -25,6 +34,12 @@
  */
 extern void *shmem;
 
+/**
+ * @brief The size of the shared memory.
+ * @details This variable is assumed to be available when functions of this module are used.
+ */
+extern size_t shmlen;
+
 /**
  * @brief The first server semaphore.
  * @details This semaphore is assumed to be available when functions of this module are used.
@@ -38,33 +53,239 @@ extern sem_t *sem1;
 extern sem_t *sem2;
 
 /**
- * @brief The client semaphore.
+ * @brief The third server semaphore.
  * @details This semaphore is assumed to be available when functions of this module are used.
  */
 extern sem_t *sem3;
 
 /**
- * @brief Wait for the server to process the packet in the shared memory.
- * @details The server is given access to the shared memory. This function makes use of two global variables `sem1` and `sem2`.
+ * @brief The client semaphores of the lanes.
+ * @details These semaphores are assumed to be available when functions of this module are used.
  */
-static void send_packet(void)
+extern sem_t *lane_queues[LANES];
+
+/**
+ * @brief The semaphores granting the shared memory to the lanes.
+ * @details These semaphores are assumed to be available when functions of this module are used.
+ */
+extern sem_t *lane_grants[LANES];
+
+/**
+ * @brief The semaphores admitting clients to the lanes.
+ * @details These semaphores are assumed to be available when functions of this module are used.
+ */
+extern sem_t *lane_admits[LANES];
+
+/**
+ * @brief The socket connected to the server, if the socket transport is used.
+ * @details This variable is assumed to be available when functions of this module are used. It is negative if the shared memory is used.
+ */
+extern int transport_sock;
+
+/**
+ * @brief The socket connected to the read-only replica.
+ * @details This variable is assumed to be available when functions of this module are used. It is negative if no replica is used.
+ */
+extern int replica_sock;
+
+/**
+ * @brief The length of the message to send over the socket transport.
+ */
+static size_t message_len = SHM_LEN;
+
+/**
+ * @brief The lane of the current packet.
+ */
+static enum lane_e packet_lane = LANE_INTERACTIVE;
+
+/**
+ * @brief Gain exclusive access to the packet buffer.
+ * @details With the shared memory, the client is admitted to the lane unless it is full, enters the queue of the lane and waits for the server to grant write access to the lane, for at most the time configured in `options`. With the socket transport, the private buffer is cleared. The packet is given the deadline after which the server drops it, which is the time configured in `options` from now. The reason is printed if the client is turned away. This function makes use of the global variables `sem3`, `lane_queues`, `lane_grants` and `lane_admits`.
+ * @param options The program configuration.
+ * @param lane The lane of the packet.
+ * @return `SUCCESS` if the packet buffer can be used, `BUSY` if the lane is full, or `TIMEOUT` if the server did not grant access in time.
+ */
+static enum request_status_e begin_packet(options_t *options, enum lane_e lane)
+{
+	uint64_t expires = options->wait > 0 ? clock_ms() + options->wait : 0;
+
+	if (transport_sock >= 0) {
+		memset(shmem, 0, shmlen);
+		message_len = SHM_LEN;
+		((struct packet_generic *) shmem)->deadline = expires;
+		return SUCCESS;
+	}
+
+	struct timespec deadline;
+	struct timespec *limit = NULL;
+
+	if (options->wait > 0) {
+		deadline_after(&deadline, options->wait);
+		limit = &deadline;
+	}
+
+	// turn away at once if the lane is full
+	if (sem_trywait(lane_admits[lane]) != 0) {
+		fprintf(stderr, "The server is busy, please try again later.\n");
+		return BUSY;
+	}
+
+	packet_lane = lane;
+
+	// enter the queue of the lane
+	if (!sem_timedwait_checked(lane_queues[lane], limit)) {
+		sem_post(lane_admits[lane]);
+		fprintf(stderr, "The server did not respond in time.\n");
+		return TIMEOUT;
+	}
+
+	// tell the server that the lane waits
+	sem_post(sem3);
+
+	// request write access to the shared memory, the server skips the post if the client gives up
+	if (!sem_timedwait_checked(lane_grants[lane], limit)) {
+		sem_post(lane_queues[lane]);
+		sem_post(lane_admits[lane]);
+		fprintf(stderr, "The server did not respond in time.\n");
+		return TIMEOUT;
+	}
+
+	((struct packet_generic *) shmem)->deadline = expires;
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Release the packet buffer.
+ * @details With the shared memory, the client leaves the queue of the lane and the server is granted write access. The queue is left first, so that the server finds the next client of the lane waiting. This function makes use of the global variables `sem1`, `lane_queues` and `lane_admits`.
+ */
+static void end_packet(void)
 {
+	if (transport_sock >= 0)
+		return;
+
+	// leave the queue of the lane
+	sem_post_checked(lane_queues[packet_lane]);
+	sem_post(lane_admits[packet_lane]);
+
 	// grant write access for the server
 	sem_post(sem1);
+}
+
+/**
+ * @brief Wait for the server to process the packet in the packet buffer.
+ * @details The server is given access to the shared memory, or the packet is sent over the socket transport and the response received into the buffer. The response is waited for until the deadline of the packet. If it passes, the client gives up and exits, releasing the packet buffer first, so that the server finds the request processed once it gets to it. A request the server dropped, because its deadline passed, is reported and answered with `ERROR`. This function makes use of two global variables `sem1` and `sem2`.
+ */
+static void send_packet(void)
+{
+	struct packet_generic *pg = shmem;
+	uint64_t expires = pg->deadline;
+
+	if (transport_sock >= 0) {
+		if (send(transport_sock, shmem, message_len, MSG_NOSIGNAL) != (ssize_t) message_len)
+			print_error_plain_exit("server is not available");
+
+		if (expires > 0) {
+			uint64_t now = clock_ms();
+			struct pollfd pfd = { .fd = transport_sock, .events = POLLIN };
+
+			if (now >= expires || poll(&pfd, 1, expires - now) == 0)
+				print_error_plain_exit("server did not respond in time");
+		}
+
+		ssize_t len = recv(transport_sock, shmem, shmlen, MSG_TRUNC);
+		if (len < (ssize_t) SHM_LEN || (size_t) len > shmlen)
+			print_error_plain_exit("server is not available");
+	} else {
+		struct timespec deadline;
+		struct timespec *limit = NULL;
+
+		if (expires > 0) {
+			uint64_t now = clock_ms();
+			deadline_after(&deadline, expires > now ? expires - now : 0);
+			limit = &deadline;
+		}
+
+		// discard the response to a client that gave up before
+		while (sem_trywait(sem2) == 0);
+
+		// grant write access for the server
+		sem_post(sem1);
+
+		// request write access to the shared memory
+		if (!sem_timedwait_checked(sem2, limit)) {
+			end_packet();
+			print_error_plain_exit("server did not respond in time");
+		}
+	}
+
+	// the server dropped the request, which is reported as failed
+	if (pg->rstatus == TIMEOUT) {
+		fprintf(stderr, "The server did not respond in time.\n");
+		pg->rstatus = ERROR;
+	}
+}
+
+/**
+ * @brief Exchange the packet in the packet buffer with the read-only replica.
+ * @details The replica is not asked again once it failed to respond. This function makes use of the global variable `replica_sock`.
+ * @return `true` if the replica responded, `false` otherwise.
+ */
+static bool replica_exchange(void)
+{
+	if (send(replica_sock, shmem, message_len, MSG_NOSIGNAL) == (ssize_t) message_len) {
+		ssize_t len = recv(replica_sock, shmem, shmlen, MSG_TRUNC);
+		if (len >= (ssize_t) SHM_LEN && (size_t) len <= shmlen)
+			return true;
+	}
+
+	close(replica_sock);
+	replica_sock = -1;
+	return false;
+}
+
+/**
+ * @brief Copy a secret passed as file descriptor by the server.
+ * @details The client connects to the descriptor passing socket, where the server waits for it after sending the response.
+ * @param len The length of the secret.
+ * @return A newly allocated copy of the secret, or `NULL` on failure.
+ */
+static char *receive_secret_fd(size_t len)
+{
+	char *secret = NULL;
+
+	int sock = unix_connect(shard_name(FD_SOCKET_NAME), SOCK_STREAM);
+	if (sock == -1)
+		return NULL;
+
+	int fd = recv_fd(sock);
+	close(sock);
+
+	if (fd == -1)
+		return NULL;
+
+	char *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (map != MAP_FAILED) {
+		secret = malloc(len + 1);
+
+		if (secret != NULL) {
+			memcpy(secret, map, len);
+			secret[len] = '\0';
+		}
 
-	// request write access to the shared memory
-	sem_wait_checked(sem2);
+		munmap(map, len);
+	}
+
+	close(fd);
+	return secret;
 }
 
 int register_user(options_t *options)
 {
 	int val;
 
-	// enter server request queue
-	sem_wait_checked(sem3);
-
-	// request write access to the shared memory
-	sem_wait_checked(sem2);
+	if (begin_packet(options, LANE_BULK) != SUCCESS)
+		return 1;
 
 	struct packet_registration *p = shmem;
 	p->type = REGISTRATION;
@@ -78,46 +299,71 @@ int register_user(options_t *options)
 	else
 		val = 0;
 
-	// grant write access for the server
-	sem_post(sem1);
-
-	// leave server request queue
-	sem_post_checked(sem3);
+	end_packet();
 
 	return val;
 }
 
-int login_user(options_t *options, char *session_id)
+int login_user(options_t *options, char *session_id, char *token)
 {
 	int val;
 
-	// enter server request queue
-	sem_wait_checked(sem3);
-
-	// request write access to the shared memory
-	sem_wait_checked(sem2);
+	if (begin_packet(options, LANE_BULK) != SUCCESS)
+		return 1;
 
 	struct packet_login *p = shmem;
 	p->type = LOGIN;
 	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
 	strncpy(p->password, options->password, MAX_PASSWORD_LEN + 1);
+	p->pid = getpid();
 
 	send_packet();
 
+	if (p->rstatus == LIMITED)
+		fprintf(stderr, "Too many login attempts, please try again later.\n");
+
 	p->session_id[SESSION_ID_SIZE] = '\0';
 	size_t len = strlen(p->session_id);
 	strncpy(session_id, p->session_id, SESSION_ID_SIZE + 1);
 
+	p->token[TOKEN_SIZE] = '\0';
+	strncpy(token, p->token, TOKEN_SIZE + 1);
+
 	if (len == SESSION_ID_SIZE)
 		val = 0;
 	else
 		val = 1;
 
-	// grant write access for the server
-	sem_post(sem1);
+	end_packet();
+
+	return val;
+}
+
+int resume_user(options_t *options, char *session_id)
+{
+	int val;
+
+	if (begin_packet(options, LANE_BULK) != SUCCESS)
+		return 1;
+
+	struct packet_resume *p = shmem;
+	p->type = RESUME;
+	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
+	strncpy(p->token, options->token, TOKEN_SIZE + 1);
+	p->pid = getpid();
+
+	send_packet();
+
+	p->session_id[SESSION_ID_SIZE] = '\0';
+	size_t len = strlen(p->session_id);
+	strncpy(session_id, p->session_id, SESSION_ID_SIZE + 1);
+
+	if (len == SESSION_ID_SIZE)
+		val = 0;
+	else
+		val = 1;
 
-	// leave server request queue
-	sem_post_checked(sem3);
+	end_packet();
 
 	return val;
 }
@@ -126,11 +372,8 @@ int logout_user(options_t *options, char *session_id)
 {
 	int val;
 
-	// enter server request queue
-	sem_wait_checked(sem3);
-
-	// request write access to the shared memory
-	sem_wait_checked(sem2);
+	if (begin_packet(options, LANE_INTERACTIVE) != SUCCESS)
+		return 1;
 
 	struct packet_logout *p = shmem;
 	p->type = LOGOUT;
@@ -144,77 +387,330 @@ int logout_user(options_t *options, char *session_id)
 	else
 		val = 0;
 
-	// grant write access for the server
-	sem_post(sem1);
-
-	// leave server request queue
-	sem_post_checked(sem3);
+	end_packet();
 
 	return val;
 }
 
-int write_secret(options_t *options, char *session_id, char *secret)
+int write_secret(options_t *options, char *session_id, char *secret, uint64_t *version)
 {
 	int val;
+	int memfd = -1;
+	int sock = -1;
+	size_t len = strlen(secret);
+
+	if (begin_packet(options, LANE_INTERACTIVE) != SUCCESS)
+		return 1;
 
-	// enter server request queue
-	sem_wait_checked(sem3);
+	// long secrets are passed as file descriptor, if the server offers it, connecting only once granted the lane
+	if (len >= SECRET_FD_THRESHOLD && transport_sock < 0) {
+		sock = unix_connect(shard_name(FD_SOCKET_NAME), SOCK_STREAM);
 
-	// request write access to the shared memory
-	sem_wait_checked(sem2);
+		if (sock != -1)
+			memfd = memfd_sealed(secret, len);
+	}
 
 	struct packet_secret_write *p = shmem;
-	p->type = SECRET_WRITE;
+	p->type = version != NULL ? SECRET_WRITE_IF : SECRET_WRITE;
 	strncpy(p->session_id, session_id, SESSION_ID_SIZE + 1);
 	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
-	strncpy(p->secret, secret, MAX_SECRET_LEN + 1);
+	p->pid = getpid();
+	p->secret_len = len;
+
+	if (version != NULL)
+		p->version = *version;
+
+	p->ttl = options->ttl;
+
+	// long secrets are passed through the data arena otherwise
+	if (memfd != -1 && send_fd(sock, memfd) == 0) {
+		p->transfer = TRANSFER_MEMFD;
+	} else if (len <= MAX_SECRET_LEN) {
+		memcpy(p->secret, secret, len + 1);
+	} else {
+		memcpy((char *) shmem + SHM_ARENA_OFFSET, secret, len + 1);
+		p->secret_offset = SHM_ARENA_OFFSET;
+		message_len = SHM_ARENA_OFFSET + len + 1;
+	}
 
 	send_packet();
 
-	if (p->rstatus == ERROR)
+	if (p->rstatus == CONFLICT)
+		val = 2;
+	else if (p->rstatus == ERROR)
 		val = 1;
 	else
 		val = 0;
 
-	// grant write access for the server
-	sem_post(sem1);
+	if (version != NULL && val != 1)
+		*version = p->version;
+
+	if (memfd != -1)
+		close(memfd);
 
-	// leave server request queue
-	sem_post_checked(sem3);
+	if (sock != -1)
+		close(sock);
+
+	end_packet();
 
 	return val;
 }
 
-int read_secret(options_t *options, char *session_id, char *secret)
+/**
+ * @brief Gain access to the packet buffer and fill in a secret_read packet.
+ * @param options The program configuration.
+ * @param session_id The session id retrieved on user login.
+ * @return The packet, or `NULL` if the client was turned away.
+ */
+static struct packet_secret_read *begin_secret_read(options_t *options, char *session_id)
+{
+	if (begin_packet(options, LANE_INTERACTIVE) != SUCCESS)
+		return NULL;
+
+	struct packet_secret_read *p = shmem;
+	p->type = SECRET_READ;
+	strncpy(p->session_id, session_id, SESSION_ID_SIZE + 1);
+	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
+	p->pid = getpid();
+	p->transfer = transport_sock < 0 ? TRANSFER_MEMFD : TRANSFER_SHM;
+
+	return p;
+}
+
+int read_secret(options_t *options, char *session_id, char **secret, secret_meta_t *meta)
 {
 	int val;
+	struct packet_secret_read *p = NULL;
+	bool replicated = false;
 
-	// enter server request queue
-	sem_wait_checked(sem3);
+	// the replica serves the read, unless its copy cannot tell the current secret
+	if (replica_sock >= 0) {
+		p = begin_secret_read(options, session_id);
+		replicated = replica_exchange() && p->rstatus == SUCCESS;
+	}
 
-	// request write access to the shared memory
-	sem_wait_checked(sem2);
+	if (!replicated) {
+		p = begin_secret_read(options, session_id);
+		if (p == NULL)
+			return 1;
 
-	struct packet_secret_read *p = shmem;
-	p->type = SECRET_READ;
+		send_packet();
+	}
+
+	char *source = p->secret;
+	size_t len = p->secret_len;
+	p->secret[MAX_SECRET_LEN] = '\0';
+	meta->version = p->version;
+	meta->expires = p->expires;
+	meta->bucket = p->bucket;
+	meta->sequence = p->sequence;
+	meta->replica = replicated;
+	meta->staleness = replicated ? p->staleness : 0;
+
+	if (len > MAX_SECRET_LEN && p->transfer == TRANSFER_SHM) {
+		if (p->secret_offset < SHM_ARENA_OFFSET || p->secret_offset >= shmlen ||
+			len >= shmlen - p->secret_offset)
+			p->rstatus = ERROR;
+		else
+			source = (char *) shmem + p->secret_offset;
+	}
+
+	*secret = NULL;
+
+	if (p->rstatus == ERROR) {
+		val = 1;
+	} else if (p->transfer == TRANSFER_MEMFD) {
+		*secret = receive_secret_fd(len);
+		val = *secret == NULL;
+	} else {
+		*secret = malloc(len + 1);
+
+		if (*secret != NULL) {
+			memcpy(*secret, source, len);
+			(*secret)[len] = '\0';
+			val = 0;
+		} else {
+			val = 1;
+		}
+	}
+
+	end_packet();
+
+	return val;
+}
+
+int write_key(options_t *options, char *session_id, char *key, char *secret)
+{
+	int val;
+	size_t len = strlen(secret);
+
+	if (begin_packet(options, LANE_INTERACTIVE) != SUCCESS)
+		return 1;
+
+	struct packet_key_write *p = shmem;
+	p->type = KEY_WRITE;
+	strncpy(p->session_id, session_id, SESSION_ID_SIZE + 1);
+	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
+	strncpy(p->key, key, MAX_KEY_LEN + 1);
+	p->secret_len = len;
+
+	// long secrets are passed through the data arena
+	if (len <= MAX_SECRET_LEN) {
+		memcpy(p->secret, secret, len + 1);
+	} else {
+		memcpy((char *) shmem + SHM_ARENA_OFFSET, secret, len + 1);
+		p->secret_offset = SHM_ARENA_OFFSET;
+		message_len = SHM_ARENA_OFFSET + len + 1;
+	}
+
+	send_packet();
+
+	if (p->rstatus == ERROR)
+		val = 1;
+	else
+		val = 0;
+
+	end_packet();
+
+	return val;
+}
+
+int read_key(options_t *options, char *session_id, char *key, char **secret)
+{
+	int val;
+
+	if (begin_packet(options, LANE_INTERACTIVE) != SUCCESS)
+		return 1;
+
+	struct packet_key_read *p = shmem;
+	p->type = KEY_READ;
 	strncpy(p->session_id, session_id, SESSION_ID_SIZE + 1);
 	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
+	strncpy(p->key, key, MAX_KEY_LEN + 1);
 
 	send_packet();
 
+	char *source = p->secret;
+	size_t len = p->secret_len;
 	p->secret[MAX_SECRET_LEN] = '\0';
-	strncpy(secret, p->secret, MAX_SECRET_LEN + 1);
+
+	if (len > MAX_SECRET_LEN) {
+		if (p->secret_offset < SHM_ARENA_OFFSET || p->secret_offset >= shmlen ||
+			len >= shmlen - p->secret_offset)
+			p->rstatus = ERROR;
+		else
+			source = (char *) shmem + p->secret_offset;
+	}
+
+	*secret = NULL;
+
+	if (p->rstatus == ERROR) {
+		val = 1;
+	} else {
+		*secret = malloc(len + 1);
+
+		if (*secret != NULL) {
+			memcpy(*secret, source, len);
+			(*secret)[len] = '\0';
+			val = 0;
+		} else {
+			val = 1;
+		}
+	}
+
+	end_packet();
+
+	return val;
+}
+
+int delete_key(options_t *options, char *session_id, char *key)
+{
+	int val;
+
+	if (begin_packet(options, LANE_INTERACTIVE) != SUCCESS)
+		return 1;
+
+	struct packet_key_delete *p = shmem;
+	p->type = KEY_DELETE;
+	strncpy(p->session_id, session_id, SESSION_ID_SIZE + 1);
+	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
+	strncpy(p->key, key, MAX_KEY_LEN + 1);
+
+	send_packet();
 
 	if (p->rstatus == ERROR)
 		val = 1;
 	else
 		val = 0;
 
-	// grant write access for the server
-	sem_post(sem1);
+	end_packet();
+
+	return val;
+}
+
+int scan_names(options_t *options, char *session_id, enum scan_e target, char cursor[MAX_CURSOR_LEN + 1], char names[SCAN_PAGE_SIZE][MAX_CURSOR_LEN + 1], uint32_t *count)
+{
+	int val;
+
+	if (begin_packet(options, LANE_BULK) != SUCCESS)
+		return 1;
+
+	struct packet_scan *p = shmem;
+	p->type = SCAN;
+	strncpy(p->session_id, session_id, SESSION_ID_SIZE + 1);
+	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
+	p->target = target;
+	p->limit = SCAN_PAGE_SIZE;
+	strncpy(p->cursor, cursor, MAX_CURSOR_LEN + 1);
+
+	send_packet();
+
+	if (p->rstatus == ERROR || p->count > SCAN_PAGE_SIZE) {
+		val = 1;
+	} else {
+		*count = p->count;
+		memcpy(names, p->names, sizeof(p->names));
+		memcpy(cursor, p->cursor, MAX_CURSOR_LEN + 1);
+
+		for (uint32_t i = 0; i < *count; i++)
+			names[i][MAX_CURSOR_LEN] = '\0';
+
+		cursor[MAX_CURSOR_LEN] = '\0';
+		val = 0;
+	}
+
+	end_packet();
+
+	return val;
+}
+
+int watch_secret(options_t *options, char *session_id, uint64_t *version, uint32_t *bucket, uint32_t *sequence)
+{
+	int val;
+
+	if (begin_packet(options, LANE_INTERACTIVE) != SUCCESS)
+		return 1;
+
+	struct packet_watch *p = shmem;
+	p->type = WATCH;
+	strncpy(p->session_id, session_id, SESSION_ID_SIZE + 1);
+	strncpy(p->username, options->username, MAX_USERNAME_LEN + 1);
+	p->version = *version;
+
+	send_packet();
+
+	if (p->rstatus == CONFLICT) {
+		*version = p->version;
+		val = 2;
+	} else if (p->rstatus == ERROR || p->bucket >= WATCH_BUCKETS) {
+		val = 1;
+	} else {
+		*bucket = p->bucket;
+		*sequence = p->sequence;
+		val = 0;
+	}
 
-	// leave server request queue
-	sem_post_checked(sem3);
+	end_packet();
 
 	return val;
 }
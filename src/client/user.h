@@ -9,8 +9,25 @@
 #ifndef __USER_H__
 #define __USER_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "options.h"
 
+#include "../share/protocol.h"
+
+/**
+ * @brief Metadata of a secret read from the server.
+ */
+typedef struct {
+	uint64_t version; ///< Version of the secret.
+	uint32_t expires; ///< Time in seconds since the epoch at which the secret expires, `0` if it does not.
+	uint32_t bucket; ///< Bucket of the watch table of the user.
+	uint32_t sequence; ///< Value of the counter of the bucket when the secret was read.
+	bool replica; ///< Whether the secret was read from a read-only replica.
+	uint32_t staleness; ///< Age in milliseconds of the copy the replica read the secret from.
+} secret_meta_t;
+
 /**
  * @brief Register a new user on the server.
  * @details This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
@@ -24,9 +41,19 @@ int register_user(options_t *options);
  * @details This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
  * @param options The program configuration.
  * @param session_id The session id retrieved on user login.
+ * @param token The resumption token retrieved on user login.
  * @return `0` on success, `1` otherwise.
  */
-int login_user(options_t *options, char *session_id);
+int login_user(options_t *options, char *session_id, char *token);
+
+/**
+ * @brief Resume a session on the server side.
+ * @details The resumption token in `options` is sent instead of the password. This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
+ * @param options The program configuration.
+ * @param session_id The session id retrieved on session resumption.
+ * @return `0` on success, `1` otherwise.
+ */
+int resume_user(options_t *options, char *session_id);
 
 /**
  * @brief Logout the user on the server side.
@@ -43,18 +70,77 @@ int logout_user(options_t *options, char *session_id);
  * @param options The program configuration.
  * @param session_id The session id retrieved on user login.
  * @param secret The secret to write to the database.
- * @return `0` on success, `1` otherwise.
+ * @param version If not `NULL`, the secret is only written if it still has this version. Set to the new version on success, and to the current version on a conflict.
+ * @return `0` on success, `2` on a conflict, `1` otherwise.
  */
-int write_secret(options_t *options, char *session_id, char *secret);
+int write_secret(options_t *options, char *session_id, char *secret, uint64_t *version);
 
 /**
  * @brief Read the stored secret in the database on the server.
+ * @details The read-only replica is asked first, if the client is connected to one. The server is asked if the replica cannot serve the read. This method requires the precense of the global variables `sem1`, `sem2`, `sem3`, `shmem` and `replica_sock`.
+ * @param options The program configuration.
+ * @param session_id The session id retrieved on user login.
+ * @param secret Set to a newly allocated copy of the secret on success, which has to be freed by the caller.
+ * @param meta Set to the metadata of the secret on success.
+ * @return `0` on success, `1` otherwise.
+ */
+int read_secret(options_t *options, char *session_id, char **secret, secret_meta_t *meta);
+
+/**
+ * @brief Write a named secret to the database on the server.
+ * @details This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
+ * @param options The program configuration.
+ * @param session_id The session id retrieved on user login.
+ * @param key The name of the secret.
+ * @param secret The secret to write.
+ * @return `0` on success, `1` otherwise.
+ */
+int write_key(options_t *options, char *session_id, char *key, char *secret);
+
+/**
+ * @brief Read a named secret from the database on the server.
+ * @details This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
+ * @param options The program configuration.
+ * @param session_id The session id retrieved on user login.
+ * @param key The name of the secret.
+ * @param secret Set to a newly allocated copy of the secret on success, which has to be freed by the caller.
+ * @return `0` on success, `1` otherwise.
+ */
+int read_key(options_t *options, char *session_id, char *key, char **secret);
+
+/**
+ * @brief Delete a named secret from the database on the server.
+ * @details This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
+ * @param options The program configuration.
+ * @param session_id The session id retrieved on user login.
+ * @param key The name of the secret.
+ * @return `0` on success, `1` otherwise.
+ */
+int delete_key(options_t *options, char *session_id, char *key);
+
+/**
+ * @brief Read a page of usernames or names of secrets from the server.
  * @details This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
  * @param options The program configuration.
  * @param session_id The session id retrieved on user login.
- * @param secret The buffer to read the secret into.
+ * @param target What to scan.
+ * @param cursor The cursor of the page, empty for the first page. Set to the cursor of the next page, which is empty after the last page.
+ * @param names Set to the names of the page.
+ * @param count Set to the number of names of the page.
  * @return `0` on success, `1` otherwise.
  */
-int read_secret(options_t *options, char *session_id, char *secret);
+int scan_names(options_t *options, char *session_id, enum scan_e target, char cursor[MAX_CURSOR_LEN + 1], char names[SCAN_PAGE_SIZE][MAX_CURSOR_LEN + 1], uint32_t *count);
+
+/**
+ * @brief Set up a watch for changes of the secret on the server.
+ * @details This method requires the precense of the global variables `sem1`, `sem2`, `sem3` and `shmem`.
+ * @param options The program configuration.
+ * @param session_id The session id retrieved on user login.
+ * @param version The version of the secret known to the client. Set to the current version if the secret changed.
+ * @param bucket Set to the bucket of the watch table to wait on.
+ * @param sequence Set to the value of the counter of the bucket to wait for a change of.
+ * @return `0` if the secret did not change, `2` if it did, `1` otherwise.
+ */
+int watch_secret(options_t *options, char *session_id, uint64_t *version, uint32_t *bucket, uint32_t *sequence);
 
 #endif
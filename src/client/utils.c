@@ -6,6 +6,8 @@
  * @details Functions in this module are not program specific.
  */
 
+#include <errno.h>
+
 #include "utils.h"
 
 #include "../share/utils.h"
@@ -30,6 +32,25 @@ void sem_wait_checked(sem_t *sem)
 		sem_wait(sem);
 }
 
+bool sem_timedwait_checked(sem_t *sem, const struct timespec *deadline)
+{
+	struct packet_generic *p = shmem;
+
+	if (p->status == OFFLINE)
+		print_error_plain_exit("server is not available");
+
+	if (deadline == NULL) {
+		sem_wait(sem);
+		return true;
+	}
+
+	// a signal does not end the wait early
+	int errind;
+	while ((errind = sem_timedwait(sem, deadline)) != 0 && errno == EINTR);
+
+	return errind == 0;
+}
+
 void sem_post_checked(sem_t *sem)
 {
 	int status;
@@ -9,7 +9,9 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
-#include "semaphore.h"
+#include <stdbool.h>
+#include <time.h>
+#include <semaphore.h>
 
 /**
  * @brief Perform a checked semaphore wait.
@@ -18,6 +20,15 @@
  */
 void sem_wait_checked(sem_t *sem);
 
+/**
+ * @brief Perform a checked semaphore wait until a deadline.
+ * @details Checked in this sense means to make sure that the server has not been terminated yet. Makes use of the global variable `shmem`.
+ * @param sem The semaphore to wait for.
+ * @param deadline The point in time to wait until, measured by `CLOCK_REALTIME`, or `NULL` to wait indefinitely.
+ * @return `true` if the semaphore was acquired, `false` if the deadline passed.
+ */
+bool sem_timedwait_checked(sem_t *sem, const struct timespec *deadline);
+
 /**
  * @brief Perform a checked semaphore post.
  * @details Checked in this sense means to make sure that the server has not been terminated yet. Makes use of the global variable `shmem`.
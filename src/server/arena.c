@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function definitions for an arena allocator.
+ * @details Allocations are carved from large chunks and are only released all at once when the arena is destroyed, except for the latest ones, which can be undone.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+arena_t *arena_initialize(void)
+{
+	arena_t *arena = malloc(sizeof(arena_t));
+
+	if (arena == NULL)
+		return NULL;
+
+	arena->head = NULL;
+	arena->reserved = 0;
+	arena->used = 0;
+
+	return arena;
+}
+
+void arena_destroy(arena_t *arena)
+{
+	if (arena == NULL)
+		return;
+
+	chunk_t *next = arena->head;
+
+	for (chunk_t *curr = next; curr != NULL; curr = next) {
+		next = curr->next;
+		free(curr);
+	}
+
+	free(arena);
+}
+
+void *arena_alloc(arena_t *arena, size_t n)
+{
+	chunk_t *chunk = arena->head;
+
+	if (chunk == NULL || chunk->size - chunk->used < n) {
+		size_t size = n > ARENA_CHUNK_SIZE ? n : ARENA_CHUNK_SIZE;
+
+		chunk = malloc(sizeof(chunk_t) + size);
+		if (chunk == NULL)
+			return NULL;
+
+		chunk->next = arena->head;
+		chunk->size = size;
+		chunk->used = 0;
+
+		arena->head = chunk;
+		arena->reserved += sizeof(chunk_t) + size;
+	}
+
+	void *mem = chunk->data + chunk->used;
+	chunk->used += n;
+	arena->used += n;
+
+	return mem;
+}
+
+char *arena_strdup(arena_t *arena, const char *str, size_t len)
+{
+	if (len > UINT8_MAX)
+		return NULL;
+
+	unsigned char *mem = arena_alloc(arena, len + 2);
+	if (mem == NULL)
+		return NULL;
+
+	mem[0] = (unsigned char) len;
+	memcpy(mem + 1, str, len);
+	mem[len + 1] = '\0';
+
+	return (char *) (mem + 1);
+}
+
+arena_mark_t arena_mark(arena_t *arena)
+{
+	arena_mark_t mark;
+
+	mark.head = arena->head;
+	mark.chunk_used = arena->head != NULL ? arena->head->used : 0;
+	mark.used = arena->used;
+
+	return mark;
+}
+
+void arena_rewind(arena_t *arena, arena_mark_t mark)
+{
+	while (arena->head != mark.head) {
+		chunk_t *chunk = arena->head;
+
+		arena->head = chunk->next;
+		arena->reserved -= sizeof(chunk_t) + chunk->size;
+		free(chunk);
+	}
+
+	if (arena->head != NULL)
+		arena->head->used = mark.chunk_used;
+
+	arena->used = mark.used;
+}
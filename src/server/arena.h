@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function declarations for an arena allocator.
+ * @details Allocations are carved from large chunks and are only released all at once when the arena is destroyed, except for the latest ones, which can be undone.
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The default size of an arena chunk.
+ */
+#define ARENA_CHUNK_SIZE 65536
+
+/**
+ * @brief Chunk of an arena.
+ */
+typedef struct chunk_s {
+	struct chunk_s *next; ///< Previously filled chunk.
+	size_t size; ///< Usable size of the chunk.
+	size_t used; ///< Bytes already handed out.
+	unsigned char data[]; ///< Memory of the chunk.
+} chunk_t;
+
+/**
+ * @brief Representation of an arena.
+ */
+typedef struct {
+	chunk_t *head; ///< Chunk allocations are currently carved from.
+	size_t reserved; ///< Bytes reserved by all chunks.
+	size_t used; ///< Bytes handed out from all chunks.
+} arena_t;
+
+/**
+ * @brief Position in an arena, to which later allocations can be undone.
+ */
+typedef struct {
+	chunk_t *head; ///< Chunk allocations were carved from.
+	size_t chunk_used; ///< Bytes handed out from that chunk.
+	size_t used; ///< Bytes handed out from all chunks.
+} arena_mark_t;
+
+/**
+ * @brief Create a new arena.
+ * @return The memory address of the arena, or `NULL` on failure.
+ */
+arena_t *arena_initialize(void);
+
+/**
+ * @brief Destroy the arena `arena` and all memory allocated from it.
+ * @param arena The arena to destroy.
+ */
+void arena_destroy(arena_t *arena);
+
+/**
+ * @brief Allocate `n` bytes from the arena `arena`.
+ * @details The memory is not aligned.
+ * @param arena The arena to allocate from.
+ * @param n The number of bytes to allocate.
+ * @return The allocated memory, or `NULL` on failure.
+ */
+void *arena_alloc(arena_t *arena, size_t n);
+
+/**
+ * @brief Copy the string `str` into the arena `arena`.
+ * @details The copy is prefixed with its length in a single byte and terminated with a null byte, so it can be used like any other string. The length can be read back with `arena_strlen()`.
+ * @param arena The arena to copy the string to.
+ * @param str The string to copy.
+ * @param len The length of `str`, which must not exceed `UINT8_MAX`.
+ * @return The copy of the string, or `NULL` on failure.
+ */
+char *arena_strdup(arena_t *arena, const char *str, size_t len);
+
+/**
+ * @brief Remember the current position in the arena `arena`.
+ * @param arena The arena to remember the position of.
+ * @return The position.
+ */
+arena_mark_t arena_mark(arena_t *arena);
+
+/**
+ * @brief Undo all allocations from the arena `arena` since the position `mark`.
+ * @details Chunks created since are freed.
+ * @param arena The arena to roll back.
+ * @param mark The position, as returned by `arena_mark()`.
+ */
+void arena_rewind(arena_t *arena, arena_mark_t mark);
+
+/**
+ * @brief Retrieve the length of a string copied with `arena_strdup()`.
+ * @param str The string to get the length of.
+ * @return The length of the string.
+ */
+static inline size_t arena_strlen(const char *str)
+{
+	return (uint8_t) str[-1];
+}
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains the tool to change the number of shards of a cluster.
+ * @details The databases of all shards are read, and every user is written to the database of the shard it belongs to with the new number of shards. The servers of the cluster have to be shut down while the tool runs, as they save their databases on shutdown.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "critbit.h"
+
+#include "../share/utils.h"
+#include "../share/shard.h"
+
+/**
+ * @brief Program name.
+ * @details This variable must be set on program start.
+ */
+char *progname;
+
+/**
+ * @brief Print a usage message.
+ * @details The function terminates the program with the value `EXIT_FAILURE`. The global variable `progname` has to be defined in order for this function to work.
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: %s -k shards -o prefix database...\n", progname);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Check that no user is in the database twice.
+ * @param database The database to check.
+ * @return `true` if every username is unique, `false` otherwise.
+ */
+static bool usernames_unique(database_t *database)
+{
+	critbit_t *tree = critbit_initialize();
+	if (tree == NULL)
+		print_error_plain_exit("failed initializing user directory");
+
+	for (size_t i = 0; i < database->length; i++) {
+		if (!critbit_insert(tree, database->entries[i].username))
+			print_error_plain_exit("failed initializing user directory");
+	}
+
+	bool unique = tree->count == database->length;
+	critbit_destroy(tree);
+
+	return unique;
+}
+
+/**
+ * @brief Enty point of the tool.
+ * @details The databases named as arguments are merged, and written to one database per shard, named by the prefix and the index of the shard.
+ * @param argc Cardinality of `argv`.
+ * @param argv Program argument vector.
+ * @return `EXIT_FAILURE` on error, `EXIT_SUCCESS` otherwise.
+ */
+int main(int argc, char *argv[])
+{
+	progname = argv[0];
+	opterr = 0;
+
+	unsigned long shards = 0;
+	char *prefix = NULL;
+	char *endptr;
+
+	int c;
+	while ((c = getopt(argc, argv, "k:o:")) != -1) {
+		switch (c) {
+		case 'k':
+			if (shards != 0)
+				usage();
+
+			errno = 0;
+			shards = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || *optarg == '\0' || *endptr != '\0' || shards == 0 || shards > MAX_SHARDS)
+				usage();
+			break;
+		case 'o':
+			if (prefix != NULL)
+				usage();
+
+			prefix = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (shards == 0 || prefix == NULL || optind == argc)
+		usage();
+
+	// the servers would overwrite the result on shutdown
+	if (cluster_shards() > 1)
+		print_error_plain_exit("the cluster is still running");
+
+	database_t *database = database_initialize();
+	if (database == NULL)
+		print_error_plain_exit("failed initializing database");
+
+	for (int i = optind; i < argc; i++) {
+		char *path = argv[i];
+		if (read_database(&path, database) != 0)
+			print_error_plain_exit("failed reading database");
+	}
+
+	if (!usernames_unique(database))
+		print_error_plain_exit("a user is in more than one database");
+
+	// the shards share the entries of the merged database
+	database_t shard = *database;
+	shard.entries = malloc(database->length * sizeof(entry_t) + 1);
+	if (shard.entries == NULL)
+		print_error_exit("failed allocating shard");
+
+	int status = EXIT_SUCCESS;
+
+	for (unsigned i = 0; i < shards; i++) {
+		shard.length = 0;
+
+		for (size_t j = 0; j < database->length; j++) {
+			if (shard_of(database->entries[j].username, shards) == i)
+				shard.entries[shard.length++] = database->entries[j];
+		}
+
+		char path[4096];
+		snprintf(path, sizeof(path), "%s.%u", prefix, i);
+
+		if (save_database(path, &shard) != 0) {
+			print_error_plain("could not save the database");
+			status = EXIT_FAILURE;
+			continue;
+		}
+
+		printf("%s: %zu users\n", path, shard.length);
+	}
+
+	free(shard.entries);
+	database_destroy(database);
+
+	return status;
+}
@@ -3,9 +3,10 @@
  * @author eikendev, https://eiken.dev/
  * @date 2018-01-04
  * @brief This module contains the core functionality of the server.
- * @details Core functionality includes functions to wait for clients to connect and to shut down the server.
+ * @details Core functionality includes functions to wait for clients to connect and to shut down the server. A new server can take over from a running one without clients losing their sessions. The server can publish its database for read-only replicas, which are run by the same program, and ship its journal to a standby server, which takes over once the server is gone.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
@@ -13,16 +14,52 @@
 #include <time.h>
 #include <semaphore.h>
 #include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/mman.h>
 
 #include "options.h"
 #include "utils.h"
 #include "list.h"
 #include "ipc.h"
 #include "database.h"
+#include "token.h"
+#include "bloom.h"
+#include "index.h"
+#include "critbit.h"
+#include "stats.h"
+#include "user.h"
+#include "transport.h"
+#include "handover.h"
+#include "replica.h"
+#include "journal.h"
+#include "lane.h"
+#include "ratelimit.h"
+#include "reaper.h"
+#include "placement.h"
 
 #include "../share/utils.h"
 #include "../share/shmem.h"
 #include "../share/protocol.h"
+#include "../share/fdpass.h"
+#include "../share/watch.h"
+#include "../share/shard.h"
+
+/**
+ * @brief Time in milliseconds between two runs of the expiry sweeper.
+ */
+#define SWEEP_INTERVAL 1000
+
+/**
+ * @brief The number of entries checked by one run of the expiry sweeper.
+ */
+#define SWEEP_BATCH 256
+
+/**
+ * @brief Time in milliseconds a standby waits for the running server to exit before connecting again.
+ */
+#define STANDBY_RETRY 10
 
 /**
  * @brief Program name.
@@ -33,18 +70,63 @@ char *progname;
 /**
  * @brief Indicator for the program to shut down.
  */
-static volatile sig_atomic_t running = true;
+volatile sig_atomic_t running = true;
+
+/**
+ * @brief Indicator for the program to print its statistics.
+ */
+static volatile sig_atomic_t dump_stats = false;
+
+/**
+ * @brief Indicator for the program to hand over to a new server.
+ */
+static volatile sig_atomic_t handover_requested = false;
+
+/**
+ * @brief Whether the server owns the shared resources.
+ * @details A server taking over owns them once the handover is complete, and a server handing over gives them up. Only the owner removes the resources and saves the database on shutdown.
+ */
+static bool owner = true;
 
 /**
  * @brief The memory shared between the server and the clients.
  */
 void *shmem = NULL;
 
+/**
+ * @brief The size of the shared memory.
+ */
+size_t shmlen = 0;
+
 /**
  * @brief The file descriptor used to open the shared memory.
  */
 static int memfd = -1;
 
+/**
+ * @brief The socket used to pass secrets as file descriptors.
+ * @details The socket is only opened if descriptor passing is enabled.
+ */
+int fdsock = -1;
+
+/**
+ * @brief The socket transport.
+ * @details The transport is only started if it is enabled.
+ */
+transport_t *transport = NULL;
+
+/**
+ * @brief The copy of the database published for read-only replicas.
+ * @details The copy is only published if it is enabled. A replica maps it read-only.
+ */
+replica_t *replica = NULL;
+
+/**
+ * @brief The journal shipped to a standby server.
+ * @details The journal is only kept if it is enabled. A standby server follows the journal of the running server.
+ */
+journal_t *journal = NULL;
+
 /**
  * @brief Program configuration.
  * @details This struct keeps the configuration retrived by parsing program arguments at program start.
@@ -64,10 +146,10 @@ sem_t *sem1 = NULL;
 sem_t *sem2 = NULL;
 
 /**
- * @brief The client semaphore.
- * @details This semaphore is used to make sure only one client can communicate with the server at a time.
+ * @brief The lanes clients queue in.
+ * @details The shared memory is granted to the client at the head of one lane at a time.
  */
-static sem_t *sem3 = NULL;
+lanes_t *lanes = NULL;
 
 /**
  * @brief The client list.
@@ -76,10 +158,58 @@ static sem_t *sem3 = NULL;
 list_t *clients = NULL;
 
 /**
- * @brief The database list.
- * @details This list is used to keep an in-memory copy of the database.
+ * @brief The database.
+ * @details This structure is used to keep an in-memory copy of the database.
+ */
+database_t *database = NULL;
+
+/**
+ * @brief The watch table shared with the clients.
+ * @details The counter of a bucket is incremented whenever the secret of a user hashed to it changes.
+ */
+uint32_t *watch_table = NULL;
+
+/**
+ * @brief The username filter.
+ * @details This filter is used to rule out users that are not in the database without searching it.
+ */
+bloom_t *usernames = NULL;
+
+/**
+ * @brief The username index.
+ * @details This index is used to find the database entry of a user.
+ */
+index_t *user_index = NULL;
+
+/**
+ * @brief The user directory.
+ * @details This tree holds all usernames in order to enumerate them.
+ */
+critbit_t *user_order = NULL;
+
+/**
+ * @brief The rate limiter of logins per username.
+ * @details This limiter is only created if logins per username are limited.
  */
-list_t *database = NULL;
+ratelimit_t *user_limits = NULL;
+
+/**
+ * @brief The rate limiter of logins per client.
+ * @details This limiter is only created if logins per client are limited.
+ */
+ratelimit_t *client_limits = NULL;
+
+/**
+ * @brief The rate limiter of logins over the shared memory as a whole.
+ * @details This limiter is only created if logins per client are limited.
+ */
+ratelimit_t *shared_limits = NULL;
+
+/**
+ * @brief The reaper of sessions whose client exited.
+ * @details This reaper is only created once the server serves clients, as a standby replaces its sessions whenever it synchronizes.
+ */
+reaper_t *reaper = NULL;
 
 /**
  * @brief Signal handler for the server.
@@ -91,35 +221,81 @@ static void handler(int signum)
 	running = false;
 }
 
+/**
+ * @brief Signal handler for statistics requests.
+ * @details The `dump_stats` variable is set to `true` on `SIGUSR1` signal interruption.
+ * @param signum The signal id.
+ */
+static void handler_stats(int signum)
+{
+	dump_stats = true;
+}
+
+/**
+ * @brief Signal handler for handover requests.
+ * @details The `handover_requested` variable is set to `true` on `SIGUSR2` signal interruption.
+ * @param signum The signal id.
+ */
+static void handler_handover(int signum)
+{
+	handover_requested = true;
+}
+
 /**
  * @brief The server cleanup function.
- * @details This function handles resource cleanup as well as client wakeup.
+ * @details This function handles resource cleanup as well as client wakeup. Resources the server does not own are only closed, as another server keeps using them.
  */
 static void cleanup(void)
 {
 	int errind;
 
+	handover_close();
+	cluster_leave();
+
+	// a standby notices the connection ending and waits for the server to exit
+	journal_destroy(journal);
+
 	// set server flag to offline
-	set_status_offline(shmem);
+	if (owner)
+		set_status_offline(shmem);
+
+	// stop serving connections before the state they refer to is gone
+	transport_stop(transport);
 
 	// wake up waiting clients
-	if (sem3 != NULL)
-		sem_settle(sem3);
+	if (owner && lanes != NULL) {
+		lanes_settle(lanes);
+		sem_settle(sem2);
+	}
+
+	// wake up watching clients, which then notice that the server is offline
+	if (owner && watch_table != NULL) {
+		for (size_t i = 0; i < WATCH_BUCKETS; i++)
+			watch_notify(&watch_table[i]);
+	}
+
+	watch_close(watch_table, owner);
 
 	// cleanup shared memory
 	if (memfd >= 0) {
-		errind = close_shared_memory(SHM_NAME, SHM_LEN, memfd, true);
+		errind = close_shared_memory(shard_name(SHM_NAME), shmlen, memfd, owner);
 		if (errind != 0)
 			print_error("failed closing shared memory");
 	}
 
+	// cleanup descriptor passing socket
+	if (fdsock >= 0)
+		close(fdsock);
+
 	// cleanup semaphores
-	sem_cleanup(sem1, SEM_SERVER1);
-	sem_cleanup(sem2, SEM_SERVER2);
-	sem_cleanup(sem3, SEM_CLIENT1);
+	sem_cleanup(sem1, owner ? shard_name(SEM_SERVER1) : NULL);
+	sem_cleanup(sem2, owner ? shard_name(SEM_SERVER2) : NULL);
+	lanes_destroy(lanes, owner);
+
+	replica_destroy(replica, owner);
 
 	// save database to file
-	if (options.database_path != NULL) {
+	if (owner && options.database_path != NULL) {
 		errind = save_database(options.database_path, database);
 		if (errind != 0)
 			print_error_plain("could not save the database");
@@ -127,38 +303,273 @@ static void cleanup(void)
 
 	// cleanup lists
 	list_destroy(clients);
-	list_destroy(database);
+	database_destroy(database);
+	bloom_destroy(usernames);
+	index_destroy(user_index);
+	critbit_destroy(user_order);
+	ratelimit_destroy(user_limits);
+	ratelimit_destroy(client_limits);
+	ratelimit_destroy(shared_limits);
+	reaper_destroy(reaper);
 }
 
 /**
  * @brief The main loop of the server program.
- * @details This core functionality of the server is bound to this loop. Two steps are executed continuously: packet retrieval and packet handling.
+ * @details This core functionality of the server is bound to this loop. Two steps are executed continuously: packet retrieval, for which the shared memory is granted to the head of one of the lanes, and packet handling. Once per `SWEEP_INTERVAL`, a batch of entries is checked for expired secrets, and the sessions whose client exited are ended. If replicas are served, their copy of the database is refreshed at least once per `REPLICA_INTERVAL`. A standby is accepted and sent a heartbeat at least once per `JOURNAL_HEARTBEAT`. Between two packets, the server hands over to a new server if requested, and stops once the new server took over.
  */
 static void run_main_loop(void)
 {
 	int errind;
+	uint64_t next_sweep = 0;
 
 	while (running) {
-		// wait for a client to grant write access
-		errind = sem_wait_exit(sem1, true);
-		if (errind != 0)
+		if (handover_requested) {
+			handover_requested = false;
+
+			if (handover_serve(options.secret_cap)) {
+				owner = false;
+				break;
+			}
+		}
+
+		int timeout = SWEEP_INTERVAL;
+		if (replica != NULL && REPLICA_INTERVAL < timeout)
+			timeout = REPLICA_INTERVAL;
+		if (journal != NULL && JOURNAL_HEARTBEAT < timeout)
+			timeout = JOURNAL_HEARTBEAT;
+
+		// wait for a client at the head of a lane, waking up in time to refresh the copy of the replicas and the standby
+		errind = lanes_wait(lanes, timeout);
+
+		if (dump_stats) {
+			dump_stats = false;
+			ipc_lock();
+			print_stats(stderr);
+			ipc_unlock();
+		}
+
+		// reclaim expired secrets a few at a time and sessions of exited clients, even if idle
+		uint64_t now = clock_ms();
+		if (now >= next_sweep) {
+			ipc_lock();
+			user_expire_sweep(database, SWEEP_BATCH);
+			reaper_collect(reaper, clients);
+			ipc_unlock();
+			next_sweep = now + SWEEP_INTERVAL;
+		}
+
+		if (replica != NULL) {
+			ipc_lock();
+			replica_refresh(replica, database, clients);
+			ipc_unlock();
+		}
+
+		if (journal != NULL) {
+			ipc_lock();
+			journal_refresh(journal, options.secret_cap);
+			ipc_unlock();
+		}
+
+		// keep waiting if interrupted by a statistics request or idle
+		if (errind != 0) {
+			if (running)
+				continue;
+
 			break;
+		}
+
+		int lane = lanes_grant(lanes);
+		if (lane < 0)
+			continue;
 
-		handle_packet(shmem);
+		// wait for the client to grant write access, unless shutting down or the client gave up
+		do {
+			errind = sem_timedwait_exit(sem1, LANE_GRANT_TIMEOUT);
+		} while (errind != 0 && running && (errind == 1 || !lanes_revoke(lanes, lane)));
 
-		// prevent posting next client if not longer running
 		if (!running)
 			break;
 
-		errind = sem_post(sem2);
-		if (errind != 0)
-			print_error_exit("failed posting semaphore");
+		if (errind == 0)
+			handle_packet(shmem, lane);
+	}
+}
+
+/**
+ * @brief The main loop of a read-only replica.
+ * @details The copy published by the server is served over the socket `REPLICA_SOCKET_FORMAT` until the replica is asked to shut down. The main thread only waits for signals.
+ */
+static void run_replica(void)
+{
+	replica = replica_open();
+	if (replica == NULL)
+		print_error_plain_exit("no database is published for replicas");
+
+	// secrets changed since they were copied are detected with the watch table
+	watch_table = watch_open(false);
+	if (watch_table == NULL)
+		print_error_exit("failed opening watch table");
+
+	char name[sizeof(REPLICA_SOCKET_FORMAT) + 16];
+	snprintf(name, sizeof(name), REPLICA_SOCKET_FORMAT, (unsigned) options.replica);
+
+	transport = transport_create(shard_name(name), replica_handle, replica->secret_cap, options.uring, -1);
+	if (transport == NULL || transport_resume(transport) != 0)
+		print_error_exit("failed starting socket transport");
+
+	sigset_t mask, old;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGUSR1);
+
+	// signals are only delivered while waiting, so none is missed
+	if (sigprocmask(SIG_BLOCK, &mask, &old) == -1)
+		print_error_exit("failed blocking signals");
+
+	while (running) {
+		sigsuspend(&old);
+
+		if (dump_stats) {
+			dump_stats = false;
+			print_stats(stderr);
+		}
 	}
 }
 
+/**
+ * @brief Build the username filter, the username index and the user directory from the database.
+ * @details Those of a previous database are replaced. The program is terminated on failure.
+ */
+static void build_lookups(void)
+{
+	if (!user_filter_build(database))
+		print_error_plain_exit("failed initializing username filter");
+
+	index_t *index = index_initialize(database);
+	if (index == NULL)
+		print_error_plain_exit("failed initializing username index");
+
+	index_destroy(user_index);
+	user_index = index;
+
+	if (!user_directory_build(database))
+		print_error_plain_exit("failed initializing user directory");
+}
+
+/**
+ * @brief Receive the state of the running server the standby just connected to.
+ * @details The state of the standby is only replaced if the state of the running server was received completely. Otherwise, the connection is closed.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool standby_sync(void)
+{
+	database_t *previous_database = database;
+	list_t *previous_clients = clients;
+
+	int fd = -1, listen_fd = -1, journal_fd = -1;
+	size_t connections = 0;
+
+	// the standby admits as many clients as configured
+	unsigned depth;
+
+	database = database_initialize();
+	clients = list_initialize();
+
+	// a standby is not sent any sockets
+	bool success = database != NULL && clients != NULL &&
+		handover_receive(journal->fd, &options.secret_cap, &depth, &fd, &listen_fd, &journal_fd, &connections) &&
+		fd == -1 && listen_fd == -1 && journal_fd == -1 && connections == 0;
+
+	if (!success) {
+		database_destroy(database);
+		list_destroy(clients);
+		database = previous_database;
+		clients = previous_clients;
+		journal_disconnect(journal);
+		return false;
+	}
+
+	database_destroy(previous_database);
+	list_destroy(previous_clients);
+	build_lookups();
+
+	journal->secret_cap = options.secret_cap;
+	return true;
+}
+
+/**
+ * @brief The main loop of a standby server.
+ * @details The standby applies the journal of the running server, and connects again whenever the connection ends, as the running server may have handed over to a new one or dropped the standby. The main loop ends once the server the standby was connected to has exited.
+ * @return `true` if the running server is gone, `false` if the standby was asked to shut down.
+ */
+static bool run_standby(void)
+{
+	journal = journal_standby();
+	if (journal == NULL)
+		print_error_plain_exit("failed initializing journal");
+
+	if (!journal_connect(journal) || !standby_sync())
+		print_error_plain_exit("failed synchronizing with the running server");
+
+	while (running) {
+		if (dump_stats) {
+			dump_stats = false;
+			print_stats(stderr);
+		}
+
+		if (journal_follow(journal, JOURNAL_HEARTBEAT))
+			continue;
+
+		if (journal_connect(journal)) {
+			standby_sync();
+			continue;
+		}
+
+		if (journal_primary_gone(journal, STANDBY_RETRY))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Release the shared resources left behind by a server that is gone.
+ * @details Clients waiting for the server are woken up as on a shutdown, so that they notice it is offline. The resources are removed, so that they can be created anew.
+ */
+static void release_abandoned(void)
+{
+	int fd = shm_open(shard_name(SHM_NAME), O_RDWR, 0);
+	if (fd != -1) {
+		void *mem = mmap(NULL, SHM_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (mem != MAP_FAILED) {
+			set_status_offline(mem);
+			munmap(mem, SHM_LEN);
+		}
+
+		close(fd);
+		shm_unlink(shard_name(SHM_NAME));
+	}
+
+	sem_t *sem = sem_open(shard_name(SEM_SERVER2), 0);
+	if (sem != SEM_FAILED) {
+		sem_settle(sem);
+		sem_close(sem);
+	}
+
+	lanes_t *abandoned = lanes_open(false, LANE_WEIGHT_DEFAULT, LANE_DEPTH_DEFAULT);
+	if (abandoned != NULL)
+		lanes_settle(abandoned);
+
+	lanes_destroy(abandoned, true);
+
+	sem_unlink(shard_name(SEM_SERVER1));
+	sem_unlink(shard_name(SEM_SERVER2));
+}
+
 /**
  * @brief Enty point of the server.
- * @details This function is called upon program start. First, resources are set up and `argv` is parsed. Then, the database is read whereupon the server waits for a clients to connect and handles incoming requests. On server termination, resources are cleaned up and the database is saved.
+ * @details This function is called upon program start. First, resources are set up and `argv` is parsed. Then, the database is read, or taken over together with the sessions of the running server, or followed as a standby until the running server is gone, whereupon the server waits for a clients to connect and handles incoming requests. On server termination, resources are cleaned up and the database is saved.
  * @param argc Cardinality of `argv`.
  * @param argv Program argument vector.
  * @return `EXIT_FAILURE` on error, `EXIT_SUCCESS` otherwise.
@@ -182,42 +593,211 @@ int main(int argc, char *argv[])
 	if (errind == -1)
 		print_error_exit("failed registering signal handler");
 
+	act.sa_handler = handler_stats;
+
+	errind = sigaction(SIGUSR1, &act, NULL);
+	if (errind == -1)
+		print_error_exit("failed registering signal handler");
+
+	act.sa_handler = handler_handover;
+
+	errind = sigaction(SIGUSR2, &act, NULL);
+	if (errind == -1)
+		print_error_exit("failed registering signal handler");
+
 	errind = atexit(cleanup);
 	if (errind != 0)
 		print_error_exit("failed registering cleanup function");
 
 	parse_arguments(argc, argv, &options);
+	shard_select(options.shard, options.shards);
+
+	// fail early rather than on names taken by a shard of the running cluster
+	unsigned cluster = cluster_shards();
+	if (cluster > 1 && cluster != options.shards)
+		print_error_plain_exit("running cluster has a different number of shards");
+
+	// memory is allocated on the node of the CPU touching it first
+	if (options.cpus != NULL && !placement_pin(options.cpus))
+		print_error_exit("failed setting CPU affinity");
+
+	placement_configure(options.huge_pages, options.lock_memory);
 
-	database = list_initialize();
+	// a replica only maps what the server publishes
+	if (options.replica >= 0) {
+		owner = false;
+		run_replica();
+		return EXIT_SUCCESS;
+	}
+
+	errind = token_init();
+	if (errind != 0)
+		print_error_exit("failed generating token key");
+
+	database = database_initialize();
 	if (database == NULL)
-		print_error_plain_exit("failed initializing database list");
+		print_error_plain_exit("failed initializing database");
 
 	clients = list_initialize();
 	if (clients == NULL)
 		print_error_plain_exit("failed initializing clients list");
 
-	if (options.database_path != NULL) {
+	int handover_sock = -1;
+	int listen_fd = -1;
+	int journal_fd = -1;
+	size_t connections = 0;
+
+	// nothing is removed on failure while the running server still owns the resources
+	if (options.standby) {
+		owner = false;
+
+		if (!run_standby())
+			return EXIT_SUCCESS;
+
+		journal_destroy(journal);
+		journal = NULL;
+
+		release_abandoned();
+		owner = true;
+	} else if (options.handover) {
+		owner = false;
+
+		handover_sock = handover_request();
+		if (handover_sock < 0)
+			print_error_exit("failed connecting to the running server");
+
+		if (!handover_receive(handover_sock, &options.secret_cap, &options.depth, &fdsock, &listen_fd, &journal_fd, &connections))
+			print_error_plain_exit("failed receiving the state of the running server");
+	} else if (options.database_path != NULL) {
 		errind = read_database(&options.database_path, database);
 		if (errind != 0)
 			print_error_plain_exit("failed reading database");
+
+		// users of another shard could never log in
+		for (size_t i = 0; i < database->length; i++) {
+			if (!shard_owns(database->entries[i].username))
+				print_error_plain_exit("database holds users of other shards, rebalance it first");
+		}
 	}
 
-	sem1 = sem_open(SEM_SERVER1, O_CREAT | O_EXCL, 0660, 0);
+	// a standby built them whenever it was synchronized
+	if (!options.standby)
+		build_lookups();
+
+	// sessions taken over may belong to clients that exited meanwhile
+	reaper = reaper_create();
+	if (reaper == NULL)
+		print_error_exit("failed creating reaper");
+
+	reaper_adopt(reaper, clients);
+
+	// the semaphores keep their values if taken over
+	int oflag = options.handover ? 0 : O_CREAT | O_EXCL;
+
+	sem1 = sem_open(shard_name(SEM_SERVER1), oflag, 0660, 0);
 	if (sem1 == SEM_FAILED)
 		print_error_exit("failed opening semaphore");
 
-	sem2 = sem_open(SEM_SERVER2, O_CREAT | O_EXCL, 0660, 1);
+	sem2 = sem_open(shard_name(SEM_SERVER2), oflag, 0660, 0);
 	if (sem2 == SEM_FAILED)
 		print_error_exit("failed opening semaphore");
 
-	sem3 = sem_open(SEM_CLIENT1, O_CREAT | O_EXCL, 0660, 1);
-	if (sem3 == SEM_FAILED)
+	lanes = lanes_open(!options.handover, options.weight, options.depth);
+	if (lanes == NULL)
 		print_error_exit("failed opening semaphore");
 
-	memfd = create_shared_memory(SHM_NAME, SHM_LEN, true);
+	shmlen = SHM_ARENA_OFFSET + options.secret_cap + 1;
+	memfd = create_shared_memory(shard_name(SHM_NAME), &shmlen, !options.handover);
 	if (memfd < 0)
 		print_error_exit("failed creating shared memory");
 
+	// the table keeps its counters, as its size does not change
+	watch_table = watch_open(true);
+	if (watch_table == NULL)
+		print_error_exit("failed creating watch table");
+
+	if (fdsock < 0 && options.fd_passing) {
+		fdsock = unix_listen(shard_name(FD_SOCKET_NAME), SOCK_STREAM);
+		if (fdsock < 0)
+			print_error_exit("failed opening descriptor passing socket");
+	}
+
+	if (options.transport || listen_fd >= 0) {
+		transport = transport_create(shard_name(TRANSPORT_SOCKET_NAME), handle_message, options.secret_cap, options.uring, listen_fd);
+
+		// the ring of a server that is gone may keep its socket bound for a moment after it exited
+		struct timespec retry = { .tv_sec = 0, .tv_nsec = STANDBY_RETRY * 1000000L };
+		for (int waited = 0; transport == NULL && options.standby && waited < HANDOVER_TIMEOUT; waited += STANDBY_RETRY) {
+			nanosleep(&retry, NULL);
+			transport = transport_create(shard_name(TRANSPORT_SOCKET_NAME), handle_message, options.secret_cap, options.uring, listen_fd);
+		}
+
+		if (transport == NULL)
+			print_error_exit("failed starting socket transport");
+	}
+
+	if (options.handover) {
+		if (!handover_adopt(handover_sock, transport, connections))
+			print_error_plain_exit("failed adopting the connections of the running server");
+
+		if (!handover_complete(handover_sock))
+			print_error_plain_exit("running server did not hand over");
+
+		owner = true;
+	}
+
+	// buckets depend on the key of the index, so cached secrets have to be read again
+	if (options.handover || options.standby) {
+		for (size_t i = 0; i < WATCH_BUCKETS; i++)
+			watch_notify(&watch_table[i]);
+	}
+
+	if (options.journal || journal_fd >= 0) {
+		journal = journal_create(journal_fd);
+		if (journal == NULL)
+			print_error_exit("failed opening journal socket");
+	}
+
+	if (options.user_rate > 0) {
+		user_limits = ratelimit_create(options.user_rate);
+		if (user_limits == NULL)
+			print_error_exit("failed creating rate limiter");
+	}
+
+	if (options.client_rate > 0) {
+		client_limits = ratelimit_create(options.client_rate);
+		if (client_limits == NULL)
+			print_error_exit("failed creating rate limiter");
+
+		unsigned long shared_rate = (unsigned long) options.client_rate * RATELIMIT_SHARED_CLIENTS;
+		shared_limits = ratelimit_create(shared_rate < RATELIMIT_RATE_MAX ? shared_rate : RATELIMIT_RATE_MAX);
+		if (shared_limits == NULL)
+			print_error_exit("failed creating rate limiter");
+	}
+
+	// the copy for replicas is mapped afterwards, as it reserves far more than it uses
+	if (options.lock_memory && !placement_lock())
+		print_error_exit("failed locking memory");
+
+	if (options.publish) {
+		replica = replica_create(options.secret_cap);
+		if (replica == NULL)
+			print_error_exit("failed publishing the database for replicas");
+	}
+
+	if (transport != NULL && transport_resume(transport) != 0)
+		print_error_exit("failed starting socket transport");
+
+	errind = handover_listen();
+	if (errind != 0)
+		print_error_exit("failed opening handover socket");
+
+	errind = cluster_join();
+	if (errind == -2)
+		print_error_plain_exit("running cluster has a different number of shards");
+	else if (errind != 0)
+		print_error_exit("failed joining the cluster");
+
 	// set server flag to online
 	set_status_online(shmem);
 
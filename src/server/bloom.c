@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function definitions for a counting Bloom filter.
+ * @details Items are mapped to `BLOOM_HASHES` counters by double hashing a single SipHash value.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bloom.h"
+#include "placement.h"
+
+/**
+ * @brief Compute the base hash values of an item.
+ * @param bloom The filter to hash for.
+ * @param item The item to hash.
+ * @param h1 The first hash value.
+ * @param h2 The second hash value, used as stride.
+ */
+static void bloom_hash(bloom_t *bloom, const char *item, uint64_t *h1, uint64_t *h2)
+{
+	uint64_t h = siphash(bloom->key, item, strlen(item));
+
+	*h1 = h & 0xffffffff;
+	*h2 = (h >> 32) | 1;
+}
+
+bloom_t *bloom_initialize(size_t capacity)
+{
+	if (capacity < BLOOM_MIN_CAPACITY)
+		capacity = BLOOM_MIN_CAPACITY;
+
+	bloom_t *bloom = malloc(sizeof(bloom_t));
+	if (bloom == NULL)
+		return NULL;
+
+	memset(bloom, 0, sizeof(bloom_t));
+	bloom->capacity = capacity;
+	bloom->size = capacity * BLOOM_COUNTERS_PER_ITEM;
+
+	bloom->counters = placement_alloc(bloom->size * sizeof(uint8_t));
+	if (bloom->counters == NULL) {
+		free(bloom);
+		return NULL;
+	}
+
+	if (hash_key_generate(bloom->key) != 0) {
+		placement_free(bloom->counters, bloom->size * sizeof(uint8_t));
+		free(bloom);
+		return NULL;
+	}
+
+	return bloom;
+}
+
+void bloom_destroy(bloom_t *bloom)
+{
+	if (bloom == NULL)
+		return;
+
+	placement_free(bloom->counters, bloom->size * sizeof(uint8_t));
+	free(bloom);
+}
+
+void bloom_add(bloom_t *bloom, const char *item)
+{
+	uint64_t h1, h2;
+	bloom_hash(bloom, item, &h1, &h2);
+
+	for (uint64_t i = 0; i < BLOOM_HASHES; i++) {
+		uint8_t *c = &bloom->counters[(h1 + i * h2) % bloom->size];
+
+		if (*c == 0)
+			bloom->used += 1;
+
+		if (*c < UINT8_MAX)
+			*c += 1;
+	}
+
+	bloom->count += 1;
+}
+
+void bloom_remove(bloom_t *bloom, const char *item)
+{
+	uint64_t h1, h2;
+	bloom_hash(bloom, item, &h1, &h2);
+
+	for (uint64_t i = 0; i < BLOOM_HASHES; i++) {
+		uint8_t *c = &bloom->counters[(h1 + i * h2) % bloom->size];
+
+		// a saturated counter has lost track of its true value
+		if (*c == 0 || *c == UINT8_MAX)
+			continue;
+
+		*c -= 1;
+
+		if (*c == 0)
+			bloom->used -= 1;
+	}
+
+	if (bloom->count > 0)
+		bloom->count -= 1;
+}
+
+bool bloom_contains(bloom_t *bloom, const char *item)
+{
+	uint64_t h1, h2;
+	bloom_hash(bloom, item, &h1, &h2);
+
+	bloom->lookups += 1;
+
+	for (uint64_t i = 0; i < BLOOM_HASHES; i++) {
+		if (bloom->counters[(h1 + i * h2) % bloom->size] == 0) {
+			bloom->rejections += 1;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+double bloom_fp_rate(bloom_t *bloom)
+{
+	double fill = (double) bloom->used / bloom->size;
+	double rate = 1;
+
+	for (int i = 0; i < BLOOM_HASHES; i++)
+		rate *= fill;
+
+	return rate;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function declarations for a counting Bloom filter.
+ * @details The filter answers whether an item might be in a set. A negative answer is definite, a positive answer may be a false positive.
+ */
+
+#ifndef __BLOOM_H__
+#define __BLOOM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+
+/**
+ * @brief The number of counters reserved for each item the filter is sized for.
+ */
+#define BLOOM_COUNTERS_PER_ITEM 10
+
+/**
+ * @brief The number of counters an item maps to.
+ * @details Together with `BLOOM_COUNTERS_PER_ITEM`, this yields a false positive rate below one percent at full capacity.
+ */
+#define BLOOM_HASHES 7
+
+/**
+ * @brief The minimum number of items a filter is sized for.
+ */
+#define BLOOM_MIN_CAPACITY 64
+
+/**
+ * @brief Representation of a counting Bloom filter.
+ */
+typedef struct {
+	uint8_t *counters; ///< Saturating counters of the filter.
+	size_t size; ///< Number of counters.
+	size_t used; ///< Number of counters that are not zero.
+	size_t count; ///< Number of items in the filter.
+	size_t capacity; ///< Number of items the filter is sized for.
+	uint8_t key[HASH_KEY_SIZE]; ///< Key used to hash items.
+	unsigned long lookups; ///< Number of lookups performed.
+	unsigned long rejections; ///< Number of lookups answered negatively.
+	unsigned long false_positives; ///< Number of positive answers reported to be wrong.
+} bloom_t;
+
+/**
+ * @brief Create a new filter.
+ * @param capacity The number of items to size the filter for.
+ * @return The memory address of the filter, or `NULL` on failure.
+ */
+bloom_t *bloom_initialize(size_t capacity);
+
+/**
+ * @brief Destroy the filter `bloom` created previously.
+ * @param bloom The filter to destroy.
+ */
+void bloom_destroy(bloom_t *bloom);
+
+/**
+ * @brief Add the item `item` to the filter `bloom`.
+ * @param bloom The filter to add the item to.
+ * @param item The item to add.
+ */
+void bloom_add(bloom_t *bloom, const char *item);
+
+/**
+ * @brief Remove the item `item` from the filter `bloom`.
+ * @details The item must have been added before. Saturated counters are left untouched.
+ * @param bloom The filter to remove the item from.
+ * @param item The item to remove.
+ */
+void bloom_remove(bloom_t *bloom, const char *item);
+
+/**
+ * @brief Check if the item `item` might be in the filter `bloom`.
+ * @param bloom The filter to query.
+ * @param item The item to look for.
+ * @return `false` if the item is definitely not in the filter, `true` otherwise.
+ */
+bool bloom_contains(bloom_t *bloom, const char *item);
+
+/**
+ * @brief Estimate the current false positive rate of the filter `bloom`.
+ * @details The estimate is derived from the share of counters that are not zero.
+ * @param bloom The filter to consider.
+ * @return The probability of a positive answer for an item not in the filter.
+ */
+double bloom_fp_rate(bloom_t *bloom);
+
+#endif
@@ -0,0 +1,305 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function definitions for ordered sets of strings.
+ * @details The set is a crit-bit tree. Internal nodes store the position of the first bit in which their two subtrees differ, and the leaves point to strings owned by the caller. Lookups and successor queries touch one node per critical bit.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "critbit.h"
+
+/**
+ * @brief Determine the subtree of the node `node` the string `str` belongs to.
+ * @param node The node to consider.
+ * @param str The string to consider.
+ * @param len The length of `str`.
+ * @return `0` for the left subtree, `1` for the right subtree.
+ */
+static int critbit_direction(critbit_node_t *node, const char *str, size_t len)
+{
+	uint8_t c = 0;
+	if (node->byte < len)
+		c = (uint8_t) str[node->byte];
+
+	return (1 + (node->otherbits | c)) >> 8;
+}
+
+/**
+ * @brief Find the leaf the string `str` would be placed next to.
+ * @param tree The tree to search, which must not be empty.
+ * @param str The string to consider.
+ * @param len The length of `str`.
+ * @return The string stored in the leaf.
+ */
+static const char *critbit_best(critbit_t *tree, const char *str, size_t len)
+{
+	void *p = tree->root;
+	bool leaf = tree->root_leaf;
+
+	while (!leaf) {
+		critbit_node_t *node = p;
+		int dir = critbit_direction(node, str, len);
+		leaf = (node->leaves >> dir) & 1;
+		p = node->child[dir];
+	}
+
+	return p;
+}
+
+/**
+ * @brief Find the first bit in which the strings `str` and `best` differ.
+ * @param str The first string.
+ * @param len The length of `str`.
+ * @param best The second string.
+ * @param byte Set to the index of the byte holding the differing bit.
+ * @param otherbits Set to all bits except the differing bit.
+ * @return `true` if the strings differ, `false` if they are equal.
+ */
+static bool critbit_differ(const char *str, size_t len, const char *best, uint32_t *byte, uint8_t *otherbits)
+{
+	uint32_t i;
+	uint32_t bits = 0;
+
+	for (i = 0; i < len; i++) {
+		bits = (uint8_t) str[i] ^ (uint8_t) best[i];
+		if (bits != 0)
+			break;
+	}
+
+	if (i == len) {
+		bits = (uint8_t) best[i];
+		if (bits == 0)
+			return false;
+	}
+
+	// keep only the most significant differing bit
+	bits |= bits >> 1;
+	bits |= bits >> 2;
+	bits |= bits >> 4;
+	bits = (bits & ~(bits >> 1)) ^ 255;
+
+	*byte = i;
+	*otherbits = bits;
+	return true;
+}
+
+/**
+ * @brief Find the smallest string of a subtree.
+ * @param p The root of the subtree.
+ * @param leaf Whether `p` is a string.
+ * @return The smallest string.
+ */
+static const char *critbit_min(void *p, bool leaf)
+{
+	while (!leaf) {
+		critbit_node_t *node = p;
+		leaf = node->leaves & 1;
+		p = node->child[0];
+	}
+
+	return p;
+}
+
+/**
+ * @brief Free all internal nodes of a subtree.
+ * @param p The root of the subtree.
+ * @param leaf Whether `p` is a string.
+ */
+static void critbit_free(void *p, bool leaf)
+{
+	if (leaf || p == NULL)
+		return;
+
+	critbit_node_t *node = p;
+	critbit_free(node->child[0], node->leaves & 1);
+	critbit_free(node->child[1], (node->leaves >> 1) & 1);
+	free(node);
+}
+
+critbit_t *critbit_initialize(void)
+{
+	critbit_t *tree = malloc(sizeof(critbit_t));
+	if (tree == NULL)
+		return NULL;
+
+	tree->root = NULL;
+	tree->root_leaf = false;
+	tree->count = 0;
+	tree->nodes = 0;
+
+	return tree;
+}
+
+void critbit_destroy(critbit_t *tree)
+{
+	if (tree == NULL)
+		return;
+
+	critbit_free(tree->root, tree->root_leaf);
+	free(tree);
+}
+
+bool critbit_insert(critbit_t *tree, const char *str)
+{
+	size_t len = strlen(str);
+
+	if (tree->root == NULL) {
+		tree->root = (void *) str;
+		tree->root_leaf = true;
+		tree->count = 1;
+		return true;
+	}
+
+	uint32_t newbyte;
+	uint8_t newotherbits;
+	const char *best = critbit_best(tree, str, len);
+	if (!critbit_differ(str, len, best, &newbyte, &newotherbits))
+		return true;
+
+	critbit_node_t *node = malloc(sizeof(critbit_node_t));
+	if (node == NULL)
+		return false;
+
+	uint8_t c = (uint8_t) best[newbyte];
+	int newdirection = (1 + (newotherbits | c)) >> 8;
+
+	node->byte = newbyte;
+	node->otherbits = newotherbits;
+	node->child[1 - newdirection] = (void *) str;
+	node->leaves = 1 << (1 - newdirection);
+
+	// walk down to the place of the new node
+	critbit_node_t *parent = NULL;
+	int dir = 0;
+	void *p = tree->root;
+	bool leaf = tree->root_leaf;
+
+	while (!leaf) {
+		critbit_node_t *q = p;
+		if (q->byte > newbyte || (q->byte == newbyte && q->otherbits > newotherbits))
+			break;
+
+		parent = q;
+		dir = critbit_direction(q, str, len);
+		leaf = (q->leaves >> dir) & 1;
+		p = q->child[dir];
+	}
+
+	node->child[newdirection] = p;
+	if (leaf)
+		node->leaves |= 1 << newdirection;
+
+	if (parent == NULL) {
+		tree->root = node;
+		tree->root_leaf = false;
+	} else {
+		parent->child[dir] = node;
+		parent->leaves &= ~(1 << dir);
+	}
+
+	tree->count += 1;
+	tree->nodes += 1;
+	return true;
+}
+
+bool critbit_remove(critbit_t *tree, const char *str)
+{
+	if (tree->root == NULL)
+		return false;
+
+	size_t len = strlen(str);
+	critbit_node_t *grandparent = NULL;
+	critbit_node_t *parent = NULL;
+	int gpdir = 0;
+	int dir = 0;
+	void *p = tree->root;
+	bool leaf = tree->root_leaf;
+
+	while (!leaf) {
+		grandparent = parent;
+		gpdir = dir;
+		parent = p;
+		dir = critbit_direction(parent, str, len);
+		leaf = (parent->leaves >> dir) & 1;
+		p = parent->child[dir];
+	}
+
+	if (strcmp(p, str) != 0)
+		return false;
+
+	tree->count -= 1;
+
+	if (parent == NULL) {
+		tree->root = NULL;
+		tree->root_leaf = false;
+		return true;
+	}
+
+	// the sibling takes the place of the parent
+	void *sibling = parent->child[1 - dir];
+	bool sibling_leaf = (parent->leaves >> (1 - dir)) & 1;
+
+	if (grandparent == NULL) {
+		tree->root = sibling;
+		tree->root_leaf = sibling_leaf;
+	} else {
+		grandparent->child[gpdir] = sibling;
+		grandparent->leaves &= ~(1 << gpdir);
+		grandparent->leaves |= sibling_leaf << gpdir;
+	}
+
+	free(parent);
+	tree->nodes -= 1;
+	return true;
+}
+
+const char *critbit_next(critbit_t *tree, const char *after)
+{
+	if (tree->root == NULL)
+		return NULL;
+
+	if (after == NULL)
+		return critbit_min(tree->root, tree->root_leaf);
+
+	size_t len = strlen(after);
+	uint32_t newbyte = 0;
+	uint8_t newotherbits = 0;
+	const char *best = critbit_best(tree, after, len);
+	bool differ = critbit_differ(after, len, best, &newbyte, &newotherbits);
+
+	// the right subtree of the lowest node left on the way down holds the successor
+	void *succ = NULL;
+	bool succ_leaf = false;
+	void *p = tree->root;
+	bool leaf = tree->root_leaf;
+
+	while (!leaf) {
+		critbit_node_t *q = p;
+		if (differ && (q->byte > newbyte || (q->byte == newbyte && q->otherbits > newotherbits)))
+			break;
+
+		int dir = critbit_direction(q, after, len);
+		if (dir == 0) {
+			succ = q->child[1];
+			succ_leaf = (q->leaves >> 1) & 1;
+		}
+
+		leaf = (q->leaves >> dir) & 1;
+		p = q->child[dir];
+	}
+
+	// all strings below `p` are greater than `after` if it sorts before them
+	if (differ) {
+		uint8_t c = (uint8_t) best[newbyte];
+		if ((1 + (newotherbits | c)) >> 8 == 1)
+			return critbit_min(p, leaf);
+	}
+
+	if (succ == NULL)
+		return NULL;
+
+	return critbit_min(succ, succ_leaf);
+}
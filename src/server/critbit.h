@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function declarations for ordered sets of strings.
+ * @details The set is a crit-bit tree. Internal nodes store the position of the first bit in which their two subtrees differ, and the leaves point to strings owned by the caller. Lookups and successor queries touch one node per critical bit.
+ */
+
+#ifndef __CRITBIT_H__
+#define __CRITBIT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Internal node of a crit-bit tree.
+ */
+typedef struct {
+	void *child[2]; ///< Subtrees, the left one holds the strings with the critical bit cleared.
+	uint32_t byte; ///< Index of the byte holding the critical bit.
+	uint8_t otherbits; ///< All bits except the critical bit set.
+	uint8_t leaves; ///< Bit `i` is set if `child[i]` is a string.
+} critbit_node_t;
+
+/**
+ * @brief Representation of a crit-bit tree.
+ */
+typedef struct {
+	void *root; ///< Root of the tree, `NULL` if it is empty.
+	bool root_leaf; ///< Whether the root is a string.
+	size_t count; ///< Number of strings in the tree.
+	size_t nodes; ///< Number of internal nodes.
+} critbit_t;
+
+/**
+ * @brief Create a new, empty tree.
+ * @return The memory address of the tree, or `NULL` on failure.
+ */
+critbit_t *critbit_initialize(void);
+
+/**
+ * @brief Destroy the tree `tree`.
+ * @details The strings are not freed.
+ * @param tree The tree to destroy.
+ */
+void critbit_destroy(critbit_t *tree);
+
+/**
+ * @brief Insert the string `str` into the tree.
+ * @details The tree keeps a reference to `str`, which must not change while it is in the tree.
+ * @param tree The tree to modify.
+ * @param str The string to insert.
+ * @return `true` if the string is in the tree afterwards, `false` on failure.
+ */
+bool critbit_insert(critbit_t *tree, const char *str);
+
+/**
+ * @brief Remove the string `str` from the tree.
+ * @param tree The tree to modify.
+ * @param str The string to remove.
+ * @return `true` if the string was removed, `false` if it was not in the tree.
+ */
+bool critbit_remove(critbit_t *tree, const char *str);
+
+/**
+ * @brief Find the smallest string greater than `after`.
+ * @details Strings are ordered bytewise. The string `after` does not need to be in the tree.
+ * @param tree The tree to search.
+ * @param after The string to start after, or `NULL` to find the smallest string.
+ * @return The string, or `NULL` if there is none.
+ */
+const char *critbit_next(critbit_t *tree, const char *after);
+
+#endif
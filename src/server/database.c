@@ -3,54 +3,369 @@
  * @author eikendev, https://eiken.dev/
  * @date 2018-01-04
  * @brief This module contains function definitions for basic database operations.
- * @details Basic database operations include database reading and database writing.
+ * @details Basic database operations include database reading and database writing, as well as managing the in-memory representation of the entries.
  */
 
 #include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <sys/mman.h>
 
 #include "database.h"
+#include "kvmap.h"
 
 #include "../share/utils.h"
 
-int read_database(char **path, list_t *database)
+/**
+ * @brief Split off the next field of a database line.
+ * @details The separator is replaced by a null byte.
+ * @param field The current field.
+ * @return The next field, or `NULL` if `field` is the last one.
+ */
+static char *split_field(char *field)
 {
-	int errind = 0;
+	if (field == NULL)
+		return NULL;
 
-	if (*path == NULL || database == NULL)
-		return 1;
+	char *sep = strchr(field, ';');
+	if (sep == NULL)
+		return NULL;
 
-	FILE *fp = fopen(*path, "r");
-	if (fp == NULL)
-		print_error_exit("failed opening file");
+	*sep = '\0';
+	return sep + 1;
+}
+
+database_t *database_initialize(void)
+{
+	database_t *database = malloc(sizeof(database_t));
+	if (database == NULL)
+		return NULL;
+
+	database->entries = malloc(DATABASE_MIN_CAPACITY * sizeof(entry_t));
+	database->strings = arena_initialize();
+
+	if (database->entries == NULL || database->strings == NULL) {
+		free(database->entries);
+		arena_destroy(database->strings);
+		free(database);
+		return NULL;
+	}
+
+	database->length = 0;
+	database->capacity = DATABASE_MIN_CAPACITY;
+	database->blob_bytes = 0;
+	database->memfd_bytes = 0;
+	database->version_base = (uint64_t) time(NULL) << 32;
+	database->expiring = 0;
+	database->expired = 0;
+
+	return database;
+}
+
+void database_destroy(database_t *database)
+{
+	if (database == NULL)
+		return;
+
+	for (size_t i = 0; i < database->length; i++) {
+		secret_clear(database, &database->entries[i].secret);
+		kvmap_destroy(database->entries[i].keys, database);
+	}
+
+	free(database->entries);
+	arena_destroy(database->strings);
+	free(database);
+}
+
+entry_t *database_add(database_t *database, char *username, char *password, char *secret)
+{
+	if (database->length == database->capacity) {
+		size_t capacity = 2 * database->capacity;
+
+		entry_t *entries = realloc(database->entries, capacity * sizeof(entry_t));
+		if (entries == NULL)
+			return NULL;
+
+		database->entries = entries;
+		database->capacity = capacity;
+	}
+
+	entry_t *e = &database->entries[database->length];
+	memset(e, 0, sizeof(entry_t));
+
+	arena_mark_t mark = arena_mark(database->strings);
+
+	e->username = arena_strdup(database->strings, username, strlen(username));
+	e->password = arena_strdup(database->strings, password, strlen(password));
+
+	if (e->username == NULL || e->password == NULL ||
+		!secret_set(database, &e->secret, secret, strlen(secret))) {
+		arena_rewind(database->strings, mark);
+		return NULL;
+	}
+
+	e->version = database->version_base;
+
+	database->length += 1;
+	return e;
+}
+
+char *secret_data(secret_t *s)
+{
+	switch (s->kind) {
+	case SECRET_BLOB:
+		return s->data.blob;
+	case SECRET_MEMFD:
+		return s->data.memfd.map;
+	default:
+		return s->data.small;
+	}
+}
+
+bool secret_set(database_t *database, secret_t *s, const char *secret, size_t len)
+{
+	secret_t next;
+
+	if (len >= SECRET_INLINE_LEN) {
+		next.data.blob = malloc(len + 1);
+		if (next.data.blob == NULL)
+			return false;
+
+		memcpy(next.data.blob, secret, len);
+		next.data.blob[len] = '\0';
+		next.kind = SECRET_BLOB;
+		database->blob_bytes += len + 1;
+	} else {
+		memcpy(next.data.small, secret, len);
+		next.data.small[len] = '\0';
+		next.kind = SECRET_INLINE;
+	}
+
+	next.len = len;
+
+	secret_clear(database, s);
+	*s = next;
+	return true;
+}
+
+bool secret_set_memfd(database_t *database, secret_t *s, int fd, size_t len)
+{
+	secret_t next;
+
+	if (len == 0)
+		return false;
+
+	next.data.memfd.map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (next.data.memfd.map == MAP_FAILED)
+		return false;
+
+	next.data.memfd.fd = fd;
+	next.len = len;
+	next.kind = SECRET_MEMFD;
+	database->memfd_bytes += len;
+
+	secret_clear(database, s);
+	*s = next;
+	return true;
+}
+
+void secret_clear(database_t *database, secret_t *s)
+{
+	switch (s->kind) {
+	case SECRET_BLOB:
+		free(s->data.blob);
+		database->blob_bytes -= s->len + 1;
+		break;
+	case SECRET_MEMFD:
+		munmap(s->data.memfd.map, s->len);
+		close(s->data.memfd.fd);
+		database->memfd_bytes -= s->len;
+		break;
+	default:
+		break;
+	}
+
+	s->data.small[0] = '\0';
+	s->len = 0;
+	s->kind = SECRET_INLINE;
+}
+
+void entry_set_expiry(database_t *database, entry_t *e, uint32_t expires)
+{
+	if (e->expires != 0)
+		database->expiring -= 1;
+
+	if (expires != 0)
+		database->expiring += 1;
+
+	e->expires = expires;
+}
+
+bool is_valid_key(char *key)
+{
+	if (strlen(key) > MAX_KEY_LEN || strchr(key, '=') != NULL)
+		return false;
+
+	return is_valid_field(key, false);
+}
+
+/**
+ * @brief Add a named secret read from a database line to an entry.
+ * @param database The database the entry belongs to.
+ * @param e The entry to add the secret to.
+ * @param field The field of the form `key=value`.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool read_key_field(database_t *database, entry_t *e, char *field)
+{
+	char *value = strchr(field, '=');
+	if (value == NULL)
+		return false;
+
+	*value++ = '\0';
+
+	if (!is_valid_key(field))
+		return false;
+
+	if (e->keys == NULL) {
+		e->keys = kvmap_initialize();
+		if (e->keys == NULL)
+			return false;
+	}
+
+	secret_t *s = kvmap_put(e->keys, database, field);
+	if (s == NULL)
+		return false;
+
+	return secret_set(database, s, value, strlen(value));
+}
+
+size_t database_memory(database_t *database)
+{
+	return sizeof(database_t) +
+		database->capacity * sizeof(entry_t) +
+		sizeof(arena_t) + database->strings->reserved +
+		database->blob_bytes + database->memfd_bytes;
+}
+
+int parse_database(FILE *fp, database_t *database)
+{
+	int errind = 0;
 
 	char *line = NULL;
 	size_t len_alloc = 0;
 	ssize_t len_line;
 	while ((len_line = getline(&line, &len_alloc, fp)) != -1) {
-		entry_t e;
-		memset(&e, 0, sizeof(e));
+		if (len_line > 0 && line[len_line - 1] == '\n')
+			line[len_line - 1] = '\0';
 
-		sscanf(line, "%[^\n;];%[^\n;];%[^\n;]\n", e.username, e.password, e.secret);
-		free(line);
+		char *username = line;
+		char *password = split_field(username);
+		char *secret = split_field(password);
+		char *keys = split_field(secret);
 
-		if (!is_valid_field(e.username, false) ||
-			!is_valid_field(e.password, false)) {
+		// the secret field is optional
+		if (secret == NULL)
+			secret = "";
+
+		if (password == NULL ||
+			strlen(username) > MAX_USERNAME_LEN ||
+			strlen(password) > MAX_PASSWORD_LEN ||
+			!is_valid_field(username, false) ||
+			!is_valid_field(password, false)) {
 			errind = 2;
-			*path = NULL;
 			break;
 		}
 
-		list_add(database, (obj_t) &e, sizeof(entry_t));
+		entry_t *e = database_add(database, username, password, secret);
+		if (e == NULL) {
+			errind = 3;
+			break;
+		}
+
+		while (keys != NULL) {
+			char *field = keys;
+			keys = split_field(field);
+
+			// the expiry time of the secret has no name
+			if (field[0] == '=') {
+				char *end;
+				unsigned long expires = strtoul(field + 1, &end, 10);
+
+				if (*end == '\0' && expires <= UINT32_MAX) {
+					entry_set_expiry(database, e, expires);
+					continue;
+				}
+			}
+
+			if (!read_key_field(database, e, field)) {
+				errind = 2;
+				break;
+			}
+		}
+
+		if (errind != 0)
+			break;
 	}
 
+	free(line);
+
+	return errind;
+}
+
+int read_database(char **path, database_t *database)
+{
+	if (*path == NULL || database == NULL)
+		return 1;
+
+	FILE *fp = fopen(*path, "r");
+	if (fp == NULL)
+		print_error_exit("failed opening file");
+
+	int errind = parse_database(fp, database);
+	if (errind != 0)
+		*path = NULL;
+
 	fclose(fp);
 
 	return errind;
 }
 
-int save_database(char *path, list_t *database)
+int dump_database(FILE *fp, database_t *database)
+{
+	time_t now = time(NULL);
+
+	for (size_t i = 0; i < database->length; i++) {
+		entry_t *e = &database->entries[i];
+		fprintf(fp, "%s;%s;", e->username, e->password);
+
+		if (!entry_expired(e, now)) {
+			fwrite(secret_data(&e->secret), 1, e->secret.len, fp);
+
+			if (e->expires != 0)
+				fprintf(fp, ";=%" PRIu32, e->expires);
+		}
+
+		for (uint32_t j = 0; e->keys != NULL && j < e->keys->capacity; j++) {
+			kvslot_t *slot = &e->keys->slots[j];
+			if (slot->key == NULL)
+				continue;
+
+			fprintf(fp, ";%s=", slot->key);
+			fwrite(secret_data(&slot->value), 1, slot->value.len, fp);
+		}
+
+		fputc('\n', fp);
+	}
+
+	return ferror(fp) ? 3 : 0;
+}
+
+int save_database(char *path, database_t *database)
 {
 	if (path == NULL || database == NULL)
 		return 1;
@@ -61,12 +376,9 @@ int save_database(char *path, list_t *database)
 		return 2;
 	}
 
-	for (element_t *curr = database->head; curr != NULL; curr = curr->next) {
-		entry_t *e = (entry_t *) curr->data;
-		fprintf(fp, "%s;%s;%s\n", e->username, e->password, e->secret);
-	}
+	int errind = dump_database(fp, database);
 
 	fclose(fp);
 
-	return 0;
+	return errind;
 }
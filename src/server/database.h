@@ -3,43 +3,220 @@
  * @author eikendev, https://eiken.dev/
  * @date 2018-01-04
  * @brief This module contains function declarations for basic database operations.
- * @details Basic database operations include database reading and database writing.
+ * @details Basic database operations include database reading and database writing, as well as managing the in-memory representation of the entries.
  */
 
 #ifndef __DATABASE_H__
 #define __DATABASE_H__
 
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
-#include "list.h"
+#include "arena.h"
 
 #include "../share/protocol.h"
 
+/**
+ * @brief The size of the inline buffer of a secret, including the null byte.
+ * @details Secrets that do not fit are stored out of line.
+ */
+#define SECRET_INLINE_LEN 16
+
+/**
+ * @brief The number of entries the database reserves initially.
+ */
+#define DATABASE_MIN_CAPACITY 64
+
+/**
+ * @brief Enum for the storage of a secret.
+ */
+typedef enum {
+	SECRET_INLINE, ///< The secret is stored inline.
+	SECRET_BLOB, ///< The secret is stored in a separate allocation.
+	SECRET_MEMFD ///< The secret is stored in a sealed memory file descriptor.
+} secret_kind_e;
+
+/**
+ * @brief Compact representation of a secret.
+ */
+typedef struct {
+	union {
+		char small[SECRET_INLINE_LEN]; ///< Inline storage for short secrets.
+		char *blob; ///< Out-of-line storage for long secrets.
+		struct {
+			char *map; ///< Read-only mapping of the file.
+			int fd; ///< Sealed memory file descriptor.
+		} memfd; ///< Storage for secrets passed as file descriptor.
+	} data; ///< Storage of the secret.
+	uint32_t len; ///< Length of the secret.
+	uint8_t kind; ///< Storage kind of the secret, see `secret_kind_e`.
+} secret_t;
+
+/**
+ * @brief Forward declaration of the per-user key map.
+ */
+struct kvmap_s;
+
 /**
  * @brief Struct for a database entry.
+ * @details Username and password are stored length-prefixed in the string arena of the database.
  */
 typedef struct {
-	char username[MAX_USERNAME_LEN + 1]; ///< Username field of the entry.
-	char password[MAX_PASSWORD_LEN + 1]; ///< Password field of the entry.
-	char secret[MAX_SECRET_LEN + 1]; ///< Secret field of the entry.
+	char *username; ///< Username field of the entry.
+	char *password; ///< Password field of the entry.
+	secret_t secret; ///< Secret field of the entry.
+	uint32_t generation; ///< Generation of the resumption tokens issued to the user.
+	uint32_t expires; ///< Time in seconds since the epoch at which the secret expires, `0` if it does not.
+	struct kvmap_s *keys; ///< Named secrets of the user, `NULL` if there are none.
+	uint64_t version; ///< Version of the secret, incremented on every write.
 } entry_t;
 
+/**
+ * @brief Representation of the database.
+ * @details Entries are kept in a contiguous array, which grows by doubling.
+ */
+typedef struct {
+	entry_t *entries; ///< Entries of the database.
+	size_t length; ///< Number of entries in the database.
+	size_t capacity; ///< Number of entries the array has room for.
+	arena_t *strings; ///< Arena holding usernames and passwords.
+	size_t blob_bytes; ///< Bytes held by out-of-line secrets.
+	size_t memfd_bytes; ///< Bytes held by secrets in memory file descriptors.
+	uint64_t version_base; ///< Version of secrets added to the database.
+	size_t expiring; ///< Number of secrets with an expiry time.
+	unsigned long expired; ///< Number of secrets cleared because they expired.
+} database_t;
+
+/**
+ * @brief Create a new, empty database.
+ * @details Versions of secrets are not stored in the database file. Instead, the upper half of every version is the time the database was created, so versions keep increasing across restarts as long as a secret is written less than 2^32 times in between.
+ * @return The memory address of the database, or `NULL` on failure.
+ */
+database_t *database_initialize(void);
+
+/**
+ * @brief Destroy the database `database` created previously.
+ * @param database The database to destroy.
+ */
+void database_destroy(database_t *database);
+
+/**
+ * @brief Add a new entry to the database.
+ * @details Pointers to existing entries may become invalid.
+ * @param database The database to add the entry to.
+ * @param username The username of the new entry.
+ * @param password The password of the new entry.
+ * @param secret The secret of the new entry.
+ * @return The new entry, or `NULL` on failure.
+ */
+entry_t *database_add(database_t *database, char *username, char *password, char *secret);
+
+/**
+ * @brief Retrieve the data of a secret.
+ * @details The data is null-terminated, unless the secret is stored in a memory file descriptor.
+ * @param s The secret to consider.
+ * @return The data of the secret, of length `s->len`.
+ */
+char *secret_data(secret_t *s);
+
+/**
+ * @brief Replace the value of a secret.
+ * @details Secrets shorter than `SECRET_INLINE_LEN` are stored inline, longer ones in a separate allocation.
+ * @param database The database the secret belongs to.
+ * @param s The secret to modify.
+ * @param secret The new value.
+ * @param len The length of `secret`.
+ * @return `true` on success, `false` otherwise.
+ */
+bool secret_set(database_t *database, secret_t *s, const char *secret, size_t len);
+
+/**
+ * @brief Replace the value of a secret by the contents of a sealed memory file descriptor.
+ * @details The file is mapped read-only, and the secret takes ownership of `fd`.
+ * @param database The database the secret belongs to.
+ * @param s The secret to modify.
+ * @param fd The sealed memory file descriptor.
+ * @param len The size of the file.
+ * @return `true` on success, `false` otherwise.
+ */
+bool secret_set_memfd(database_t *database, secret_t *s, int fd, size_t len);
+
+/**
+ * @brief Release the storage of a secret.
+ * @details The secret is empty afterwards.
+ * @param database The database the secret belongs to.
+ * @param s The secret to release.
+ */
+void secret_clear(database_t *database, secret_t *s);
+
+/**
+ * @brief Set the expiry time of the secret of an entry.
+ * @param database The database the entry belongs to.
+ * @param e The entry to modify.
+ * @param expires Time in seconds since the epoch at which the secret expires, `0` if it does not.
+ */
+void entry_set_expiry(database_t *database, entry_t *e, uint32_t expires);
+
+/**
+ * @brief Check if the secret of an entry is expired.
+ * @param e The entry to check.
+ * @param now The current time in seconds since the epoch.
+ * @return `true` if the secret is expired, `false` otherwise.
+ */
+static inline bool entry_expired(entry_t *e, time_t now)
+{
+	return e->expires != 0 && e->expires <= now;
+}
+
+/**
+ * @brief Check if `key` can be used as name of a secret.
+ * @param key The name to check.
+ * @return `true` for a valid name, `false` otherwise.
+ */
+bool is_valid_key(char *key);
+
+/**
+ * @brief Compute the memory held by the database.
+ * @return The number of bytes allocated for the database.
+ */
+size_t database_memory(database_t *database);
+
+/**
+ * @brief Read database entries from the stream `fp`.
+ * @details Lines are evaluated separately for database entries. Each line holds username, password and secret, followed by any number of named secrets in the form `key=value`, all separated by semicolons. A field of the form `=expires` holds the expiry time of the secret. Entries are added in the order of the lines.
+ * @param fp The stream to read from.
+ * @param database Database to store the entries in.
+ * @return `0` on success, positive integer on failure.
+ */
+int parse_database(FILE *fp, database_t *database);
+
 /**
  * @brief Read a database from a file.
- * @details Lines are evaluated separately for database entries.
+ * @details The file is parsed with `parse_database()`. On failure, `path` is set to `NULL` so the database is not saved over the file.
  * @param path Path to the file to read from.
- * @param database List to store the database in.
+ * @param database Database to store the entries in.
+ * @return `0` on success, positive integer on failure.
+ */
+int read_database(char **path, database_t *database);
+
+/**
+ * @brief Write the database entries to the stream `fp`.
+ * @details Lines are written iteratively for each entry, in the order of the entries. Expired secrets are left out.
+ * @param fp The stream to write to.
+ * @param database Database to write the entries of.
  * @return `0` on success, positive integer on failure.
  */
-int read_database(char **path, list_t *database);
+int dump_database(FILE *fp, database_t *database);
 
 /**
  * @brief Write a database to a file.
- * @details Lines are written iteratively for each entry.
+ * @details The file is written with `dump_database()`.
  * @param path Path to the file to write to.
- * @param database List to store the database in.
+ * @param database Database to write the entries of.
  * @return `0` on success, positive integer on failure.
  */
-int save_database(char *path, list_t *database);
+int save_database(char *path, database_t *database);
 
 #endif
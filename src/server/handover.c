@@ -0,0 +1,505 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for handing over the server to a new process.
+ * @details The running server sends a header holding the token key and the sizes of the state, together with two memory files and its listening sockets. The first file holds the database in the format of the database file, the second one the token generation and version of every entry, followed by the sessions. The connections of the transport follow in batches of `FDPASS_MAX`. The new server acknowledges the state, and the running server confirms after it closed its listening socket.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "handover.h"
+#include "database.h"
+#include "token.h"
+#include "list.h"
+#include "ipc.h"
+#include "user.h"
+#include "journal.h"
+#include "lane.h"
+
+#include "../share/utils.h"
+#include "../share/fdpass.h"
+#include "../share/shard.h"
+
+/**
+ * @brief Magic number of the handover, also used as acknowledgement.
+ */
+#define HANDOVER_MAGIC 0x68756d61
+
+/**
+ * @brief Version of the layout of the handover, to be incremented whenever it changes.
+ */
+#define HANDOVER_VERSION 4
+
+/**
+ * @brief The flag marking that the descriptor passing socket is sent.
+ */
+#define HANDOVER_FDSOCK 1
+
+/**
+ * @brief The flag marking that the listening socket of the transport is sent.
+ */
+#define HANDOVER_TRANSPORT 2
+
+/**
+ * @brief The flag marking that the listening socket of the journal is sent.
+ */
+#define HANDOVER_JOURNAL 4
+
+/**
+ * @brief The maximum number of descriptors sent with the header.
+ */
+#define HANDOVER_FDS 5
+
+/**
+ * @brief Header of the handover.
+ */
+typedef struct {
+	uint32_t magic; ///< Set to `HANDOVER_MAGIC`.
+	uint32_t version; ///< Set to `HANDOVER_VERSION`.
+	uint32_t flags; ///< The sockets sent after the memory files.
+	uint32_t secret_cap; ///< Maximum length of a secret.
+	uint32_t lane_depth; ///< Number of clients admitted to every lane.
+	uint64_t version_base; ///< Version of secrets added to the database.
+	uint64_t entries; ///< Number of entries of the database.
+	uint64_t sessions; ///< Number of sessions.
+	uint64_t connections; ///< Number of connections of the transport.
+	uint8_t token_key[HASH_KEY_SIZE]; ///< The key used to sign resumption tokens.
+} handover_header_t;
+
+/**
+ * @brief State of an entry that is not part of the database file.
+ */
+typedef struct {
+	uint64_t version; ///< Version of the secret.
+	uint32_t generation; ///< Generation of the resumption tokens.
+} handover_entry_t;
+
+/**
+ * @brief A connection of the transport.
+ */
+typedef struct {
+	pid_t pid; ///< Process id of the peer.
+	uid_t uid; ///< User id of the peer.
+	gid_t gid; ///< Group id of the peer.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id bound to the connection, empty if none.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the session.
+} handover_connection_t;
+
+/**
+ * @brief The database.
+ * @details This variable is required for the use of this module.
+ */
+extern database_t *database;
+
+/**
+ * @brief The client list.
+ * @details This variable is required for the use of this module.
+ */
+extern list_t *clients;
+
+/**
+ * @brief The socket used to pass secrets as file descriptors.
+ * @details This variable is required for the use of this module.
+ */
+extern int fdsock;
+
+/**
+ * @brief The socket transport.
+ * @details This variable is required for the use of this module.
+ */
+extern transport_t *transport;
+
+/**
+ * @brief The journal shipped to a standby server.
+ * @details This variable is required for the use of this module.
+ */
+extern journal_t *journal;
+
+/**
+ * @brief The lanes clients queue in.
+ * @details This variable is required for the use of this module.
+ */
+extern lanes_t *lanes;
+
+/**
+ * @brief The socket a new server connects to.
+ */
+static int handover_fd = -1;
+
+bool handover_peer(int sock, pid_t *pid)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1 || cred.uid != getuid())
+		return false;
+
+	struct timeval timeout = {
+		.tv_sec = HANDOVER_TIMEOUT / 1000,
+		.tv_usec = (HANDOVER_TIMEOUT % 1000) * 1000,
+	};
+
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1 ||
+		setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == -1)
+		return false;
+
+	if (pid != NULL)
+		*pid = cred.pid;
+
+	return true;
+}
+
+/**
+ * @brief Write the state that is not part of the database file to the stream `fp`.
+ * @param fp The stream to write to.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool handover_dump(FILE *fp)
+{
+	for (size_t i = 0; i < database->length; i++) {
+		handover_entry_t e;
+		memset(&e, 0, sizeof(e));
+		e.version = database->entries[i].version;
+		e.generation = database->entries[i].generation;
+
+		fwrite(&e, sizeof(e), 1, fp);
+	}
+
+	for (element_t *curr = clients->head; curr != NULL; curr = curr->next)
+		fwrite(curr->data, sizeof(client_t), 1, fp);
+
+	return fflush(fp) == 0 && !ferror(fp);
+}
+
+/**
+ * @brief Restore the state that is not part of the database file from the stream `fp`.
+ * @param fp The stream to read from.
+ * @param header The header of the handover.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool handover_restore(FILE *fp, handover_header_t *header)
+{
+	if (header->entries != database->length)
+		return false;
+
+	for (size_t i = 0; i < database->length; i++) {
+		handover_entry_t e;
+		if (fread(&e, sizeof(e), 1, fp) != 1)
+			return false;
+
+		database->entries[i].version = e.version;
+		database->entries[i].generation = e.generation;
+	}
+
+	database->version_base = header->version_base;
+
+	for (uint64_t i = 0; i < header->sessions; i++) {
+		client_t c;
+		if (fread(&c, sizeof(c), 1, fp) != 1)
+			return false;
+
+		c.session_id[SESSION_ID_SIZE] = '\0';
+		c.username[MAX_USERNAME_LEN] = '\0';
+
+		if (!user_login(clients, c.username, c.session_id, c.pid))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Send the connections of the transport.
+ * @param sock The connected socket.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool handover_send_connections(int sock)
+{
+	handover_connection_t batch[FDPASS_MAX];
+	int fds[FDPASS_MAX];
+	size_t count = 0;
+
+	memset(batch, 0, sizeof(batch));
+
+	for (connection_t *conn = transport->connections; conn != NULL; conn = conn->next) {
+		handover_connection_t *c = &batch[count];
+		c->pid = conn->pid;
+		c->uid = conn->uid;
+		c->gid = conn->gid;
+		memcpy(c->session_id, conn->session_id, sizeof(c->session_id));
+		memcpy(c->username, conn->username, sizeof(c->username));
+		fds[count++] = conn->fd;
+
+		if (count == FDPASS_MAX || conn->next == NULL) {
+			if (send_fds(sock, batch, count * sizeof(handover_connection_t), fds, count) != 0)
+				return false;
+
+			count = 0;
+		}
+	}
+
+	return true;
+}
+
+bool handover_send(int sock, size_t secret_cap, bool sockets)
+{
+	handover_header_t header;
+	memset(&header, 0, sizeof(header));
+
+	header.magic = HANDOVER_MAGIC;
+	header.version = HANDOVER_VERSION;
+	header.secret_cap = secret_cap;
+	header.lane_depth = lanes->depth;
+	header.version_base = database->version_base;
+	header.entries = database->length;
+	header.sessions = list_size(clients);
+	token_export(header.token_key);
+
+	int fds[HANDOVER_FDS];
+	size_t count = 0;
+
+	FILE *db = NULL;
+	FILE *meta = NULL;
+	int dbfd = memfd_create("authme-database", MFD_CLOEXEC);
+	int metafd = memfd_create("authme-sessions", MFD_CLOEXEC);
+
+	if (dbfd != -1)
+		db = fdopen(dbfd, "w");
+	if (metafd != -1)
+		meta = fdopen(metafd, "w");
+
+	bool success = db != NULL && meta != NULL &&
+		dump_database(db, database) == 0 && fflush(db) == 0 &&
+		handover_dump(meta);
+
+	fds[count++] = dbfd;
+	fds[count++] = metafd;
+
+	if (sockets && fdsock >= 0) {
+		header.flags |= HANDOVER_FDSOCK;
+		fds[count++] = fdsock;
+	}
+
+	if (sockets && transport != NULL) {
+		header.flags |= HANDOVER_TRANSPORT;
+		header.connections = transport->connection_count;
+		fds[count++] = transport->listen_fd;
+	}
+
+	if (sockets && journal != NULL && journal->listen_fd >= 0) {
+		header.flags |= HANDOVER_JOURNAL;
+		fds[count++] = journal->listen_fd;
+	}
+
+	if (success)
+		success = send_fds(sock, &header, sizeof(header), fds, count) == 0;
+
+	if (db != NULL)
+		fclose(db);
+	else if (dbfd != -1)
+		close(dbfd);
+
+	if (meta != NULL)
+		fclose(meta);
+	else if (metafd != -1)
+		close(metafd);
+
+	if (success && sockets && transport != NULL)
+		success = handover_send_connections(sock);
+
+	return success;
+}
+
+int handover_listen(void)
+{
+	handover_fd = unix_listen(shard_name(HANDOVER_SOCKET_NAME), SOCK_STREAM);
+
+	return handover_fd == -1 ? -1 : 0;
+}
+
+void handover_close(void)
+{
+	if (handover_fd != -1)
+		close(handover_fd);
+
+	handover_fd = -1;
+}
+
+bool handover_serve(size_t secret_cap)
+{
+	if (handover_fd == -1)
+		return false;
+
+	int sock = accept4(handover_fd, NULL, NULL, SOCK_CLOEXEC);
+	if (sock == -1)
+		return false;
+
+	if (!handover_peer(sock, NULL) || transport_pause(transport) != 0) {
+		close(sock);
+		return false;
+	}
+
+	uint32_t ack = 0;
+	bool success = handover_send(sock, secret_cap, true) &&
+		recv(sock, &ack, sizeof(ack), MSG_WAITALL) == sizeof(ack) &&
+		ack == HANDOVER_MAGIC;
+
+	// the new server binds the name once the confirmation arrives
+	if (success) {
+		handover_close();
+		success = send(sock, &ack, sizeof(ack), MSG_NOSIGNAL) == sizeof(ack);
+	}
+
+	close(sock);
+
+	if (success)
+		return true;
+
+	if (transport != NULL && transport_resume(transport) != 0)
+		print_error_exit("failed resuming socket transport");
+
+	// keep accepting new servers if the confirmation was lost
+	if (handover_fd == -1 && handover_listen() != 0)
+		print_error("failed opening handover socket");
+
+	return false;
+}
+
+int handover_request(void)
+{
+	int sock = unix_connect(shard_name(HANDOVER_SOCKET_NAME), SOCK_STREAM);
+	if (sock == -1)
+		return -1;
+
+	pid_t pid;
+	if (!handover_peer(sock, &pid) || kill(pid, SIGUSR2) == -1) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+bool handover_receive(int sock, size_t *secret_cap, unsigned *lane_depth, int *fdsock, int *listen_fd, int *journal_fd, size_t *connections)
+{
+	handover_header_t header;
+	int fds[HANDOVER_FDS];
+	size_t count = HANDOVER_FDS;
+
+	if (recv_fds(sock, &header, sizeof(header), fds, &count) != 0)
+		return false;
+
+	size_t expected = 2;
+	if (header.flags & HANDOVER_FDSOCK)
+		expected += 1;
+	if (header.flags & HANDOVER_TRANSPORT)
+		expected += 1;
+	if (header.flags & HANDOVER_JOURNAL)
+		expected += 1;
+
+	if (header.magic != HANDOVER_MAGIC || header.version != HANDOVER_VERSION || count != expected) {
+		for (size_t i = 0; i < count; i++)
+			close(fds[i]);
+		return false;
+	}
+
+	size_t next = 2;
+	*fdsock = header.flags & HANDOVER_FDSOCK ? fds[next++] : -1;
+	*listen_fd = header.flags & HANDOVER_TRANSPORT ? fds[next++] : -1;
+	*journal_fd = header.flags & HANDOVER_JOURNAL ? fds[next++] : -1;
+	*secret_cap = header.secret_cap;
+	*lane_depth = header.lane_depth;
+	*connections = header.connections;
+
+	FILE *db = fdopen(fds[0], "r");
+	FILE *meta = fdopen(fds[1], "r");
+
+	// the file offsets are shared with the running server
+	bool success = db != NULL && meta != NULL;
+	if (success) {
+		rewind(db);
+		rewind(meta);
+
+		success = parse_database(db, database) == 0 && handover_restore(meta, &header);
+	}
+
+	if (db != NULL)
+		fclose(db);
+	else
+		close(fds[0]);
+
+	if (meta != NULL)
+		fclose(meta);
+	else
+		close(fds[1]);
+
+	if (success)
+		token_import(header.token_key);
+
+	return success;
+}
+
+bool handover_adopt(int sock, transport_t *transport, size_t connections)
+{
+	handover_connection_t batch[FDPASS_MAX];
+	int fds[FDPASS_MAX];
+
+	while (connections > 0) {
+		size_t count = connections < FDPASS_MAX ? connections : FDPASS_MAX;
+		size_t received = count;
+
+		if (transport == NULL || recv_fds(sock, batch, count * sizeof(handover_connection_t), fds, &received) != 0)
+			return false;
+
+		bool success = received == count;
+
+		for (size_t i = 0; i < received; i++) {
+			connection_t peer;
+			memset(&peer, 0, sizeof(peer));
+			peer.pid = batch[i].pid;
+			peer.uid = batch[i].uid;
+			peer.gid = batch[i].gid;
+			memcpy(peer.session_id, batch[i].session_id, SESSION_ID_SIZE);
+			memcpy(peer.username, batch[i].username, MAX_USERNAME_LEN);
+
+			// losing a connection would leave its session behind
+			if (!success || !transport_adopt(transport, fds[i], &peer)) {
+				close(fds[i]);
+				success = false;
+			}
+		}
+
+		if (!success)
+			return false;
+
+		connections -= count;
+	}
+
+	return true;
+}
+
+bool handover_complete(int sock)
+{
+	uint32_t ack = HANDOVER_MAGIC;
+	uint32_t confirm = 0;
+
+	bool success = send(sock, &ack, sizeof(ack), MSG_NOSIGNAL) == sizeof(ack) &&
+		recv(sock, &confirm, sizeof(confirm), MSG_WAITALL) == sizeof(confirm) &&
+		confirm == HANDOVER_MAGIC;
+
+	close(sock);
+
+	return success;
+}
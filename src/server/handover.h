@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for handing over the server to a new process.
+ * @details A running server listens on `HANDOVER_SOCKET_NAME`. A new server connects, wakes the running one, and receives the database, the sessions, the token key and all sockets the running server serves. A standby server receives the same state without the sockets. The shared memory, the semaphores and the watch table are opened by name and stay in place, so clients keep their sessions and only notice a short pause.
+ */
+
+#ifndef __HANDOVER_H__
+#define __HANDOVER_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <sys/types.h>
+
+#include "transport.h"
+
+/**
+ * @brief The name of the socket the running server listens on for a new server.
+ */
+#define HANDOVER_SOCKET_NAME "authme_handover"
+
+/**
+ * @brief Time in milliseconds a server waits for the other one during the handover.
+ */
+#define HANDOVER_TIMEOUT 5000
+
+/**
+ * @brief Check that the peer of the socket `sock` runs as the same user, and limit the time spent waiting for it.
+ * @param sock The connected socket.
+ * @param pid Set to the process id of the peer, may be `NULL`.
+ * @return `true` if the peer is trusted, `false` otherwise.
+ */
+bool handover_peer(int sock, pid_t *pid);
+
+/**
+ * @brief Send the state of the server.
+ * @details If `sockets` is `false`, only the database, the sessions and the token key are sent, which is how a standby server is synchronized. This function makes use of the global variables `database`, `clients`, `fdsock`, `transport`, `journal` and `lanes`.
+ * @param sock The connected socket.
+ * @param secret_cap The maximum length of a secret.
+ * @param sockets Whether to send the sockets the server serves as well.
+ * @return `true` on success, `false` otherwise.
+ */
+bool handover_send(int sock, size_t secret_cap, bool sockets);
+
+/**
+ * @brief Start listening for a new server.
+ * @return `0` on success, `-1` on failure.
+ */
+int handover_listen(void);
+
+/**
+ * @brief Stop listening for a new server.
+ */
+void handover_close(void);
+
+/**
+ * @brief Hand the server over to the new server that connected.
+ * @details The socket transport is paused while the state is sent, and resumed if the new server does not take over. This function makes use of the global variables `database`, `clients`, `fdsock`, `transport` and `journal`.
+ * @param secret_cap The maximum length of a secret.
+ * @return `true` if the new server took over, `false` otherwise.
+ */
+bool handover_serve(size_t secret_cap);
+
+/**
+ * @brief Connect to the running server and ask it to hand over.
+ * @details The running server is woken with `SIGUSR2`. Only servers of the same user are considered.
+ * @return The connected socket, or `-1` on failure.
+ */
+int handover_request(void);
+
+/**
+ * @brief Receive the state of the running server.
+ * @details The database, the sessions and the token key are restored. This function makes use of the global variables `database` and `clients`.
+ * @param sock The socket returned by `handover_request()`.
+ * @param secret_cap Set to the maximum length of a secret of the running server.
+ * @param lane_depth Set to the number of clients admitted to every lane of the running server.
+ * @param fdsock Set to the descriptor passing socket, `-1` if there is none.
+ * @param listen_fd Set to the listening socket of the transport, `-1` if there is none.
+ * @param journal_fd Set to the listening socket of the journal, `-1` if there is none.
+ * @param connections Set to the number of connections that follow.
+ * @return `true` on success, `false` otherwise.
+ */
+bool handover_receive(int sock, size_t *secret_cap, unsigned *lane_depth, int *fdsock, int *listen_fd, int *journal_fd, size_t *connections);
+
+/**
+ * @brief Receive the connections of the running server.
+ * @param sock The socket returned by `handover_request()`.
+ * @param transport The transport to add the connections to, which must not be running.
+ * @param connections The number of connections, as returned by `handover_receive()`.
+ * @return `true` on success, `false` otherwise.
+ */
+bool handover_adopt(int sock, transport_t *transport, size_t connections);
+
+/**
+ * @brief Tell the running server that the state was taken over, and wait for it to let go.
+ * @details Once the function succeeded, the running server does not serve anymore, and `HANDOVER_SOCKET_NAME` is free. The socket is closed in any case.
+ * @param sock The socket returned by `handover_request()`.
+ * @return `true` on success, `false` if the running server kept serving.
+ */
+bool handover_complete(int sock);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for keyed hashing.
+ * @details SipHash-2-4 is used both as message authentication code and as hash function for in-memory indices.
+ */
+
+#include <stdio.h>
+
+#include "hash.h"
+
+/**
+ * @brief Rotate the 64-bit value `x` left by `b` bits.
+ */
+#define ROTL(x, b) (uint64_t) (((x) << (b)) | ((x) >> (64 - (b))))
+
+/**
+ * @brief Perform one SipHash round on the state `v0` to `v3`.
+ */
+#define SIPROUND \
+	do { \
+		v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+		v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+		v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+		v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+	} while (0)
+
+/**
+ * @brief Read a little-endian 64-bit value.
+ * @param p The bytes to read from.
+ * @return The value read.
+ */
+static uint64_t read_le64(const uint8_t *p)
+{
+	uint64_t v = 0;
+
+	for (int i = 7; i >= 0; i--)
+		v = (v << 8) | p[i];
+
+	return v;
+}
+
+uint64_t siphash(const uint8_t key[HASH_KEY_SIZE], const void *data, size_t len)
+{
+	const uint8_t *in = data;
+	uint64_t k0 = read_le64(key);
+	uint64_t k1 = read_le64(key + 8);
+	uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+	uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+	uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+	uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+	uint64_t m;
+
+	const uint8_t *end = in + len - (len % 8);
+	for (; in != end; in += 8) {
+		m = read_le64(in);
+		v3 ^= m;
+		SIPROUND;
+		SIPROUND;
+		v0 ^= m;
+	}
+
+	m = ((uint64_t) len) << 56;
+	for (int i = (len & 7) - 1; i >= 0; i--)
+		m |= ((uint64_t) in[i]) << (8 * i);
+
+	v3 ^= m;
+	SIPROUND;
+	SIPROUND;
+	v0 ^= m;
+
+	v2 ^= 0xff;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+int hash_key_generate(uint8_t key[HASH_KEY_SIZE])
+{
+	FILE *fp = fopen("/dev/urandom", "r");
+	if (fp == NULL)
+		return -1;
+
+	size_t n = fread(key, 1, HASH_KEY_SIZE, fp);
+	fclose(fp);
+
+	if (n != HASH_KEY_SIZE)
+		return -1;
+
+	return 0;
+}
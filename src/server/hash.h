@@ -0,0 +1,37 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for keyed hashing.
+ * @details SipHash-2-4 is used both as message authentication code and as hash function for in-memory indices.
+ */
+
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The size of a hash key in bytes.
+ */
+#define HASH_KEY_SIZE 16
+
+/**
+ * @brief Compute the SipHash-2-4 value of `data`.
+ * @param key The secret key to hash with.
+ * @param data The data to hash.
+ * @param len The length of `data` in bytes.
+ * @return The 64-bit hash value.
+ */
+uint64_t siphash(const uint8_t key[HASH_KEY_SIZE], const void *data, size_t len);
+
+/**
+ * @brief Fill `key` with random bytes.
+ * @details The bytes are read from `/dev/urandom`.
+ * @param key The key to fill.
+ * @return `0` on success, `-1` on failure.
+ */
+int hash_key_generate(uint8_t key[HASH_KEY_SIZE]);
+
+#endif
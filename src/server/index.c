@@ -0,0 +1,244 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function definitions for the username index.
+ * @details Groups of control bytes are compared with SSE2 or AVX2 where available, and byte by byte otherwise.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "index.h"
+#include "placement.h"
+
+/**
+ * @brief Find the slots of a group whose control byte equals `value`.
+ * @param ctrl The first control byte of the group.
+ * @param value The control byte to look for.
+ * @return A bit mask with bit `i` set if slot `i` of the group matches.
+ */
+static uint32_t group_match(const uint8_t *ctrl, uint8_t value)
+{
+#if defined(__AVX2__)
+	__m256i group = _mm256_loadu_si256((const __m256i *) ctrl);
+	__m256i match = _mm256_cmpeq_epi8(group, _mm256_set1_epi8((char) value));
+	return (uint32_t) _mm256_movemask_epi8(match);
+#elif defined(__SSE2__)
+	__m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+	__m128i match = _mm_cmpeq_epi8(group, _mm_set1_epi8((char) value));
+	return (uint32_t) _mm_movemask_epi8(match);
+#else
+	uint32_t mask = 0;
+
+	for (int i = 0; i < INDEX_GROUP_SIZE; i++) {
+		if (ctrl[i] == value)
+			mask |= (uint32_t) 1 << i;
+	}
+
+	return mask;
+#endif
+}
+
+/**
+ * @brief Find the empty slots of a group.
+ * @param ctrl The first control byte of the group.
+ * @return A bit mask with bit `i` set if slot `i` of the group is empty.
+ */
+static uint32_t group_empty(const uint8_t *ctrl)
+{
+	return group_match(ctrl, INDEX_EMPTY);
+}
+
+/**
+ * @brief Find the position of the lowest bit set.
+ * @param mask The mask to consider, which must not be zero.
+ * @return The position of the lowest bit set.
+ */
+static int lowest_bit(uint32_t mask)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(mask);
+#else
+	int i = 0;
+
+	while ((mask & 1) == 0) {
+		mask >>= 1;
+		i++;
+	}
+
+	return i;
+#endif
+}
+
+/**
+ * @brief Allocate the arrays of an index.
+ * @param index The index to allocate the arrays for.
+ * @param capacity The number of slots.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool index_allocate(index_t *index, size_t capacity)
+{
+	uint8_t *ctrl = placement_alloc(capacity);
+	uint32_t *slots = placement_alloc(capacity * sizeof(uint32_t));
+
+	if (ctrl == NULL || slots == NULL) {
+		placement_free(ctrl, capacity);
+		placement_free(slots, capacity * sizeof(uint32_t));
+		return false;
+	}
+
+	memset(ctrl, INDEX_EMPTY, capacity);
+
+	index->ctrl = ctrl;
+	index->slots = slots;
+	index->capacity = capacity;
+	index->count = 0;
+
+	return true;
+}
+
+/**
+ * @brief Place the entry at position `pos` in the first empty slot of its probe sequence.
+ * @details The index must have an empty slot.
+ * @param index The index to place the entry in.
+ * @param database The database the entry belongs to.
+ * @param pos The position of the entry in the database.
+ */
+static void index_place(index_t *index, database_t *database, uint32_t pos)
+{
+	char *username = database->entries[pos].username;
+	uint64_t h = siphash(index->key, username, arena_strlen(username));
+	size_t mask = index->capacity / INDEX_GROUP_SIZE - 1;
+	size_t group = (h >> 7) & mask;
+
+	for (size_t step = 1;; step++) {
+		uint8_t *ctrl = &index->ctrl[group * INDEX_GROUP_SIZE];
+		uint32_t empty = group_empty(ctrl);
+
+		if (empty != 0) {
+			size_t slot = group * INDEX_GROUP_SIZE + lowest_bit(empty);
+			index->ctrl[slot] = h & 0x7f;
+			index->slots[slot] = pos;
+			index->count += 1;
+			return;
+		}
+
+		group = (group + step) & mask;
+	}
+}
+
+/**
+ * @brief Rebuild the index with `capacity` slots.
+ * @param index The index to rebuild.
+ * @param database The database the index belongs to.
+ * @param capacity The new number of slots.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool index_rebuild(index_t *index, database_t *database, size_t capacity)
+{
+	uint8_t *ctrl = index->ctrl;
+	uint32_t *slots = index->slots;
+	size_t previous = index->capacity;
+
+	if (!index_allocate(index, capacity)) {
+		index->ctrl = ctrl;
+		index->slots = slots;
+		return false;
+	}
+
+	placement_free(ctrl, previous);
+	placement_free(slots, previous * sizeof(uint32_t));
+
+	for (size_t i = 0; i < database->length; i++)
+		index_place(index, database, i);
+
+	return true;
+}
+
+index_t *index_initialize(database_t *database)
+{
+	index_t *index = malloc(sizeof(index_t));
+	if (index == NULL)
+		return NULL;
+
+	memset(index, 0, sizeof(index_t));
+
+	if (hash_key_generate(index->key) != 0) {
+		free(index);
+		return NULL;
+	}
+
+	size_t capacity = INDEX_MIN_CAPACITY;
+	while (capacity / 8 * 7 < database->length)
+		capacity *= 2;
+
+	if (!index_rebuild(index, database, capacity)) {
+		free(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+void index_destroy(index_t *index)
+{
+	if (index == NULL)
+		return;
+
+	placement_free(index->ctrl, index->capacity);
+	placement_free(index->slots, index->capacity * sizeof(uint32_t));
+	free(index);
+}
+
+bool index_insert(index_t *index, database_t *database, uint32_t pos)
+{
+	if (index->count + 1 > index->capacity / 8 * 7)
+		return index_rebuild(index, database, 2 * index->capacity);
+
+	index_place(index, database, pos);
+	return true;
+}
+
+entry_t *index_find(index_t *index, database_t *database, const char *username, size_t len)
+{
+	uint64_t h = siphash(index->key, username, len);
+	uint8_t fingerprint = h & 0x7f;
+	size_t mask = index->capacity / INDEX_GROUP_SIZE - 1;
+	size_t group = (h >> 7) & mask;
+
+	index->lookups += 1;
+
+	for (size_t step = 1; step <= mask + 1; step++) {
+		uint8_t *ctrl = &index->ctrl[group * INDEX_GROUP_SIZE];
+		uint32_t match = group_match(ctrl, fingerprint);
+
+		index->groups_probed += 1;
+
+		while (match != 0) {
+			int i = lowest_bit(match);
+			entry_t *e = &database->entries[index->slots[group * INDEX_GROUP_SIZE + i]];
+
+			if (arena_strlen(e->username) == len &&
+				memcmp(e->username, username, len) == 0)
+				return e;
+
+			index->false_matches += 1;
+			match &= match - 1;
+		}
+
+		// an empty slot ends the probe sequence
+		if (group_empty(ctrl) != 0)
+			return NULL;
+
+		group = (group + step) & mask;
+	}
+
+	return NULL;
+}
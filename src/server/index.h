@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function declarations for the username index.
+ * @details The index is an open-addressing hash table in struct-of-arrays layout. A control array keeps a 7-bit fingerprint per slot, which is probed a whole group at a time, and the entries are only touched on a fingerprint match.
+ */
+
+#ifndef __INDEX_H__
+#define __INDEX_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+#include "database.h"
+
+/**
+ * @brief The number of control bytes probed at once.
+ */
+#ifdef __AVX2__
+#define INDEX_GROUP_SIZE 32
+#else
+#define INDEX_GROUP_SIZE 16
+#endif
+
+/**
+ * @brief Control byte of an empty slot.
+ * @details Fingerprints never have the high bit set.
+ */
+#define INDEX_EMPTY 0x80
+
+/**
+ * @brief The minimum number of slots of an index.
+ */
+#define INDEX_MIN_CAPACITY 64
+
+/**
+ * @brief Representation of the username index.
+ */
+typedef struct {
+	uint8_t *ctrl; ///< Fingerprint or `INDEX_EMPTY` for every slot.
+	uint32_t *slots; ///< Position of the entry in the database for every slot.
+	size_t capacity; ///< Number of slots, a power of two and a multiple of `INDEX_GROUP_SIZE`.
+	size_t count; ///< Number of occupied slots.
+	uint8_t key[HASH_KEY_SIZE]; ///< Key used to hash usernames.
+	unsigned long lookups; ///< Number of lookups performed.
+	unsigned long groups_probed; ///< Number of groups probed by lookups.
+	unsigned long false_matches; ///< Number of fingerprint matches with a different username.
+} index_t;
+
+/**
+ * @brief Create a new index over all entries of the database `database`.
+ * @param database The database to index.
+ * @return The memory address of the index, or `NULL` on failure.
+ */
+index_t *index_initialize(database_t *database);
+
+/**
+ * @brief Destroy the index `index` created previously.
+ * @param index The index to destroy.
+ */
+void index_destroy(index_t *index);
+
+/**
+ * @brief Add the entry at position `pos` of the database to the index.
+ * @details The entry must already be part of the database. The index grows when it becomes more than seven eighths full.
+ * @param index The index to add the entry to.
+ * @param database The database the entry belongs to.
+ * @param pos The position of the entry in the database.
+ * @return `true` on success, `false` otherwise.
+ */
+bool index_insert(index_t *index, database_t *database, uint32_t pos);
+
+/**
+ * @brief Look up the entry of user `username`.
+ * @param index The index to search.
+ * @param database The database the index belongs to.
+ * @param username The username to look for.
+ * @param len The length of `username`.
+ * @return The entry of the user, or `NULL` if the user was not found.
+ */
+entry_t *index_find(index_t *index, database_t *database, const char *username, size_t len);
+
+#endif
@@ -6,19 +6,36 @@
  * @details The functions include the ability to handle packets from clients.
  */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
-#include <assert.h>
+#include <signal.h>
 #include <semaphore.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "ipc.h"
 #include "user.h"
 #include "list.h"
+#include "database.h"
+#include "ratelimit.h"
 
 #include "../share/protocol.h"
 #include "../share/utils.h"
+#include "../share/fdpass.h"
+
+/**
+ * @brief Time in milliseconds to wait for a client to connect for descriptor passing.
+ */
+#define FD_ACCEPT_TIMEOUT 1000
+
+/**
+ * @brief Indicator for the program to shut down.
+ * @details This variable is required for the use of this module.
+ */
+extern volatile sig_atomic_t running;
 
 /**
  * @brief The memory shared between the server and the clients.
@@ -26,6 +43,18 @@
  */
 extern void *shmem;
 
+/**
+ * @brief The size of the shared memory.
+ * @details This variable is required for the use of this module.
+ */
+extern size_t shmlen;
+
+/**
+ * @brief The socket used to pass secrets as file descriptors.
+ * @details This variable is required for the use of this module. It is negative if descriptor passing is disabled.
+ */
+extern int fdsock;
+
 /**
  * @brief The first server semaphore.
  * @details This variable is required for the use of this module.
@@ -45,10 +74,157 @@ extern sem_t *sem2;
 extern list_t *clients;
 
 /**
- * @brief The database list.
+ * @brief The database.
  * @details This variable is required for the use of this module.
  */
-extern list_t *database;
+extern database_t *database;
+
+/**
+ * @brief The watch table.
+ * @details This variable is required for the use of this module.
+ */
+extern uint32_t *watch_table;
+
+/**
+ * @brief The rate limiter of logins per username.
+ * @details This variable is required for the use of this module, and `NULL` if logins per username are not limited.
+ */
+extern ratelimit_t *user_limits;
+
+/**
+ * @brief The rate limiter of logins per client.
+ * @details This variable is required for the use of this module, and `NULL` if logins per client are not limited.
+ */
+extern ratelimit_t *client_limits;
+
+/**
+ * @brief The rate limiter of logins over the shared memory as a whole.
+ * @details This variable is required for the use of this module, and `NULL` if logins per client are not limited.
+ */
+extern ratelimit_t *shared_limits;
+
+/**
+ * @brief Lock serializing the handling of packets of all transports.
+ */
+static pthread_mutex_t ipc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The message of the current request, which starts with the packet and is followed by the data arena.
+ */
+static char *arena = NULL;
+
+/**
+ * @brief The number of bytes of the current message received from the client.
+ */
+static size_t arena_received = 0;
+
+/**
+ * @brief The number of bytes the current message has room for.
+ */
+static size_t arena_size = 0;
+
+/**
+ * @brief End of the data arena range touched by the current request.
+ * @details For the shared memory, the range is cleared before the next client is served.
+ */
+static size_t arena_end = SHM_ARENA_OFFSET;
+
+/**
+ * @brief End of the data arena range holding the response, `0` if the response fits the packet.
+ */
+static size_t reply_end = 0;
+
+/**
+ * @brief Whether secrets can be passed as file descriptors for the current request.
+ */
+static bool fd_passing = false;
+
+/**
+ * @brief File descriptor to pass to the current client once it received the response.
+ */
+static int pending_fd = -1;
+
+/**
+ * @brief Process id of the client to pass `pending_fd` to.
+ */
+static pid_t pending_pid;
+
+/**
+ * @brief Counters of the requests whose deadline passed.
+ */
+static ipc_stats_t stats;
+
+/**
+ * @brief Receive a secret passed as file descriptor by the client `pid`.
+ * @param pid The process id of the client.
+ * @param len The announced length of the secret.
+ * @return A sealed memory file descriptor of size `len`, or `-1` on failure.
+ */
+static int receive_secret_fd(pid_t pid, size_t len)
+{
+	if (!fd_passing || len >= shmlen - SHM_ARENA_OFFSET)
+		return -1;
+
+	int conn = unix_accept_pid(fdsock, pid, FD_ACCEPT_TIMEOUT);
+	if (conn == -1)
+		return -1;
+
+	int fd = recv_fd(conn);
+	close(conn);
+
+	if (fd != -1 && !memfd_is_sealed(fd, len)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * @brief Locate a secret written to the data arena by a client.
+ * @details The secret is null-terminated in place.
+ * @param offset The offset of the secret in the message.
+ * @param len The length of the secret.
+ * @return The secret, or `NULL` if it does not lie within the arena.
+ */
+static char *arena_locate(uint32_t offset, uint32_t len)
+{
+	if (offset < SHM_ARENA_OFFSET || offset >= arena_received || len >= arena_received - offset)
+		return NULL;
+
+	char *secret = arena + offset;
+	secret[len] = '\0';
+
+	if (offset + len + 1 > arena_end)
+		arena_end = offset + len + 1;
+
+	return secret;
+}
+
+/**
+ * @brief Store a secret for the client.
+ * @details Secrets that do not fit inline are copied to the start of the data arena.
+ * @param data The secret to store.
+ * @param len The length of the secret.
+ * @param buffer The inline buffer of the packet, holding `MAX_SECRET_LEN + 1` bytes.
+ * @param offset The offset field of the packet, set if the secret is copied to the arena.
+ * @return `true` on success, `false` if the secret does not fit the arena.
+ */
+static bool arena_store(char *data, size_t len, char *buffer, uint32_t *offset)
+{
+	if (len <= MAX_SECRET_LEN) {
+		memcpy(buffer, data, len);
+	} else if (len < arena_size - SHM_ARENA_OFFSET) {
+		memcpy(arena + SHM_ARENA_OFFSET, data, len);
+		*offset = SHM_ARENA_OFFSET;
+		arena_end = SHM_ARENA_OFFSET + len + 1;
+		reply_end = arena_end;
+	} else {
+		return false;
+	}
+
+	return true;
+}
 
 /**
  * @brief Generate a random session id.
@@ -104,9 +280,58 @@ static void process_registration(void *packet)
 		p->rstatus = ERROR;
 }
 
+/**
+ * @brief Determine the owner of a session started by the current request.
+ * @details A session started over the socket transport ends with its connection, so only the clients of the shared memory own their sessions.
+ * @param pid The process id sent by the client.
+ * @return The owner of the session, or `0` if it has none.
+ */
+static pid_t session_owner(pid_t pid)
+{
+	return arena == (char *) shmem ? pid : 0;
+}
+
+/**
+ * @brief Take a login of a client of the shared memory from the limit all of them share.
+ * @details Nothing but the client vouches for the process id it sends, so it must at least name a live process, and all such logins draw from one bucket. This function makes use of the global variable `shared_limits`.
+ * @param pid The process id sent by the client.
+ * @param now The current time, as returned by `clock_ms()`.
+ * @return `true` if the login may proceed, `false` otherwise.
+ */
+static bool shared_login_allowed(pid_t pid, uint64_t now)
+{
+	if (!ratelimit_take(shared_limits, "", 0, now))
+		return false;
+
+	// EPERM still means the process exists, it merely belongs to someone else
+	return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+/**
+ * @brief Take a login from the rate limits of the client and the user of a login packet.
+ * @details The limit of the user is not drawn from if the client exceeded its own, so that a single client cannot lock out a user as quickly. This function makes use of the global variables `user_limits`, `client_limits` and `shared_limits`.
+ * @param p The login packet.
+ * @return `true` if the login may proceed, `false` otherwise.
+ */
+static bool login_allowed(struct packet_login *p)
+{
+	uint64_t now = clock_ms();
+
+	if (client_limits != NULL && arena == (char *) shmem && !shared_login_allowed(p->pid, now))
+		return false;
+
+	if (client_limits != NULL && !ratelimit_take(client_limits, &p->pid, sizeof(p->pid), now))
+		return false;
+
+	if (user_limits != NULL && !ratelimit_take(user_limits, p->username, strlen(p->username), now))
+		return false;
+
+	return true;
+}
+
 /**
  * @brief Process a login packet.
- * @details This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @details Logins exceeding the rate limits are rejected before the credentials are checked. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
  * @param packet The packet to handle.
  */
 static void process_login(void *packet)
@@ -115,11 +340,38 @@ static void process_login(void *packet)
 	p->username[MAX_USERNAME_LEN] = '\0';
 	p->password[MAX_PASSWORD_LEN] = '\0';
 
-	if (user_verify_credentials(database, p->username, p->password)) {
+	bool allowed = login_allowed(p);
+	if (!allowed)
+		p->rstatus = LIMITED;
+
+	if (allowed && user_verify_credentials(database, p->username, p->password)) {
 		generate_session_id(p->session_id);
 		p->session_id[SESSION_ID_SIZE] = '\0';
 
-		user_login(clients, p->username, p->session_id);
+		user_login(clients, p->username, p->session_id, session_owner(p->pid));
+		user_issue_token(database, p->username, p->token);
+	} else {
+		memset(p->session_id, '\0', SESSION_ID_SIZE + 1);
+		memset(p->token, '\0', TOKEN_SIZE + 1);
+	}
+}
+
+/**
+ * @brief Process a resume packet.
+ * @details The session is established from the resumption token alone, the password is not checked. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @param packet The packet to handle.
+ */
+static void process_resume(void *packet)
+{
+	struct packet_resume *p = (struct packet_resume *) packet;
+	p->username[MAX_USERNAME_LEN] = '\0';
+	p->token[TOKEN_SIZE] = '\0';
+
+	if (user_verify_token(database, p->username, p->token)) {
+		generate_session_id(p->session_id);
+		p->session_id[SESSION_ID_SIZE] = '\0';
+
+		user_login(clients, p->username, p->session_id, session_owner(p->pid));
 	} else {
 		memset(p->session_id, '\0', SESSION_ID_SIZE + 1);
 	}
@@ -139,18 +391,42 @@ static void process_logout(void *packet)
 	if (is_valid_session(p->session_id, p->username)) {
 		bool success = user_logout(clients, p->username, p->session_id);
 
-		if (success)
+		if (success) {
+			user_revoke_tokens(database, p->username);
 			p->rstatus = SUCCESS;
-		else
+		} else {
 			p->rstatus = ERROR;
+		}
 	} else {
 		p->rstatus = ERROR;
 	}
 }
 
+/**
+ * @brief Check the version of the secret for a conditional write.
+ * @details On a conflict, the request status is set and the packet carries the current version.
+ * @param p The packet to check.
+ * @param e The entry of the user.
+ * @return `true` if the write may proceed, `false` otherwise.
+ */
+static bool check_version(struct packet_secret_write *p, entry_t *e)
+{
+	if (p->type != SECRET_WRITE_IF)
+		return true;
+
+	uint64_t version = user_secret_version(e);
+	if (version != p->version) {
+		p->version = version;
+		p->rstatus = CONFLICT;
+		return false;
+	}
+
+	return true;
+}
+
 /**
  * @brief Process a secret_write packet.
- * @details This packet is sent if the user wishes to change their secret. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @details This packet is sent if the user wishes to change their secret. A `SECRET_WRITE_IF` packet only succeeds if the secret still has the version given by the client. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
  * @param packet The packet to handle.
  */
 static void process_secret_write(void *packet)
@@ -160,21 +436,52 @@ static void process_secret_write(void *packet)
 	p->username[MAX_USERNAME_LEN] = '\0';
 	p->secret[MAX_SECRET_LEN] = '\0';
 
-	if (is_valid_session(p->session_id, p->username)) {
-		bool success = user_secret_write(database, p->username, p->secret);
+	bool success = false;
+	p->rstatus = ERROR;
+
+	if (p->transfer == TRANSFER_MEMFD) {
+		int fd = receive_secret_fd(p->pid, p->secret_len);
+		if (fd == -1)
+			return;
+
+		entry_t *e = NULL;
+		if (is_valid_session(p->session_id, p->username))
+			e = user_find(database, p->username);
 
+		if (e == NULL || !check_version(p, e)) {
+			close(fd);
+			return;
+		}
+
+		// the database takes ownership of the descriptor
+		success = user_secret_write_memfd(database, e, fd, p->secret_len, p->ttl);
 		if (success)
-			p->rstatus = SUCCESS;
-		else
-			p->rstatus = ERROR;
+			p->version = user_secret_version(e);
 	} else {
-		p->rstatus = ERROR;
+		// long secrets are passed through the data arena
+		char *secret = p->secret;
+		if (p->secret_len > MAX_SECRET_LEN)
+			secret = arena_locate(p->secret_offset, p->secret_len);
+
+		if (secret == NULL || !is_valid_session(p->session_id, p->username))
+			return;
+
+		entry_t *e = user_find(database, p->username);
+		if (e == NULL || !check_version(p, e))
+			return;
+
+		success = user_secret_write(database, e, secret, p->ttl);
+		if (success)
+			p->version = user_secret_version(e);
 	}
+
+	if (success)
+		p->rstatus = SUCCESS;
 }
 
 /**
  * @brief Process a secret_read packet.
- * @details This packet is sent if the user wishes to read their secret. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @details This packet is sent if the user wishes to read their secret. Secrets that do not fit inline are copied to the start of the data arena. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
  * @param packet The packet to handle.
  */
 static void process_secret_read(void *packet)
@@ -183,49 +490,374 @@ static void process_secret_read(void *packet)
 	p->session_id[SESSION_ID_SIZE] = '\0';
 	p->username[MAX_USERNAME_LEN] = '\0';
 
-	if (is_valid_session(p->session_id, p->username)) {
-		char *secret = user_secret_read(database, p->username);
+	memset(p->secret, '\0', MAX_SECRET_LEN + 1);
+	p->secret_len = 0;
+	p->secret_offset = 0;
+	p->rstatus = ERROR;
+
+	if (!is_valid_session(p->session_id, p->username))
+		return;
+
+	entry_t *e = user_find(database, p->username);
+	if (e == NULL)
+		return;
+
+	secret_t *secret = user_secret_read(e);
+	p->version = user_secret_version(e);
+	p->expires = user_secret_expiry(e);
 
-		if (secret != NULL)
-			strncpy(p->secret, secret, MAX_SECRET_LEN);
+	// clients caching the secret check this counter for changes
+	p->bucket = user_watch_bucket(p->username);
+	p->sequence = __atomic_load_n(&watch_table[p->bucket], __ATOMIC_ACQUIRE);
+
+	char *data = secret_data(secret);
+	size_t len = secret->len;
+
+	// hand out the descriptor itself if the client accepts it
+	if (secret->kind == SECRET_MEMFD && p->transfer == TRANSFER_MEMFD && fd_passing) {
+		// the secret may be replaced before the descriptor is sent
+		pending_fd = dup(secret->data.memfd.fd);
+		if (pending_fd == -1)
+			return;
+
+		pending_pid = p->pid;
+		p->secret_len = len;
+		p->rstatus = SUCCESS;
+		return;
+	}
+
+	p->transfer = TRANSFER_SHM;
+
+	if (arena_store(data, len, p->secret, &p->secret_offset)) {
+		p->secret_len = len;
+		p->rstatus = SUCCESS;
+	}
+}
+
+/**
+ * @brief Process a key_write packet.
+ * @details This packet is sent if the user wishes to change one of their named secrets. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @param packet The packet to handle.
+ */
+static void process_key_write(void *packet)
+{
+	struct packet_key_write *p = (struct packet_key_write *) packet;
+	p->session_id[SESSION_ID_SIZE] = '\0';
+	p->username[MAX_USERNAME_LEN] = '\0';
+	p->key[MAX_KEY_LEN] = '\0';
+	p->secret[MAX_SECRET_LEN] = '\0';
+
+	char *secret = p->secret;
+	if (p->secret_len > MAX_SECRET_LEN)
+		secret = arena_locate(p->secret_offset, p->secret_len);
+
+	if (secret != NULL && is_valid_session(p->session_id, p->username)) {
+		bool success = user_key_write(database, p->username, p->key, secret);
+
+		if (success)
+			p->rstatus = SUCCESS;
 		else
-			memset(p->secret, '\0', MAX_SECRET_LEN);
+			p->rstatus = ERROR;
+	} else {
+		p->rstatus = ERROR;
+	}
+}
+
+/**
+ * @brief Process a key_read packet.
+ * @details This packet is sent if the user wishes to read one of their named secrets. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @param packet The packet to handle.
+ */
+static void process_key_read(void *packet)
+{
+	struct packet_key_read *p = (struct packet_key_read *) packet;
+	p->session_id[SESSION_ID_SIZE] = '\0';
+	p->username[MAX_USERNAME_LEN] = '\0';
+	p->key[MAX_KEY_LEN] = '\0';
+
+	memset(p->secret, '\0', MAX_SECRET_LEN + 1);
+	p->secret_len = 0;
+	p->secret_offset = 0;
+	p->rstatus = ERROR;
+
+	if (!is_valid_session(p->session_id, p->username))
+		return;
+
+	secret_t *secret = user_key_read(database, p->username, p->key);
+	if (secret == NULL)
+		return;
+
+	if (arena_store(secret_data(secret), secret->len, p->secret, &p->secret_offset)) {
+		p->secret_len = secret->len;
+		p->rstatus = SUCCESS;
+	}
+}
+
+/**
+ * @brief Process a key_delete packet.
+ * @details This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @param packet The packet to handle.
+ */
+static void process_key_delete(void *packet)
+{
+	struct packet_key_delete *p = (struct packet_key_delete *) packet;
+	p->session_id[SESSION_ID_SIZE] = '\0';
+	p->username[MAX_USERNAME_LEN] = '\0';
+	p->key[MAX_KEY_LEN] = '\0';
+
+	if (is_valid_session(p->session_id, p->username) &&
+		user_key_delete(database, p->username, p->key))
+		p->rstatus = SUCCESS;
+	else
+		p->rstatus = ERROR;
+}
+
+/**
+ * @brief Process a scan packet.
+ * @details This packet is sent if the user wishes to enumerate the usernames or the names of their secrets. At most one page is looked up per packet. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients` and `database`.
+ * @param packet The packet to handle.
+ */
+static void process_scan(void *packet)
+{
+	struct packet_scan *p = (struct packet_scan *) packet;
+	p->session_id[SESSION_ID_SIZE] = '\0';
+	p->username[MAX_USERNAME_LEN] = '\0';
+	p->cursor[MAX_CURSOR_LEN] = '\0';
+
+	memset(p->names, '\0', sizeof(p->names));
+	p->count = 0;
+
+	if (!is_valid_session(p->session_id, p->username) ||
+		(p->target != SCAN_USERS && p->target != SCAN_KEYS)) {
+		p->cursor[0] = '\0';
+		p->rstatus = ERROR;
+		return;
+	}
+
+	if (p->limit < 1 || p->limit > SCAN_PAGE_SIZE)
+		p->limit = SCAN_PAGE_SIZE;
+
+	p->count = user_scan(database, p->username, p->target, p->cursor, p->limit, p->names);
+	p->rstatus = SUCCESS;
+}
+
+/**
+ * @brief Process a watch packet.
+ * @details This packet is sent if the user wishes to wait for their secret to change. The client waits on the watch table itself, so the server is not held. This function makes use of the global variables `shmem`, `sem1`, `sem2`, `clients`, `database` and `watch_table`.
+ * @param packet The packet to handle.
+ */
+static void process_watch(void *packet)
+{
+	struct packet_watch *p = (struct packet_watch *) packet;
+	p->session_id[SESSION_ID_SIZE] = '\0';
+	p->username[MAX_USERNAME_LEN] = '\0';
+	p->rstatus = ERROR;
+
+	if (!is_valid_session(p->session_id, p->username))
+		return;
+
+	entry_t *e = user_find(database, p->username);
+	if (e == NULL)
+		return;
+
+	uint64_t version = user_secret_version(e);
+
+	// the counter is read before any later write can increment it
+	p->bucket = user_watch_bucket(p->username);
+	p->sequence = __atomic_load_n(&watch_table[p->bucket], __ATOMIC_ACQUIRE);
+
+	if (version != p->version) {
+		p->version = version;
+		p->rstatus = CONFLICT;
 	} else {
-		memset(p->secret, '\0', MAX_SECRET_LEN);
+		p->rstatus = SUCCESS;
 	}
 }
 
-void handle_packet(void *packet)
+/**
+ * @brief Delegate a packet to the specific packet handler.
+ * @details The caller has to hold `ipc_mutex` and set up the message of the request.
+ * @param packet The packet to handle.
+ */
+static void dispatch_packet(void *packet)
 {
 	struct packet_generic *pg = packet;
 
 	switch (pg->type) {
 	case REGISTRATION:
-		process_registration(shmem);
+		process_registration(packet);
 		break;
 	case LOGIN:
-		process_login(shmem);
+		process_login(packet);
 		break;
 	case LOGOUT:
-		process_logout(shmem);
+		process_logout(packet);
 		break;
 	case SECRET_WRITE:
-		process_secret_write(shmem);
+	case SECRET_WRITE_IF:
+		process_secret_write(packet);
 		break;
 	case SECRET_READ:
-		process_secret_read(shmem);
+		process_secret_read(packet);
+		break;
+	case RESUME:
+		process_resume(packet);
+		break;
+	case KEY_WRITE:
+		process_key_write(packet);
+		break;
+	case KEY_READ:
+		process_key_read(packet);
+		break;
+	case KEY_DELETE:
+		process_key_delete(packet);
+		break;
+	case SCAN:
+		process_scan(packet);
+		break;
+	case WATCH:
+		process_watch(packet);
 		break;
 	default:
-		assert(false);
+		pg->rstatus = ERROR;
 	}
+}
+
+/**
+ * @brief Determine the lane of a packet type.
+ * @param type The type of the packet.
+ * @return The lane the packet belongs to.
+ */
+static enum lane_e packet_lane(enum packet_e type)
+{
+	switch (type) {
+	case REGISTRATION:
+	case LOGIN:
+	case RESUME:
+	case SCAN:
+		return LANE_BULK;
+	default:
+		return LANE_INTERACTIVE;
+	}
+}
+
+/**
+ * @brief Process a packet, unless its deadline passed.
+ * @details The caller has to hold `ipc_mutex` and set up the message of the request. A client that gave up on the request is not waited for with any database work.
+ * @param packet The packet to process.
+ */
+static void serve_packet(void *packet)
+{
+	struct packet_generic *pg = packet;
+
+	if (pg->deadline != 0 && clock_ms() > pg->deadline) {
+		pg->rstatus = TIMEOUT;
+		__atomic_add_fetch(&stats.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	dispatch_packet(packet);
+
+	if (pg->deadline != 0 && clock_ms() > pg->deadline)
+		__atomic_add_fetch(&stats.late, 1, __ATOMIC_RELAXED);
+}
+
+void ipc_lock(void)
+{
+	pthread_mutex_lock(&ipc_mutex);
+}
+
+void ipc_unlock(void)
+{
+	pthread_mutex_unlock(&ipc_mutex);
+}
+
+void handle_packet(void *packet, enum lane_e lane)
+{
+	struct packet_generic *pg = packet;
+
+	ipc_lock();
+
+	arena = (char *) shmem;
+	arena_received = shmlen;
+	arena_size = shmlen;
+	arena_end = SHM_ARENA_OFFSET;
+	reply_end = 0;
+	fd_passing = fdsock >= 0;
+
+	// a client must not skip the queue of its lane
+	if (packet_lane(pg->type) == lane)
+		serve_packet(packet);
+	else
+		pg->rstatus = ERROR;
+
+	int fd = pending_fd;
+	pid_t pid = pending_pid;
+	size_t end = arena_end;
+	pending_fd = -1;
+
+	ipc_unlock();
 
 	// notify client about data arrival
 	sem_post(sem2);
 
-	// wait for the client to process the data
-	sem_wait_exit(sem1, false);
+	// the client connects for the descriptor after receiving the response
+	if (fd >= 0) {
+		int conn = unix_accept_pid(fdsock, pid, FD_ACCEPT_TIMEOUT);
+
+		if (conn != -1) {
+			send_fd(conn, fd);
+			close(conn);
+		}
+
+		close(fd);
+	}
+
+	// wait for the client to process the data, unless shutting down
+	while (sem_wait_exit(sem1, true) != 0 && running);
 
 	// make sure next client cannot read other secrets
 	memset(shmem, 0, SHM_LEN);
+	memset((char *) shmem + SHM_ARENA_OFFSET, 0, end - SHM_ARENA_OFFSET);
 	pg->status = ONLINE;
 }
+
+size_t handle_message(void *message, size_t len, size_t size)
+{
+	if (len < sizeof(struct packet_generic))
+		return 0;
+
+	// fields the client did not send are empty
+	if (len < SHM_ARENA_OFFSET)
+		memset((char *) message + len, 0, SHM_ARENA_OFFSET - len);
+
+	ipc_lock();
+
+	arena = message;
+	arena_received = len;
+	arena_size = size;
+	arena_end = SHM_ARENA_OFFSET;
+	reply_end = 0;
+	fd_passing = false;
+
+	serve_packet(message);
+
+	size_t end = reply_end > 0 ? reply_end : SHM_LEN;
+
+	ipc_unlock();
+
+	return end;
+}
+
+void ipc_get_stats(ipc_stats_t *copy)
+{
+	copy->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+	copy->late = __atomic_load_n(&stats.late, __ATOMIC_RELAXED);
+}
+
+void end_session(char *username, char *session_id)
+{
+	ipc_lock();
+	user_logout(clients, username, session_id);
+	ipc_unlock();
+}
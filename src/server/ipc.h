@@ -9,6 +9,8 @@
 #ifndef __IPC_H__
 #define __IPC_H__
 
+#include <stddef.h>
+
 #include "list.h"
 
 #include "../share/protocol.h"
@@ -19,13 +21,57 @@
 typedef struct {
 	char session_id[SESSION_ID_SIZE + 1]; ///< Session id for the client.
 	char username[MAX_USERNAME_LEN + 1]; ///< Username of the client.
+	pid_t pid; ///< Process id of the client owning the session, `0` if the session ends with its connection instead.
+	int pidfd; ///< Process file descriptor watching the owner, `-1` if it is not watched.
 } client_t;
 
 /**
- * @brief Handle the packet `packet`.
- * @details Inspects the packet type and delegates to the specific packet handler.
+ * @brief Counters of the requests whose deadline passed.
+ */
+typedef struct {
+	unsigned long dropped; ///< Number of requests dropped without being processed, because their deadline had passed.
+	unsigned long late; ///< Number of requests whose deadline passed while being processed.
+} ipc_stats_t;
+
+/**
+ * @brief Acquire the lock serializing the access to the database and the client list.
+ */
+void ipc_lock(void);
+
+/**
+ * @brief Release the lock acquired by `ipc_lock()`.
+ */
+void ipc_unlock(void);
+
+/**
+ * @brief Handle the packet `packet` in the shared memory.
+ * @details Inspects the packet type and delegates to the specific packet handler. Packets of a type that does not belong to the lane are rejected, and packets whose deadline passed are answered with `TIMEOUT` without being processed. Afterwards, the client is notified and the shared memory is cleared once the client read the response.
  * @param packet The packet to handle.
+ * @param lane The lane the shared memory was granted to.
+ */
+void handle_packet(void *packet, enum lane_e lane);
+
+/**
+ * @brief Handle a message received from a socket.
+ * @details The message starts with a packet, which may be followed by the data arena. The response is written to the same buffer. Secrets are not passed as file descriptors. Packets whose deadline passed are answered with `TIMEOUT` without being processed.
+ * @param message The message to handle.
+ * @param len The number of bytes received.
+ * @param size The number of bytes the buffer has room for, at least `SHM_ARENA_OFFSET`.
+ * @return The length of the response, or `0` if the message is invalid.
+ */
+size_t handle_message(void *message, size_t len, size_t size);
+
+/**
+ * @brief Retrieve the counters of the requests whose deadline passed.
+ * @param stats Where to store the counters.
+ */
+void ipc_get_stats(ipc_stats_t *stats);
+
+/**
+ * @brief End the session `session_id` of the user `username`, if it is still active.
+ * @param username The username of the session.
+ * @param session_id The session id.
  */
-void handle_packet(void *packet);
+void end_session(char *username, char *session_id);
 
 #endif
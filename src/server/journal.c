@@ -0,0 +1,484 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for shipping the journal to a standby server.
+ * @details Every record consists of a fixed header and the secret it carries, if any. Records are numbered per connection, so that the standby notices a gap and synchronizes again. The primary buffers what the socket does not take immediately and never blocks on the standby, which is dropped once it falls behind by `JOURNAL_MAX_PENDING`.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "journal.h"
+#include "handover.h"
+#include "list.h"
+#include "user.h"
+
+#include "../share/fdpass.h"
+#include "../share/protocol.h"
+#include "../share/utils.h"
+#include "../share/shard.h"
+
+/**
+ * @brief Maximum length of the name carried by a record.
+ * @details The name is a password, a session id or the name of a secret, which share the same maximum length.
+ */
+#define JOURNAL_NAME_LEN SESSION_ID_SIZE
+
+/**
+ * @brief The number of bytes the standby receives at once.
+ */
+#define JOURNAL_CHUNK (64 * 1024)
+
+/**
+ * @brief Kind of a record.
+ */
+enum record_e {
+	RECORD_HEARTBEAT,
+	RECORD_REGISTER,
+	RECORD_SECRET,
+	RECORD_KEY,
+	RECORD_KEY_DELETE,
+	RECORD_LOGIN,
+	RECORD_LOGOUT,
+	RECORD_REVOKE,
+};
+
+/**
+ * @brief Header of a record.
+ */
+typedef struct {
+	uint32_t type; ///< Kind of the record, see `record_e`.
+	uint32_t len; ///< Length of the secret following the header.
+	uint64_t sequence; ///< Number of the record, starting at `1` for each connection.
+	uint64_t time; ///< Time in milliseconds at which the primary sent the record.
+	uint64_t version; ///< Version of the secret of the user.
+	uint32_t expires; ///< Time in seconds since the epoch at which the secret expires, `0` if it does not.
+	int32_t pid; ///< Process id of the client owning the session of a login.
+	char username[MAX_USERNAME_LEN + 1]; ///< The user the record refers to.
+	char name[JOURNAL_NAME_LEN + 1]; ///< The password, session id or name of the secret.
+} journal_record_t;
+
+/**
+ * @brief The database.
+ * @details This variable is required for the use of this module.
+ */
+extern database_t *database;
+
+/**
+ * @brief The client list.
+ * @details This variable is required for the use of this module.
+ */
+extern list_t *clients;
+
+/**
+ * @brief Allocate a journal without any connection.
+ * @return The journal, or `NULL` on failure.
+ */
+static journal_t *journal_allocate(void)
+{
+	journal_t *journal = calloc(1, sizeof(journal_t));
+	if (journal == NULL)
+		return NULL;
+
+	journal->listen_fd = -1;
+	journal->fd = -1;
+	journal->pidfd = -1;
+
+	return journal;
+}
+
+/**
+ * @brief Make room for `len` more bytes in the buffer.
+ * @param journal The journal to consider.
+ * @param len The number of bytes to make room for.
+ * @return `true` on success, `false` if the buffer cannot grow.
+ */
+static bool journal_reserve(journal_t *journal, size_t len)
+{
+	// bytes already sent are not kept
+	if (journal->sent > 0) {
+		memmove(journal->buffer, journal->buffer + journal->sent, journal->len - journal->sent);
+		journal->len -= journal->sent;
+		journal->sent = 0;
+	}
+
+	if (journal->len + len <= journal->capacity)
+		return true;
+
+	size_t capacity = journal->capacity != 0 ? journal->capacity : JOURNAL_CHUNK;
+	while (capacity < journal->len + len)
+		capacity *= 2;
+
+	char *buffer = realloc(journal->buffer, capacity);
+	if (buffer == NULL)
+		return false;
+
+	journal->buffer = buffer;
+	journal->capacity = capacity;
+	return true;
+}
+
+/**
+ * @brief Send as much of the buffer as the socket takes without blocking.
+ * @details The standby is dropped if the connection is lost.
+ * @param journal The journal of the primary.
+ */
+static void journal_flush(journal_t *journal)
+{
+	while (journal->fd != -1 && journal->sent < journal->len) {
+		ssize_t n = send(journal->fd, journal->buffer + journal->sent, journal->len - journal->sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+		if (n > 0) {
+			journal->sent += n;
+			journal->bytes += n;
+		} else if (n == -1 && errno == EINTR) {
+			continue;
+		} else {
+			if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+				journal_disconnect(journal);
+			break;
+		}
+	}
+
+	if (journal->sent == journal->len) {
+		journal->len = 0;
+		journal->sent = 0;
+	}
+}
+
+/**
+ * @brief Append a record for the standby and send it.
+ * @param journal The journal to append to, may be `NULL`.
+ * @param r The header of the record, of which the type, the user and the name are set.
+ * @param data The secret carried by the record.
+ * @param len The length of `data`.
+ */
+static void journal_append(journal_t *journal, journal_record_t *r, const char *data, size_t len)
+{
+	if (journal == NULL || journal->standby || journal->fd == -1)
+		return;
+
+	// a standby that falls too far behind is synchronized again
+	if (journal->len - journal->sent + sizeof(*r) + len > JOURNAL_MAX_PENDING ||
+		!journal_reserve(journal, sizeof(*r) + len)) {
+		journal_disconnect(journal);
+		journal->drops += 1;
+		return;
+	}
+
+	r->len = len;
+	r->sequence = ++journal->sequence;
+	r->time = clock_ms();
+
+	memcpy(journal->buffer + journal->len, r, sizeof(*r));
+	if (len > 0)
+		memcpy(journal->buffer + journal->len + sizeof(*r), data, len);
+
+	journal->len += sizeof(*r) + len;
+	journal->records += 1;
+	journal->last_sent = r->time;
+
+	journal_flush(journal);
+}
+
+/**
+ * @brief Prepare the header of a record.
+ * @param r The header to prepare.
+ * @param type The kind of the record.
+ * @param username The user the record refers to, may be `NULL`.
+ * @param name The password, session id or name of the secret, may be `NULL`.
+ */
+static void journal_prepare(journal_record_t *r, enum record_e type, const char *username, const char *name)
+{
+	memset(r, 0, sizeof(*r));
+	r->type = type;
+
+	if (username != NULL)
+		strncpy(r->username, username, MAX_USERNAME_LEN);
+	if (name != NULL)
+		strncpy(r->name, name, JOURNAL_NAME_LEN);
+}
+
+/**
+ * @brief Apply a record on the standby.
+ * @param r The header of the record.
+ * @param data The secret carried by the record, of which `r->len` bytes are valid.
+ * @return `true` on success, `false` if the record does not fit the state of the standby.
+ */
+static bool journal_apply(journal_record_t *r, char *data)
+{
+	r->username[MAX_USERNAME_LEN] = '\0';
+	r->name[JOURNAL_NAME_LEN] = '\0';
+
+	switch (r->type) {
+	case RECORD_HEARTBEAT:
+		return true;
+	case RECORD_REGISTER:
+		return user_register(database, r->username, r->name);
+	case RECORD_SECRET:
+		return user_secret_restore(database, r->username, data, r->len, r->version, r->expires);
+	case RECORD_KEY:
+		// the secret is sent with its terminating null byte
+		if (r->len == 0 || data[r->len - 1] != '\0')
+			return false;
+
+		return user_key_write(database, r->username, r->name, data);
+	case RECORD_KEY_DELETE:
+		return user_key_delete(database, r->username, r->name);
+	case RECORD_LOGIN:
+		return user_login(clients, r->username, r->name, r->pid);
+	case RECORD_LOGOUT:
+		return user_logout(clients, r->username, r->name);
+	case RECORD_REVOKE:
+		user_revoke_tokens(database, r->username);
+		return true;
+	default:
+		return false;
+	}
+}
+
+journal_t *journal_create(int listen_fd)
+{
+	if (listen_fd < 0)
+		listen_fd = unix_listen(shard_name(JOURNAL_SOCKET_NAME), SOCK_STREAM);
+
+	if (listen_fd < 0)
+		return NULL;
+
+	journal_t *journal = journal_allocate();
+	if (journal == NULL) {
+		close(listen_fd);
+		return NULL;
+	}
+
+	journal->listen_fd = listen_fd;
+	return journal;
+}
+
+journal_t *journal_standby(void)
+{
+	journal_t *journal = journal_allocate();
+	if (journal != NULL)
+		journal->standby = true;
+
+	return journal;
+}
+
+void journal_destroy(journal_t *journal)
+{
+	if (journal == NULL)
+		return;
+
+	journal_disconnect(journal);
+
+	if (journal->listen_fd != -1)
+		close(journal->listen_fd);
+	if (journal->pidfd != -1)
+		close(journal->pidfd);
+
+	free(journal->buffer);
+	free(journal);
+}
+
+bool journal_connect(journal_t *journal)
+{
+	journal_disconnect(journal);
+
+	int sock = unix_connect(shard_name(JOURNAL_SOCKET_NAME), SOCK_STREAM);
+	if (sock == -1)
+		return false;
+
+	// the credentials are those of the server that opened the socket, which may have handed over since
+	pid_t pid;
+	if (!handover_peer(sock, NULL) || recv(sock, &pid, sizeof(pid), MSG_WAITALL) != sizeof(pid)) {
+		close(sock);
+		return false;
+	}
+
+	// the primary is watched for exiting, as the connection also ends on a handover
+	int pidfd = syscall(SYS_pidfd_open, pid, 0);
+	if (pidfd == -1) {
+		close(sock);
+		return false;
+	}
+
+	if (journal->pidfd != -1)
+		close(journal->pidfd);
+
+	journal->fd = sock;
+	journal->pidfd = pidfd;
+	journal->sequence = 0;
+	journal->syncs += 1;
+
+	return true;
+}
+
+void journal_disconnect(journal_t *journal)
+{
+	if (journal->fd != -1)
+		close(journal->fd);
+
+	journal->fd = -1;
+	journal->len = 0;
+	journal->sent = 0;
+}
+
+bool journal_follow(journal_t *journal, int timeout)
+{
+	if (journal->fd == -1)
+		return false;
+
+	struct pollfd pfd = { .fd = journal->fd, .events = POLLIN };
+
+	int ready = poll(&pfd, 1, timeout);
+	if (ready <= 0)
+		return ready == 0 || errno == EINTR;
+
+	if (!journal_reserve(journal, JOURNAL_CHUNK)) {
+		journal_disconnect(journal);
+		return false;
+	}
+
+	ssize_t n = recv(journal->fd, journal->buffer + journal->len, journal->capacity - journal->len, MSG_DONTWAIT);
+	if (n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		journal_disconnect(journal);
+		return false;
+	}
+
+	if (n > 0)
+		journal->len += n;
+
+	while (journal->len - journal->sent >= sizeof(journal_record_t)) {
+		journal_record_t r;
+		memcpy(&r, journal->buffer + journal->sent, sizeof(r));
+
+		// a gap or a record that does not fit means the state diverged
+		if (r.len > journal->secret_cap + 1 || r.sequence != journal->sequence + 1) {
+			journal_disconnect(journal);
+			return false;
+		}
+
+		size_t size = sizeof(r) + r.len;
+		if (journal->len - journal->sent < size)
+			break;
+
+		if (!journal_apply(&r, journal->buffer + journal->sent + sizeof(r))) {
+			journal_disconnect(journal);
+			return false;
+		}
+
+		journal->sent += size;
+		journal->sequence = r.sequence;
+		journal->last_applied = r.time;
+		journal->records += 1;
+		journal->bytes += size;
+	}
+
+	return true;
+}
+
+bool journal_primary_gone(journal_t *journal, int timeout)
+{
+	if (journal->pidfd == -1)
+		return true;
+
+	struct pollfd pfd = { .fd = journal->pidfd, .events = POLLIN };
+
+	return poll(&pfd, 1, timeout) > 0;
+}
+
+uint64_t journal_lag(journal_t *journal)
+{
+	if (journal->last_applied == 0)
+		return 0;
+
+	return clock_ms() - journal->last_applied;
+}
+
+void journal_refresh(journal_t *journal, size_t secret_cap)
+{
+	int sock = accept4(journal->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+
+	if (sock != -1) {
+		pid_t pid = getpid();
+
+		// the state is sent while no change can happen, so the records continue right after it
+		if (handover_peer(sock, NULL) && send(sock, &pid, sizeof(pid), MSG_NOSIGNAL) == sizeof(pid) &&
+			handover_send(sock, secret_cap, false) &&
+			fcntl(sock, F_SETFL, O_NONBLOCK) != -1) {
+			journal_disconnect(journal);
+			journal->fd = sock;
+			journal->sequence = 0;
+			journal->syncs += 1;
+		} else {
+			close(sock);
+		}
+	}
+
+	if (journal->fd == -1)
+		return;
+
+	if (clock_ms() - journal->last_sent >= JOURNAL_HEARTBEAT) {
+		journal_record_t r;
+		journal_prepare(&r, RECORD_HEARTBEAT, NULL, NULL);
+		journal_append(journal, &r, NULL, 0);
+	} else {
+		journal_flush(journal);
+	}
+}
+
+void journal_register(journal_t *journal, const char *username, const char *password)
+{
+	journal_record_t r;
+	journal_prepare(&r, RECORD_REGISTER, username, password);
+	journal_append(journal, &r, NULL, 0);
+}
+
+void journal_secret(journal_t *journal, entry_t *e)
+{
+	journal_record_t r;
+	journal_prepare(&r, RECORD_SECRET, e->username, NULL);
+	r.version = e->version;
+	r.expires = e->expires;
+
+	journal_append(journal, &r, secret_data(&e->secret), e->secret.len);
+}
+
+void journal_key(journal_t *journal, const char *username, const char *key, const char *secret)
+{
+	journal_record_t r;
+	journal_prepare(&r, RECORD_KEY, username, key);
+	journal_append(journal, &r, secret, strlen(secret) + 1);
+}
+
+void journal_key_delete(journal_t *journal, const char *username, const char *key)
+{
+	journal_record_t r;
+	journal_prepare(&r, RECORD_KEY_DELETE, username, key);
+	journal_append(journal, &r, NULL, 0);
+}
+
+void journal_session(journal_t *journal, const char *username, const char *session_id, pid_t pid, bool login)
+{
+	journal_record_t r;
+	journal_prepare(&r, login ? RECORD_LOGIN : RECORD_LOGOUT, username, session_id);
+	r.pid = pid;
+	journal_append(journal, &r, NULL, 0);
+}
+
+void journal_revoke(journal_t *journal, const char *username)
+{
+	journal_record_t r;
+	journal_prepare(&r, RECORD_REVOKE, username, NULL);
+	journal_append(journal, &r, NULL, 0);
+}
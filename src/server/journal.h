@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for shipping the journal to a standby server.
+ * @details The primary server listens on `JOURNAL_SOCKET_NAME`. A standby server connects, receives the state of the primary like a new server on a handover, and then applies every change the primary journals: registrations, written and deleted secrets, logins, logouts and revoked tokens. Once the primary is gone, the standby takes over its shared resources.
+ */
+
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+#include "database.h"
+
+/**
+ * @brief The name of the socket the primary listens on for a standby server.
+ */
+#define JOURNAL_SOCKET_NAME "authme_journal"
+
+/**
+ * @brief Time in milliseconds between two heartbeats sent to an idle standby.
+ */
+#define JOURNAL_HEARTBEAT 100
+
+/**
+ * @brief The maximum number of bytes waiting to be sent before the standby is dropped.
+ */
+#define JOURNAL_MAX_PENDING (64 * 1024 * 1024)
+
+/**
+ * @brief Representation of the journal, on either side.
+ */
+typedef struct {
+	int listen_fd; ///< The socket the primary listens on, `-1` on the standby.
+	int fd; ///< The connection between primary and standby, `-1` if there is none.
+	int pidfd; ///< Descriptor of the primary on the standby, `-1` if unknown.
+	size_t secret_cap; ///< Maximum length of a secret.
+	char *buffer; ///< Records waiting to be sent, or received but not yet applied.
+	size_t len; ///< Number of bytes in `buffer`.
+	size_t sent; ///< Number of bytes at the start of `buffer` already sent.
+	size_t capacity; ///< Size of `buffer`.
+	uint64_t sequence; ///< Sequence number of the last record sent or applied.
+	uint64_t last_sent; ///< Time in milliseconds at which the last record was sent.
+	uint64_t last_applied; ///< Time in milliseconds at which the primary sent the last record applied.
+	bool standby; ///< Whether this process is the standby.
+	unsigned long records; ///< Number of records sent or applied.
+	unsigned long bytes; ///< Number of bytes sent or applied.
+	unsigned long syncs; ///< Number of times a standby was synchronized.
+	unsigned long drops; ///< Number of times the standby was dropped for falling behind.
+} journal_t;
+
+/**
+ * @brief Start listening for a standby server.
+ * @param listen_fd The listening socket taken over from the running server, or `-1` to open a new one.
+ * @return The journal, or `NULL` on failure.
+ */
+journal_t *journal_create(int listen_fd);
+
+/**
+ * @brief Create the journal of a standby server, which is not connected yet.
+ * @return The journal, or `NULL` on failure.
+ */
+journal_t *journal_standby(void);
+
+/**
+ * @brief Close the journal.
+ * @param journal The journal to close, may be `NULL`.
+ */
+void journal_destroy(journal_t *journal);
+
+/**
+ * @brief Connect a standby to the primary.
+ * @details A previous connection is closed. The primary sends its process id, and its state follows, and is to be received with `handover_receive()`.
+ * @param journal The journal of the standby.
+ * @return `true` on success, `false` if no primary is listening.
+ */
+bool journal_connect(journal_t *journal);
+
+/**
+ * @brief Close the connection between primary and standby, and discard what is buffered.
+ * @param journal The journal to consider.
+ */
+void journal_disconnect(journal_t *journal);
+
+/**
+ * @brief Apply the records the primary sent.
+ * @details Waits up to `timeout` for records. The connection is closed if it is lost, or if a record cannot be applied. This function makes use of the global variables `database` and `clients`.
+ * @param journal The journal of the standby.
+ * @param timeout Time in milliseconds to wait for records.
+ * @return `true` while connected, `false` once the connection is closed.
+ */
+bool journal_follow(journal_t *journal, int timeout);
+
+/**
+ * @brief Check if the primary the standby was connected to has exited.
+ * @param journal The journal of the standby.
+ * @param timeout Time in milliseconds to wait for the primary to exit.
+ * @return `true` if the primary has exited, `false` otherwise.
+ */
+bool journal_primary_gone(journal_t *journal, int timeout);
+
+/**
+ * @brief Age of the last record the standby applied.
+ * @param journal The journal of the standby.
+ * @return The age in milliseconds, or `0` if nothing was applied.
+ */
+uint64_t journal_lag(journal_t *journal);
+
+/**
+ * @brief Accept a standby and keep it up to date.
+ * @details A new standby receives the state of the primary and replaces the previous one. Pending records are sent, and a heartbeat if nothing was sent for `JOURNAL_HEARTBEAT`. This function makes use of the global variables `database`, `clients`, `fdsock` and `transport`.
+ * @param journal The journal to consider.
+ * @param secret_cap The maximum length of a secret.
+ */
+void journal_refresh(journal_t *journal, size_t secret_cap);
+
+/**
+ * @brief Journal the registration of a user.
+ * @param journal The journal to append to, may be `NULL`.
+ * @param username The username of the new user.
+ * @param password The password of the new user.
+ */
+void journal_register(journal_t *journal, const char *username, const char *password);
+
+/**
+ * @brief Journal a change of the secret of an entry.
+ * @param journal The journal to append to, may be `NULL`.
+ * @param e The entry whose secret changed.
+ */
+void journal_secret(journal_t *journal, entry_t *e);
+
+/**
+ * @brief Journal a written named secret.
+ * @param journal The journal to append to, may be `NULL`.
+ * @param username The user the secret belongs to.
+ * @param key The name of the secret.
+ * @param secret The secret.
+ */
+void journal_key(journal_t *journal, const char *username, const char *key, const char *secret);
+
+/**
+ * @brief Journal a deleted named secret.
+ * @param journal The journal to append to, may be `NULL`.
+ * @param username The user the secret belonged to.
+ * @param key The name of the secret.
+ */
+void journal_key_delete(journal_t *journal, const char *username, const char *key);
+
+/**
+ * @brief Journal a login or logout.
+ * @param journal The journal to append to, may be `NULL`.
+ * @param username The user of the session.
+ * @param session_id The id of the session.
+ * @param pid Process id of the client owning the session, `0` if it has none.
+ * @param login Whether the session started or ended.
+ */
+void journal_session(journal_t *journal, const char *username, const char *session_id, pid_t pid, bool login);
+
+/**
+ * @brief Journal that the resumption tokens of a user were revoked.
+ * @param journal The journal to append to, may be `NULL`.
+ * @param username The user whose tokens were revoked.
+ */
+void journal_revoke(journal_t *journal, const char *username);
+
+#endif
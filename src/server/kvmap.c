@@ -0,0 +1,208 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function definitions for the per-user key map.
+ * @details The map is a small open-addressing hash table with linear probing, mapping names to secrets. A crit-bit tree over the names allows to enumerate them in order. Deleted slots are marked and reclaimed when the map is rebuilt.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "kvmap.h"
+#include "hash.h"
+
+/**
+ * @brief The key used to hash names, shared by all maps.
+ */
+static uint8_t kvmap_key[HASH_KEY_SIZE];
+
+/**
+ * @brief Whether `kvmap_key` has been generated.
+ */
+static bool kvmap_keyed = false;
+
+/**
+ * @brief Hash a name.
+ * @param key The name to hash.
+ * @return The hash value.
+ */
+static uint32_t kvmap_hash(const char *key)
+{
+	return (uint32_t) siphash(kvmap_key, key, strlen(key));
+}
+
+/**
+ * @brief Find the slot of the secret named `key`.
+ * @param map The map to search.
+ * @param key The name to look for.
+ * @param hash The hash of `key`.
+ * @return The slot, or `NULL` if there is none.
+ */
+static kvslot_t *kvmap_find(kvmap_t *map, const char *key, uint32_t hash)
+{
+	uint32_t mask = map->capacity - 1;
+
+	for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+		kvslot_t *slot = &map->slots[i];
+
+		if (slot->key == NULL && !slot->deleted)
+			return NULL;
+
+		if (slot->key != NULL && slot->hash == hash && strcmp(slot->key, key) == 0)
+			return slot;
+	}
+}
+
+/**
+ * @brief Move all secrets to a new slot array of `capacity` slots.
+ * @details Deleted markers are dropped.
+ * @param map The map to rebuild.
+ * @param capacity The new number of slots, a power of two.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool kvmap_rebuild(kvmap_t *map, uint32_t capacity)
+{
+	kvslot_t *slots = calloc(capacity, sizeof(kvslot_t));
+	if (slots == NULL)
+		return false;
+
+	uint32_t mask = capacity - 1;
+
+	for (uint32_t i = 0; i < map->capacity; i++) {
+		kvslot_t *slot = &map->slots[i];
+		if (slot->key == NULL)
+			continue;
+
+		uint32_t j = slot->hash & mask;
+		while (slots[j].key != NULL)
+			j = (j + 1) & mask;
+
+		slots[j] = *slot;
+	}
+
+	free(map->slots);
+	map->slots = slots;
+	map->capacity = capacity;
+	map->used = map->count;
+
+	return true;
+}
+
+kvmap_t *kvmap_initialize(void)
+{
+	if (!kvmap_keyed) {
+		if (hash_key_generate(kvmap_key) != 0)
+			return NULL;
+
+		kvmap_keyed = true;
+	}
+
+	kvmap_t *map = malloc(sizeof(kvmap_t));
+	if (map == NULL)
+		return NULL;
+
+	map->slots = calloc(KVMAP_MIN_CAPACITY, sizeof(kvslot_t));
+	map->order = critbit_initialize();
+	if (map->slots == NULL || map->order == NULL) {
+		free(map->slots);
+		critbit_destroy(map->order);
+		free(map);
+		return NULL;
+	}
+
+	map->capacity = KVMAP_MIN_CAPACITY;
+	map->count = 0;
+	map->used = 0;
+
+	return map;
+}
+
+void kvmap_destroy(kvmap_t *map, database_t *database)
+{
+	if (map == NULL)
+		return;
+
+	for (uint32_t i = 0; i < map->capacity; i++) {
+		kvslot_t *slot = &map->slots[i];
+		if (slot->key == NULL)
+			continue;
+
+		secret_clear(database, &slot->value);
+		free(slot->key);
+	}
+
+	critbit_destroy(map->order);
+	free(map->slots);
+	free(map);
+}
+
+secret_t *kvmap_get(kvmap_t *map, const char *key)
+{
+	kvslot_t *slot = kvmap_find(map, key, kvmap_hash(key));
+	if (slot == NULL)
+		return NULL;
+
+	return &slot->value;
+}
+
+secret_t *kvmap_put(kvmap_t *map, database_t *database, const char *key)
+{
+	uint32_t hash = kvmap_hash(key);
+
+	kvslot_t *slot = kvmap_find(map, key, hash);
+	if (slot != NULL)
+		return &slot->value;
+
+	// keep at least a quarter of the slots empty
+	if (4 * (map->used + 1) > 3 * map->capacity) {
+		uint32_t capacity = map->capacity;
+		if (4 * (map->count + 1) > 3 * capacity / 2)
+			capacity *= 2;
+
+		if (!kvmap_rebuild(map, capacity))
+			return NULL;
+	}
+
+	char *name = strdup(key);
+	if (name == NULL)
+		return NULL;
+
+	if (!critbit_insert(map->order, name)) {
+		free(name);
+		return NULL;
+	}
+
+	uint32_t mask = map->capacity - 1;
+	uint32_t i = hash & mask;
+	while (map->slots[i].key != NULL)
+		i = (i + 1) & mask;
+
+	slot = &map->slots[i];
+	if (!slot->deleted)
+		map->used += 1;
+
+	memset(slot, 0, sizeof(kvslot_t));
+	slot->key = name;
+	slot->hash = hash;
+	map->count += 1;
+
+	return &slot->value;
+}
+
+bool kvmap_delete(kvmap_t *map, database_t *database, const char *key)
+{
+	kvslot_t *slot = kvmap_find(map, key, kvmap_hash(key));
+	if (slot == NULL)
+		return false;
+
+	critbit_remove(map->order, slot->key);
+	secret_clear(database, &slot->value);
+	free(slot->key);
+
+	slot->key = NULL;
+	slot->deleted = true;
+	map->count -= 1;
+
+	return true;
+}
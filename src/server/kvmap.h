@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module provides function declarations for the per-user key map.
+ * @details The map is a small open-addressing hash table with linear probing, mapping names to secrets. A crit-bit tree over the names allows to enumerate them in order.
+ */
+
+#ifndef __KVMAP_H__
+#define __KVMAP_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "database.h"
+#include "critbit.h"
+
+/**
+ * @brief The number of slots of a new map.
+ */
+#define KVMAP_MIN_CAPACITY 4
+
+/**
+ * @brief Slot of a key map.
+ */
+typedef struct {
+	char *key; ///< Name of the secret, `NULL` for an empty slot.
+	secret_t value; ///< The secret.
+	uint32_t hash; ///< Hash of the name.
+	bool deleted; ///< Whether the slot held a deleted secret.
+} kvslot_t;
+
+/**
+ * @brief Representation of a key map.
+ */
+typedef struct kvmap_s {
+	kvslot_t *slots; ///< Slots of the map.
+	uint32_t capacity; ///< Number of slots, a power of two.
+	uint32_t count; ///< Number of secrets in the map.
+	uint32_t used; ///< Number of slots holding a secret or a deleted marker.
+	critbit_t *order; ///< Names of all secrets in order.
+} kvmap_t;
+
+/**
+ * @brief Create a new, empty map.
+ * @return The memory address of the map, or `NULL` on failure.
+ */
+kvmap_t *kvmap_initialize(void);
+
+/**
+ * @brief Destroy the map `map` and all secrets in it.
+ * @param map The map to destroy.
+ * @param database The database the secrets belong to.
+ */
+void kvmap_destroy(kvmap_t *map, database_t *database);
+
+/**
+ * @brief Look up the secret named `key`.
+ * @param map The map to search.
+ * @param key The name to look for.
+ * @return The secret, or `NULL` if there is none.
+ */
+secret_t *kvmap_get(kvmap_t *map, const char *key);
+
+/**
+ * @brief Look up the secret named `key`, creating an empty one if there is none.
+ * @details Pointers to other secrets of the map may become invalid.
+ * @param map The map to modify.
+ * @param database The database the secrets belong to.
+ * @param key The name to look for.
+ * @return The secret, or `NULL` on failure.
+ */
+secret_t *kvmap_put(kvmap_t *map, database_t *database, const char *key);
+
+/**
+ * @brief Delete the secret named `key`.
+ * @param map The map to modify.
+ * @param database The database the secrets belong to.
+ * @param key The name of the secret to delete.
+ * @return `true` if a secret was deleted, `false` otherwise.
+ */
+bool kvmap_delete(kvmap_t *map, database_t *database, const char *key);
+
+#endif
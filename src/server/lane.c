@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for the lanes clients queue in for the shared memory.
+ * @details A client holds the client semaphore of its lane from entering the head of the lane until it released the shared memory or gave up, and releases it before the shared memory. Hence, the client semaphore of a lane is taken exactly while a client waits at its head whenever the shared memory is not granted. A client that gave up at the head leaves its post of the third server semaphore behind, which is then skipped, and a grant it missed is either taken by the next client of the lane or revoked.
+ */
+
+#include <stdlib.h>
+#include <fcntl.h>
+
+#include "lane.h"
+
+#include "../share/utils.h"
+#include "../share/shard.h"
+
+/**
+ * @brief The names of the client semaphores of the lanes.
+ */
+static const char *queue_names[LANES] = { SEM_CLIENT1, SEM_CLIENT2 };
+
+/**
+ * @brief The names of the semaphores granting the shared memory to the lanes.
+ */
+static const char *grant_names[LANES] = { SEM_GRANT1, SEM_GRANT2 };
+
+/**
+ * @brief The names of the semaphores admitting clients to the lanes.
+ */
+static const char *admit_names[LANES] = { SEM_ADMIT1, SEM_ADMIT2 };
+
+/**
+ * @brief Open a semaphore of the lanes.
+ * @param name The name of the semaphore without shards.
+ * @param create Whether to create the semaphore.
+ * @param value The initial value, if created.
+ * @return The semaphore, or `NULL` on failure.
+ */
+static sem_t *lane_sem_open(const char *name, bool create, unsigned value)
+{
+	sem_t *sem = sem_open(shard_name(name), create ? O_CREAT | O_EXCL : 0, 0660, value);
+
+	return sem == SEM_FAILED ? NULL : sem;
+}
+
+/**
+ * @brief Check if a client waits at the head of a lane.
+ * @param lanes The lanes to consider.
+ * @param lane The lane to check.
+ * @return `true` if a client waits, `false` otherwise.
+ */
+static bool lane_waiting(lanes_t *lanes, enum lane_e lane)
+{
+	int sval;
+
+	if (sem_getvalue(lanes->queues[lane], &sval) == -1)
+		print_error_exit("failed retrieving semaphore value");
+
+	return sval <= 0;
+}
+
+lanes_t *lanes_open(bool create, unsigned weight, unsigned depth)
+{
+	lanes_t *lanes = calloc(1, sizeof(lanes_t));
+	if (lanes == NULL)
+		return NULL;
+
+	lanes->depth = depth;
+	lanes->weight = weight;
+	lanes->credit = weight;
+
+	bool ok = (lanes->heads = lane_sem_open(SEM_SERVER3, create, 0)) != NULL;
+
+	for (size_t i = 0; ok && i < LANES; i++) {
+		ok = (lanes->queues[i] = lane_sem_open(queue_names[i], create, 1)) != NULL &&
+			(lanes->grants[i] = lane_sem_open(grant_names[i], create, 0)) != NULL &&
+			(lanes->admits[i] = lane_sem_open(admit_names[i], create, depth)) != NULL;
+	}
+
+	if (!ok) {
+		lanes_destroy(lanes, create);
+		return NULL;
+	}
+
+	return lanes;
+}
+
+void lanes_destroy(lanes_t *lanes, bool unlink)
+{
+	if (lanes == NULL)
+		return;
+
+	sem_cleanup(lanes->heads, unlink ? shard_name(SEM_SERVER3) : NULL);
+
+	for (size_t i = 0; i < LANES; i++) {
+		sem_cleanup(lanes->queues[i], unlink ? shard_name(queue_names[i]) : NULL);
+		sem_cleanup(lanes->grants[i], unlink ? shard_name(grant_names[i]) : NULL);
+		sem_cleanup(lanes->admits[i], unlink ? shard_name(admit_names[i]) : NULL);
+	}
+
+	free(lanes);
+}
+
+void lanes_settle(lanes_t *lanes)
+{
+	for (size_t i = 0; i < LANES; i++) {
+		sem_settle(lanes->queues[i]);
+		sem_settle(lanes->grants[i]);
+	}
+}
+
+int lanes_wait(lanes_t *lanes, int timeout)
+{
+	return sem_timedwait_exit(lanes->heads, timeout);
+}
+
+int lanes_grant(lanes_t *lanes)
+{
+	bool waiting[LANES];
+
+	for (size_t i = 0; i < LANES; i++) {
+		waiting[i] = lane_waiting(lanes, i);
+
+		unsigned queued = lanes_queued(lanes, i);
+		if (queued > lanes->peak[i])
+			lanes->peak[i] = queued;
+	}
+
+	// the clients that posted gave up meanwhile
+	if (!waiting[LANE_INTERACTIVE] && !waiting[LANE_BULK])
+		return -1;
+
+	enum lane_e lane = LANE_BULK;
+	if (waiting[LANE_INTERACTIVE] && (!waiting[LANE_BULK] || lanes->credit > 0))
+		lane = LANE_INTERACTIVE;
+
+	if (lane == LANE_INTERACTIVE && waiting[LANE_BULK]) {
+		lanes->credit--;
+		lanes->deferred++;
+	} else {
+		lanes->credit = lanes->weight;
+	}
+
+	lanes->requests[lane]++;
+
+	if (sem_post(lanes->grants[lane]) != 0)
+		print_error_exit("failed posting semaphore");
+
+	return lane;
+}
+
+bool lanes_revoke(lanes_t *lanes, enum lane_e lane)
+{
+	// a client waiting at the head takes the grant eventually
+	if (lane_waiting(lanes, lane) || sem_trywait(lanes->grants[lane]) != 0)
+		return false;
+
+	lanes->requests[lane]--;
+	lanes->revoked++;
+	return true;
+}
+
+unsigned lanes_queued(lanes_t *lanes, enum lane_e lane)
+{
+	int sval;
+
+	if (sem_getvalue(lanes->admits[lane], &sval) == -1)
+		print_error_exit("failed retrieving semaphore value");
+
+	return sval >= (int) lanes->depth ? 0 : lanes->depth - sval;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for the lanes clients queue in for the shared memory.
+ * @details Clients of each lane queue on the client semaphore of their lane. The client at the head of a lane posts the third server semaphore and waits for the grant of its lane, and the server grants the shared memory to one lane at a time, preferring the interactive lane by a configurable weight. This way, reads and writes of logged in users wait for at most one registration or login, however many are queued. Each lane admits a bounded number of clients, and clients that find it full are turned away at once.
+ */
+
+#ifndef __LANE_H__
+#define __LANE_H__
+
+#include <stdbool.h>
+#include <semaphore.h>
+
+#include "../share/protocol.h"
+
+/**
+ * @brief The default number of interactive requests served for every bulk request while both lanes wait.
+ */
+#define LANE_WEIGHT_DEFAULT 4
+
+/**
+ * @brief The maximum number of interactive requests served for every bulk request while both lanes wait.
+ */
+#define LANE_WEIGHT_MAX 1024
+
+/**
+ * @brief The default number of clients admitted to a lane.
+ */
+#define LANE_DEPTH_DEFAULT 64
+
+/**
+ * @brief The maximum number of clients admitted to a lane.
+ */
+#define LANE_DEPTH_MAX 65536
+
+/**
+ * @brief Time in milliseconds a client may take to start using the shared memory once granted.
+ * @details The grant is revoked afterwards, as the client may have given up before it was granted.
+ */
+#define LANE_GRANT_TIMEOUT 100
+
+/**
+ * @brief Representation of the lanes.
+ */
+typedef struct {
+	sem_t *heads; ///< The third server semaphore, posted by every client that reached the head of its lane.
+	sem_t *queues[LANES]; ///< The client semaphore of every lane, held by the client at its head.
+	sem_t *grants[LANES]; ///< The semaphore granting the shared memory to every lane.
+	sem_t *admits[LANES]; ///< The semaphore admitting clients to every lane.
+	unsigned depth; ///< Number of clients admitted to every lane.
+	unsigned weight; ///< Number of interactive requests served for every bulk request while both lanes wait.
+	unsigned credit; ///< Number of interactive requests still served before the waiting bulk request.
+	unsigned long requests[LANES]; ///< Number of requests granted to every lane.
+	unsigned long deferred; ///< Number of times the bulk lane waited while the interactive lane was granted.
+	unsigned long revoked; ///< Number of grants revoked, because the client had given up.
+	unsigned peak[LANES]; ///< Largest number of clients found in every lane.
+} lanes_t;
+
+/**
+ * @brief Create the semaphores of the lanes, or open those of the running server.
+ * @param create Whether to create the semaphores. They must not exist yet.
+ * @param weight The number of interactive requests served for every bulk request while both lanes wait.
+ * @param depth The number of clients admitted to every lane. It must be the one of the running server, if the semaphores are not created.
+ * @return The lanes, or `NULL` on failure.
+ */
+lanes_t *lanes_open(bool create, unsigned weight, unsigned depth);
+
+/**
+ * @brief Close the semaphores of the lanes.
+ * @param lanes The lanes to close, may be `NULL`.
+ * @param unlink Whether to remove the semaphores.
+ */
+void lanes_destroy(lanes_t *lanes, bool unlink);
+
+/**
+ * @brief Wake up the clients waiting in the lanes.
+ * @details The clients notice that the server is offline.
+ * @param lanes The lanes to consider.
+ */
+void lanes_settle(lanes_t *lanes);
+
+/**
+ * @brief Wait for a client to reach the head of a lane.
+ * @param lanes The lanes to consider.
+ * @param timeout Time in milliseconds to wait.
+ * @return `0` if a client is waiting, a positive value if interrupted or timed out.
+ */
+int lanes_wait(lanes_t *lanes, int timeout);
+
+/**
+ * @brief Grant the shared memory to the client at the head of a lane.
+ * @details Must only be called once for every successful `lanes_wait()`, while the shared memory is not granted. The bulk lane is granted after `weight` interactive requests were granted while it waited. Nothing is granted if the clients gave up waiting.
+ * @param lanes The lanes to consider.
+ * @return The lane granted, or `-1` if no client waits.
+ */
+int lanes_grant(lanes_t *lanes);
+
+/**
+ * @brief Revoke the grant of a lane, unless a client took it.
+ * @param lanes The lanes to consider.
+ * @param lane The lane granted.
+ * @return `true` if the grant was revoked, `false` if a client took it.
+ */
+bool lanes_revoke(lanes_t *lanes, enum lane_e lane);
+
+/**
+ * @brief Retrieve the number of clients in a lane.
+ * @details This includes the client using the shared memory.
+ * @param lanes The lanes to consider.
+ * @param lane The lane to consider.
+ * @return The number of clients.
+ */
+unsigned lanes_queued(lanes_t *lanes, enum lane_e lane);
+
+#endif
@@ -46,21 +46,21 @@ int list_size(list_t *list)
 	return list->length;
 }
 
-bool list_add(list_t *list, obj_t obj, size_t n)
+obj_t list_add(list_t *list, obj_t obj, size_t n)
 {
 	if (obj == NULL)
-		return false;
+		return NULL;
 
 	obj_t inmem = malloc(n);
 	if (inmem == NULL)
-		return false;
+		return NULL;
 
 	memcpy(inmem, obj, n);
 
 	element_t *element = malloc(sizeof(element_t));
 	if (element == NULL) {
 		free(inmem);
-		return false;
+		return NULL;
 	}
 
 	element->data = inmem;
@@ -76,7 +76,7 @@ bool list_add(list_t *list, obj_t obj, size_t n)
 	}
 
 	list->length += 1;
-	return true;
+	return inmem;
 }
 
 bool list_remove(list_t *list, obj_t obj)
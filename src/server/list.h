@@ -58,9 +58,9 @@ int list_size(list_t *list);
  * @param list The list to add the item to.
  * @param obj The item to add to the list.
  * @param n The length of the item `obj`.
- * @return `true` on success, `false` on failure.
+ * @return The copy of `obj` stored in the list, or `NULL` on failure.
  */
-bool list_add(list_t *list, obj_t obj, size_t n);
+obj_t list_add(list_t *list, obj_t obj, size_t n);
 
 /**
  * @brief Remove the item `obj` from the list `list`.
@@ -10,8 +10,16 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
 
 #include "options.h"
+#include "lane.h"
+#include "ratelimit.h"
+#include "placement.h"
+
+#include "../share/protocol.h"
+#include "../share/shard.h"
 
 /**
  * @brief Program name.
@@ -25,7 +33,7 @@ extern char *progname;
  */
 static void usage(void)
 {
-	fprintf(stderr, "Usage: %s [ -l database ]\n", progname);
+	fprintf(stderr, "Usage: %s [ -l database ] [ -s secret_cap ] [ -f ] [ -u | -i ] [ -H | -S ] [ -p ] [ -j ] [ -k shard/shards ] [ -w weight ] [ -q depth ] [ -L user_rate/client_rate ] [ -c cpus ] [ -g ] [ -m ]\n       %s -R index [ -u | -i ] [ -k shard/shards ] [ -c cpus ]\n", progname, progname);
 	exit(EXIT_FAILURE);
 }
 
@@ -34,9 +42,44 @@ void parse_arguments(int argc, char *argv[], options_t *options)
 	opterr = 0;
 
 	bool parsed_database = false;
+	bool parsed_secret_cap = false;
+	bool parsed_fd_passing = false;
+	bool parsed_transport = false;
+	bool parsed_handover = false;
+	bool parsed_publish = false;
+	bool parsed_replica = false;
+	bool parsed_journal = false;
+	bool parsed_standby = false;
+	bool parsed_shard = false;
+	bool parsed_weight = false;
+	bool parsed_depth = false;
+	bool parsed_rate = false;
+	bool parsed_cpus = false;
+	bool parsed_huge_pages = false;
+	bool parsed_lock_memory = false;
+	char *endptr;
+
+	options->secret_cap = SECRET_CAP_DEFAULT;
+	options->fd_passing = false;
+	options->transport = false;
+	options->uring = false;
+	options->handover = false;
+	options->publish = false;
+	options->replica = -1;
+	options->journal = false;
+	options->standby = false;
+	options->shard = 0;
+	options->shards = 1;
+	options->weight = LANE_WEIGHT_DEFAULT;
+	options->depth = LANE_DEPTH_DEFAULT;
+	options->user_rate = 0;
+	options->client_rate = 0;
+	options->cpus = NULL;
+	options->huge_pages = false;
+	options->lock_memory = false;
 
 	int c;
-	while ((c = getopt(argc, argv, "l:")) != -1) {
+	while ((c = getopt(argc, argv, "l:s:fuiHpR:jSk:w:q:L:c:gm")) != -1) {
 		switch (c) {
 		case 'l':
 			if (parsed_database)
@@ -45,6 +88,161 @@ void parse_arguments(int argc, char *argv[], options_t *options)
 			options->database_path = optarg;
 			parsed_database = true;
 			break;
+		case 's':
+			if (parsed_secret_cap)
+				usage();
+
+			errno = 0;
+			unsigned long cap = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || *endptr != '\0' || cap < MAX_SECRET_LEN || cap >= UINT32_MAX)
+				usage();
+
+			options->secret_cap = cap;
+			parsed_secret_cap = true;
+			break;
+		case 'f':
+			if (parsed_fd_passing)
+				usage();
+
+			options->fd_passing = true;
+			parsed_fd_passing = true;
+			break;
+		case 'u':
+			if (parsed_transport)
+				usage();
+
+			options->transport = true;
+			parsed_transport = true;
+			break;
+		case 'i':
+			if (parsed_transport)
+				usage();
+
+			options->transport = true;
+			options->uring = true;
+			parsed_transport = true;
+			break;
+		case 'H':
+			if (parsed_handover)
+				usage();
+
+			options->handover = true;
+			parsed_handover = true;
+			break;
+		case 'p':
+			if (parsed_publish)
+				usage();
+
+			options->publish = true;
+			parsed_publish = true;
+			break;
+		case 'R':
+			if (parsed_replica)
+				usage();
+
+			errno = 0;
+			unsigned long index = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || *optarg == '\0' || *endptr != '\0' || index >= MAX_REPLICAS)
+				usage();
+
+			options->replica = index;
+			parsed_replica = true;
+			break;
+		case 'j':
+			if (parsed_journal)
+				usage();
+
+			options->journal = true;
+			parsed_journal = true;
+			break;
+		case 'S':
+			if (parsed_standby)
+				usage();
+
+			options->standby = true;
+			parsed_standby = true;
+			break;
+		case 'k':
+			if (parsed_shard)
+				usage();
+
+			errno = 0;
+			unsigned long shard = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || endptr == optarg || *endptr != '/')
+				usage();
+
+			char *count = endptr + 1;
+			unsigned long shards = strtoul(count, &endptr, 10);
+			if (errno != 0 || *count == '\0' || *endptr != '\0' || shards == 0 || shards > MAX_SHARDS || shard >= shards)
+				usage();
+
+			options->shard = shard;
+			options->shards = shards;
+			parsed_shard = true;
+			break;
+		case 'w':
+			if (parsed_weight)
+				usage();
+
+			errno = 0;
+			unsigned long weight = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || *optarg == '\0' || *endptr != '\0' || weight == 0 || weight > LANE_WEIGHT_MAX)
+				usage();
+
+			options->weight = weight;
+			parsed_weight = true;
+			break;
+		case 'q':
+			if (parsed_depth)
+				usage();
+
+			errno = 0;
+			unsigned long depth = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || *optarg == '\0' || *endptr != '\0' || depth == 0 || depth > LANE_DEPTH_MAX)
+				usage();
+
+			options->depth = depth;
+			parsed_depth = true;
+			break;
+		case 'L':
+			if (parsed_rate)
+				usage();
+
+			errno = 0;
+			unsigned long user_rate = strtoul(optarg, &endptr, 10);
+			if (errno != 0 || endptr == optarg || *endptr != '/' || user_rate > RATELIMIT_RATE_MAX)
+				usage();
+
+			char *client = endptr + 1;
+			unsigned long client_rate = strtoul(client, &endptr, 10);
+			if (errno != 0 || *client == '\0' || *endptr != '\0' || client_rate > RATELIMIT_RATE_MAX)
+				usage();
+
+			options->user_rate = user_rate;
+			options->client_rate = client_rate;
+			parsed_rate = true;
+			break;
+		case 'c':
+			if (parsed_cpus || !placement_cpus_valid(optarg))
+				usage();
+
+			options->cpus = optarg;
+			parsed_cpus = true;
+			break;
+		case 'g':
+			if (parsed_huge_pages)
+				usage();
+
+			options->huge_pages = true;
+			parsed_huge_pages = true;
+			break;
+		case 'm':
+			if (parsed_lock_memory)
+				usage();
+
+			options->lock_memory = true;
+			parsed_lock_memory = true;
+			break;
 		default:
 			usage();
 		}
@@ -53,6 +251,18 @@ void parse_arguments(int argc, char *argv[], options_t *options)
 	if (argc != optind)
 		usage();
 
+	// a replica serves its copy over the socket transport only
+	if (parsed_replica && (parsed_database || parsed_secret_cap || parsed_fd_passing || parsed_handover || parsed_publish || parsed_journal || parsed_standby || parsed_weight || parsed_depth || parsed_rate || parsed_huge_pages || parsed_lock_memory))
+		usage();
+
+	// a new server takes the secret cap and the lanes of the running server
+	if (parsed_handover && parsed_depth)
+		usage();
+
+	// a standby takes the state and the secret cap of the running server
+	if (parsed_standby && (parsed_handover || parsed_secret_cap))
+		usage();
+
 	if (!parsed_database)
 		options->database_path = NULL;
 }
@@ -9,12 +9,33 @@
 #ifndef __OPTIONS_H__
 #define __OPTIONS_H__
 
+#include <stddef.h>
+#include <stdbool.h>
+
 /**
  * @brief Program configuration.
  * @details This struct is used to keep the configuration retrived by parsing program arguments at program start.
  */
 typedef struct {
 	char *database_path; ///< Path of the file where the database is read from.
+	size_t secret_cap; ///< Maximum length of a secret.
+	bool fd_passing; ///< Whether to offer passing long secrets as file descriptors.
+	bool transport; ///< Whether to serve requests over the socket transport as well.
+	bool uring; ///< Whether to drive the socket transport with a submission ring.
+	bool handover; ///< Whether to take over from the running server instead of reading the database.
+	bool publish; ///< Whether to publish the database for read-only replicas.
+	bool journal; ///< Whether to ship the journal to a standby server.
+	bool standby; ///< Whether to follow the journal of the running server and take over once it is gone.
+	int replica; ///< Index of the read-only replica to run as, `-1` to run as server.
+	unsigned shard; ///< Index of the shard of the users the server owns.
+	unsigned shards; ///< Number of shards of the cluster, `1` if the server owns all users.
+	unsigned weight; ///< Number of interactive requests served for every bulk request while both lanes wait.
+	unsigned depth; ///< Number of clients admitted to every lane.
+	unsigned user_rate; ///< Number of logins allowed per minute and username, `0` if unlimited.
+	unsigned client_rate; ///< Number of logins allowed per minute and client, `0` if unlimited.
+	char *cpus; ///< List of CPUs the server runs on, `NULL` to run on any.
+	bool huge_pages; ///< Whether to back large arrays by huge pages.
+	bool lock_memory; ///< Whether to fault in and lock the memory of the server once it started.
 } options_t;
 
 /**
@@ -0,0 +1,166 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for placing the server on CPUs and its memory on pages.
+ * @details Memory is locked with `mlockall()` once the server started instead of for every future mapping, as the mapping of the copy published for replicas reserves far more than it uses.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+
+#include <sys/mman.h>
+
+#include "placement.h"
+
+/**
+ * @brief Whether large arrays are backed by huge pages.
+ */
+static bool huge_pages = false;
+
+/**
+ * @brief Whether large arrays are faulted in when allocated.
+ */
+static bool prefault = false;
+
+/**
+ * @brief Statistics of the placement.
+ */
+static placement_stats_t stats;
+
+/**
+ * @brief Parse a list of CPUs.
+ * @param cpus The list of CPUs, such as `0-3,8`.
+ * @param set The set to add the CPUs to.
+ * @return `true` if the list is well-formed, `false` otherwise.
+ */
+static bool parse_cpus(const char *cpus, cpu_set_t *set)
+{
+	CPU_ZERO(set);
+
+	const char *curr = cpus;
+	char *endptr;
+
+	do {
+		if (!isdigit((unsigned char) *curr))
+			return false;
+
+		errno = 0;
+		unsigned long first = strtoul(curr, &endptr, 10);
+		unsigned long last = first;
+
+		if (*endptr == '-') {
+			curr = endptr + 1;
+			if (!isdigit((unsigned char) *curr))
+				return false;
+
+			last = strtoul(curr, &endptr, 10);
+		}
+
+		if (errno != 0)
+			return false;
+
+		if (first > last || last >= CPU_SETSIZE)
+			return false;
+
+		for (unsigned long cpu = first; cpu <= last; cpu++)
+			CPU_SET(cpu, set);
+
+		curr = endptr + 1;
+	} while (*endptr == ',');
+
+	return *endptr == '\0';
+}
+
+bool placement_cpus_valid(const char *cpus)
+{
+	cpu_set_t set;
+
+	return parse_cpus(cpus, &set);
+}
+
+bool placement_pin(const char *cpus)
+{
+	cpu_set_t set;
+
+	if (!parse_cpus(cpus, &set))
+		return false;
+
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+void placement_configure(bool huge, bool fault)
+{
+	huge_pages = huge;
+	prefault = fault;
+}
+
+/**
+ * @brief Round a length up to whole huge pages.
+ * @param len The length in bytes.
+ * @return The rounded length.
+ */
+static size_t huge_round(size_t len)
+{
+	return (len + PLACEMENT_HUGE_SIZE - 1) & ~(PLACEMENT_HUGE_SIZE - 1);
+}
+
+void *placement_alloc(size_t len)
+{
+	if (!huge_pages || len < PLACEMENT_HUGE_SIZE)
+		return calloc(len, 1);
+
+	len = huge_round(len);
+
+	// reserved huge pages are only there if the administrator set some aside
+	void *mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (prefault ? MAP_POPULATE : 0), -1, 0);
+	if (mem != MAP_FAILED) {
+		stats.huge_bytes += len;
+		return mem;
+	}
+
+	mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+
+	madvise(mem, len, MADV_HUGEPAGE);
+
+	// faulted in only after the advice, so that huge pages are used right away
+	if (prefault)
+		memset(mem, 0, len);
+
+	stats.huge_bytes += len;
+	return mem;
+}
+
+void placement_free(void *mem, size_t len)
+{
+	if (!huge_pages || len < PLACEMENT_HUGE_SIZE) {
+		free(mem);
+		return;
+	}
+
+	if (mem != NULL) {
+		munmap(mem, huge_round(len));
+		stats.huge_bytes -= huge_round(len);
+	}
+}
+
+bool placement_lock(void)
+{
+	if (mlockall(MCL_CURRENT) != 0)
+		return false;
+
+	stats.locked = true;
+	return true;
+}
+
+void placement_get_stats(placement_stats_t *copy)
+{
+	*copy = stats;
+}
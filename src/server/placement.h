@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for placing the server on CPUs and its memory on pages.
+ * @details The server is pinned before it allocates anything, so that memory is first touched, and hence allocated, on the NUMA node of its CPUs. Large arrays can be backed by huge pages, reserved ones if available and transparent ones otherwise, and the memory of the server can be faulted in and locked once it started.
+ */
+
+#ifndef __PLACEMENT_H__
+#define __PLACEMENT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The size of a huge page in bytes.
+ * @details Smaller arrays are allocated as usual.
+ */
+#define PLACEMENT_HUGE_SIZE ((size_t) 2 * 1024 * 1024)
+
+/**
+ * @brief Statistics of the placement.
+ */
+typedef struct {
+	size_t huge_bytes; ///< Number of bytes of the arrays backed by huge pages, either reserved ones or transparent ones.
+	bool locked; ///< Whether the memory of the server is locked.
+} placement_stats_t;
+
+/**
+ * @brief Check a list of CPUs.
+ * @param cpus The list of CPUs, such as `0-3,8`.
+ * @return `true` if the list is well-formed, `false` otherwise.
+ */
+bool placement_cpus_valid(const char *cpus);
+
+/**
+ * @brief Run the calling thread, and the threads it creates afterwards, on a list of CPUs.
+ * @param cpus The list of CPUs, which must be well-formed.
+ * @return `true` on success, `false` otherwise.
+ */
+bool placement_pin(const char *cpus);
+
+/**
+ * @brief Configure how large arrays are allocated.
+ * @details Must be called before anything is allocated with `placement_alloc()`.
+ * @param huge_pages Whether to back large arrays by huge pages.
+ * @param prefault Whether to fault in large arrays when allocated.
+ */
+void placement_configure(bool huge_pages, bool prefault);
+
+/**
+ * @brief Allocate a zeroed array, backed by huge pages if configured and large enough.
+ * @param len The length of the array in bytes.
+ * @return The array, or `NULL` on failure.
+ */
+void *placement_alloc(size_t len);
+
+/**
+ * @brief Free an array allocated with `placement_alloc()`.
+ * @param mem The array, may be `NULL`.
+ * @param len The length the array was allocated with.
+ */
+void placement_free(void *mem, size_t len);
+
+/**
+ * @brief Fault in and lock all memory the server has mapped so far.
+ * @return `true` on success, `false` otherwise.
+ */
+bool placement_lock(void);
+
+/**
+ * @brief Retrieve the statistics of the placement.
+ * @param stats Where to store the statistics.
+ */
+void placement_get_stats(placement_stats_t *stats);
+
+#endif
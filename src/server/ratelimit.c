@@ -0,0 +1,103 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for rate limiting logins.
+ * @details Tokens are counted in units of `1 / RATELIMIT_PERIOD` tokens, so that a bucket gains exactly `rate` units per millisecond and no time is lost to rounding.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ratelimit.h"
+
+ratelimit_t *ratelimit_create(unsigned rate)
+{
+	ratelimit_t *limiter = malloc(sizeof(ratelimit_t));
+	if (limiter == NULL)
+		return NULL;
+
+	memset(limiter, 0, sizeof(ratelimit_t));
+	limiter->rate = rate;
+
+	if (hash_key_generate(limiter->key) != 0) {
+		free(limiter);
+		return NULL;
+	}
+
+	limiter->buckets = calloc(RATELIMIT_SLOTS, sizeof(ratelimit_bucket_t));
+	if (limiter->buckets == NULL) {
+		free(limiter);
+		return NULL;
+	}
+
+	return limiter;
+}
+
+void ratelimit_destroy(ratelimit_t *limiter)
+{
+	if (limiter == NULL)
+		return;
+
+	free(limiter->buckets);
+	free(limiter);
+}
+
+/**
+ * @brief Find the bucket of an identity, or take a bucket for it.
+ * @param limiter The rate limiter to consider.
+ * @param hash The hash of the identity, which must not be `0`.
+ * @param now The current time, as returned by `clock_ms()`.
+ * @return The bucket of the identity.
+ */
+static ratelimit_bucket_t *ratelimit_find(ratelimit_t *limiter, uint64_t hash, uint64_t now)
+{
+	ratelimit_bucket_t *victim = NULL;
+
+	for (size_t i = 0; i < RATELIMIT_PROBES; i++) {
+		ratelimit_bucket_t *bucket = &limiter->buckets[(hash + i) & (RATELIMIT_SLOTS - 1)];
+
+		if (bucket->hash == hash)
+			return bucket;
+
+		// prefer an empty slot, and the bucket refilled longest ago otherwise
+		if (victim == NULL || (victim->hash != 0 && (bucket->hash == 0 || bucket->refilled < victim->refilled)))
+			victim = bucket;
+	}
+
+	if (victim->hash == 0)
+		limiter->count++;
+	else
+		limiter->evictions++;
+
+	victim->hash = hash;
+	victim->refilled = now;
+	victim->tokens = limiter->rate * RATELIMIT_PERIOD;
+
+	return victim;
+}
+
+bool ratelimit_take(ratelimit_t *limiter, const void *id, size_t len, uint64_t now)
+{
+	uint64_t hash = siphash(limiter->key, id, len);
+	if (hash == 0)
+		hash = 1;
+
+	ratelimit_bucket_t *bucket = ratelimit_find(limiter, hash, now);
+
+	// refill for the time since the bucket was last seen
+	uint64_t full = (uint64_t) limiter->rate * RATELIMIT_PERIOD;
+	uint64_t elapsed = now > bucket->refilled ? now - bucket->refilled : 0;
+	uint64_t tokens = elapsed >= RATELIMIT_PERIOD ? full : bucket->tokens + elapsed * limiter->rate;
+
+	bucket->tokens = tokens < full ? tokens : full;
+	bucket->refilled = now;
+
+	if (bucket->tokens < RATELIMIT_PERIOD) {
+		limiter->limited++;
+		return false;
+	}
+
+	bucket->tokens -= RATELIMIT_PERIOD;
+	return true;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for rate limiting logins.
+ * @details Every identity, such as a username or the process id of a client, has a token bucket holding up to one minute of its rate. Buckets are refilled lazily when the identity is seen again. They are kept in a fixed hash table, where an identity may take any of a few slots following its hash, and the bucket refilled longest ago is evicted if they are all taken.
+ */
+
+#ifndef __RATELIMIT_H__
+#define __RATELIMIT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+
+/**
+ * @brief Time in milliseconds in which an empty bucket is refilled completely.
+ */
+#define RATELIMIT_PERIOD 60000
+
+/**
+ * @brief The maximum rate in logins per minute.
+ * @details A full bucket must fit 32 bits in units of `1 / RATELIMIT_PERIOD` tokens.
+ */
+#define RATELIMIT_RATE_MAX 60000
+
+/**
+ * @brief The number of clients whose rate the clients of the shared memory share in total.
+ * @details Their process ids are not verified like the peer credentials of the socket, so a single client could otherwise claim the rate of many.
+ */
+#define RATELIMIT_SHARED_CLIENTS 16
+
+/**
+ * @brief The number of buckets of a rate limiter, a power of two.
+ */
+#define RATELIMIT_SLOTS 8192
+
+/**
+ * @brief The number of slots following its hash an identity may take.
+ */
+#define RATELIMIT_PROBES 8
+
+/**
+ * @brief Representation of a token bucket.
+ */
+typedef struct {
+	uint64_t hash; ///< Hash of the identity, `0` if the slot is empty.
+	uint64_t refilled; ///< Time in milliseconds, as returned by `clock_ms()`, at which the bucket was last refilled.
+	uint32_t tokens; ///< Tokens in the bucket, in units of `1 / RATELIMIT_PERIOD` tokens.
+} ratelimit_bucket_t;
+
+/**
+ * @brief Representation of a rate limiter.
+ */
+typedef struct {
+	ratelimit_bucket_t *buckets; ///< The hash table of buckets.
+	unsigned rate; ///< Number of logins allowed per minute and identity.
+	uint8_t key[HASH_KEY_SIZE]; ///< Key used to hash identities.
+	size_t count; ///< Number of buckets in use.
+	unsigned long limited; ///< Number of logins rejected.
+	unsigned long evictions; ///< Number of buckets evicted for another identity.
+} ratelimit_t;
+
+/**
+ * @brief Create a new rate limiter.
+ * @param rate The number of logins allowed per minute and identity, at most `RATELIMIT_RATE_MAX`.
+ * @return The memory address of the rate limiter, or `NULL` on failure.
+ */
+ratelimit_t *ratelimit_create(unsigned rate);
+
+/**
+ * @brief Destroy the rate limiter `limiter` created previously.
+ * @param limiter The rate limiter to destroy, may be `NULL`.
+ */
+void ratelimit_destroy(ratelimit_t *limiter);
+
+/**
+ * @brief Take a token from the bucket of an identity.
+ * @details An identity seen for the first time starts with a full bucket.
+ * @param limiter The rate limiter to consider.
+ * @param id The identity.
+ * @param len The length of `id` in bytes.
+ * @param now The current time, as returned by `clock_ms()`.
+ * @return `true` if a token was taken, `false` if the bucket is empty.
+ */
+bool ratelimit_take(ratelimit_t *limiter, const void *id, size_t len, uint64_t now);
+
+#endif
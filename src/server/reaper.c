@@ -0,0 +1,131 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for ending the sessions of clients that exited.
+ * @details The `epoll` instance is only polled without blocking, from the main loop of the server, once per `SWEEP_INTERVAL`. Every event refers to the session it was registered for.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "reaper.h"
+#include "user.h"
+
+reaper_t *reaper_create(void)
+{
+	reaper_t *reaper = calloc(1, sizeof(reaper_t));
+	if (reaper == NULL)
+		return NULL;
+
+	reaper->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (reaper->epfd == -1) {
+		free(reaper);
+		return NULL;
+	}
+
+	// failing to raise the limit only leaves more sessions unwatched
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	return reaper;
+}
+
+void reaper_destroy(reaper_t *reaper)
+{
+	if (reaper == NULL)
+		return;
+
+	close(reaper->epfd);
+	free(reaper);
+}
+
+bool reaper_watch(reaper_t *reaper, client_t *client)
+{
+	client->pidfd = -1;
+
+	if (reaper == NULL || client->pid <= 0)
+		return true;
+
+	int pidfd = syscall(SYS_pidfd_open, client->pid, 0);
+	if (pidfd == -1) {
+		if (errno == ESRCH)
+			return false;
+
+		reaper->unwatched++;
+		return true;
+	}
+
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = client };
+	if (epoll_ctl(reaper->epfd, EPOLL_CTL_ADD, pidfd, &ev) == -1) {
+		close(pidfd);
+		reaper->unwatched++;
+		return true;
+	}
+
+	client->pidfd = pidfd;
+	reaper->watched++;
+	return true;
+}
+
+void reaper_forget(reaper_t *reaper, client_t *client)
+{
+	if (reaper == NULL || client->pidfd == -1)
+		return;
+
+	// closing the descriptor removes it from the epoll instance
+	close(client->pidfd);
+	client->pidfd = -1;
+	reaper->watched--;
+}
+
+/**
+ * @brief End the session of a client.
+ * @param reaper The reaper to use.
+ * @param clients The client list.
+ * @param client The session to end, which is freed.
+ */
+static void reaper_end(reaper_t *reaper, list_t *clients, client_t *client)
+{
+	// the session is freed while ending it
+	char username[MAX_USERNAME_LEN + 1];
+	char session_id[SESSION_ID_SIZE + 1];
+	strncpy(username, client->username, MAX_USERNAME_LEN + 1);
+	strncpy(session_id, client->session_id, SESSION_ID_SIZE + 1);
+
+	if (user_logout(clients, username, session_id))
+		reaper->reaped++;
+}
+
+void reaper_adopt(reaper_t *reaper, list_t *clients)
+{
+	element_t *curr = clients->head;
+
+	while (curr != NULL) {
+		client_t *c = (client_t *) curr->data;
+		curr = curr->next;
+
+		if (c->pidfd == -1 && !reaper_watch(reaper, c))
+			reaper_end(reaper, clients, c);
+	}
+}
+
+void reaper_collect(reaper_t *reaper, list_t *clients)
+{
+	struct epoll_event events[REAPER_BATCH];
+
+	int count = epoll_wait(reaper->epfd, events, REAPER_BATCH, 0);
+
+	// sessions are only freed once their descriptor is closed, so no event refers to a freed one
+	for (int i = 0; i < count; i++)
+		reaper_end(reaper, clients, (client_t *) events[i].data.ptr);
+}
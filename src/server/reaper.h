@@ -0,0 +1,78 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for ending the sessions of clients that exited.
+ * @details The process owning a session of the shared memory is watched through a process file descriptor, which becomes readable once the process exits. All descriptors are registered with one `epoll` instance, so that the server learns of exited clients without looking at every session.
+ */
+
+#ifndef __REAPER_H__
+#define __REAPER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ipc.h"
+#include "list.h"
+
+/**
+ * @brief The maximum number of exited clients collected at once.
+ */
+#define REAPER_BATCH 64
+
+/**
+ * @brief Representation of the reaper.
+ */
+typedef struct {
+	int epfd; ///< The `epoll` instance the process file descriptors are registered with.
+	size_t watched; ///< Number of sessions whose owner is watched.
+	unsigned long reaped; ///< Number of sessions ended because their owner exited.
+	unsigned long unwatched; ///< Number of sessions whose owner could not be watched.
+} reaper_t;
+
+/**
+ * @brief Create a new reaper.
+ * @details The limit of open file descriptors is raised as far as allowed, as every watched session takes one.
+ * @return The memory address of the reaper, or `NULL` on failure.
+ */
+reaper_t *reaper_create(void);
+
+/**
+ * @brief Destroy the reaper `reaper` created previously.
+ * @param reaper The reaper to destroy, may be `NULL`.
+ */
+void reaper_destroy(reaper_t *reaper);
+
+/**
+ * @brief Start watching the owner of a session.
+ * @details Sessions without an owner are not watched. If the owner cannot be watched for another reason than having exited, the session is kept without being watched.
+ * @param reaper The reaper to use, may be `NULL`.
+ * @param client The session, whose process file descriptor is set.
+ * @return `false` if the owner has exited already, `true` otherwise.
+ */
+bool reaper_watch(reaper_t *reaper, client_t *client);
+
+/**
+ * @brief Stop watching the owner of a session.
+ * @param reaper The reaper to use, may be `NULL`.
+ * @param client The session, whose process file descriptor is closed.
+ */
+void reaper_forget(reaper_t *reaper, client_t *client);
+
+/**
+ * @brief Watch the owners of all sessions not watched yet.
+ * @details This is done once the server took over the sessions of another server. Sessions whose owner has exited are ended.
+ * @param reaper The reaper to use.
+ * @param clients The client list.
+ */
+void reaper_adopt(reaper_t *reaper, list_t *clients);
+
+/**
+ * @brief End the sessions whose owner has exited.
+ * @details At most `REAPER_BATCH` sessions are ended at once, and the function does not block.
+ * @param reaper The reaper to use.
+ * @param clients The client list.
+ */
+void reaper_collect(reaper_t *reaper, list_t *clients);
+
+#endif
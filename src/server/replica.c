@@ -0,0 +1,784 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for read-only replicas of the server.
+ * @details The shared memory object holds a header and two slots, each holding a complete copy of the secrets and sessions. The primary updates the slot not currently read, and then switches over. An update rewrites the records of the entries changed since the slot was last written in place, or appends them if their secret no longer fits, and appends the sessions if they changed, so the slot is only written from scratch once it is full. Every slot is guarded by a sequence counter, which is odd while the slot is written, so replicas repeat a read that raced with the primary. The object is mapped at its maximum size once, and grows by appending larger slots, so replicas never remap it. A copied secret also keeps the counter its bucket of the watch table had when it was copied, so a replica notices a secret that changed since, and refuses to serve it.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "replica.h"
+#include "ipc.h"
+#include "user.h"
+
+#include "../share/protocol.h"
+#include "../share/utils.h"
+#include "../share/shard.h"
+
+/**
+ * @brief Magic number identifying the shared memory object.
+ */
+#define REPLICA_MAGIC 0x61727570
+
+/**
+ * @brief Size of the mapping of the shared memory object, which is never exceeded.
+ */
+#define REPLICA_MAP_LEN ((size_t) 1 << 32)
+
+/**
+ * @brief Size reserved for the header at the start of the shared memory object.
+ */
+#define REPLICA_HEADER_LEN 4096
+
+/**
+ * @brief The number of times a read is repeated if the copy is replaced meanwhile.
+ */
+#define REPLICA_RETRIES 4
+
+/**
+ * @brief The minimum number of buckets of a copy.
+ */
+#define REPLICA_MIN_BUCKETS 16
+
+/**
+ * @brief The watch table.
+ * @details This variable is required for the use of this module.
+ */
+extern uint32_t *watch_table;
+
+/**
+ * @brief The published copy.
+ * @details This variable is required for the use of this module.
+ */
+extern replica_t *replica;
+
+/**
+ * @brief A slot holding one copy.
+ */
+typedef struct {
+	uint32_t sequence; ///< Counter incremented before and after the slot is written.
+	uint32_t reserved; ///< Unused.
+	uint64_t offset; ///< Offset of the copy in the shared memory object.
+	uint64_t capacity; ///< Number of bytes reserved for the copy.
+	uint64_t len; ///< Number of bytes of the copy.
+	uint64_t fresh; ///< Time in milliseconds at which the copy was last known to match the database.
+} replica_slot_t;
+
+/**
+ * @brief The header of the shared memory object.
+ */
+struct replica_header_s {
+	uint32_t magic; ///< Set to `REPLICA_MAGIC` once the header is initialized.
+	uint32_t current; ///< Index of the slot to read.
+	uint64_t secret_cap; ///< Maximum length of a secret.
+	uint64_t size; ///< Size of the shared memory object.
+	replica_slot_t slots[2]; ///< The slots.
+};
+
+/**
+ * @brief The start of a copy.
+ * @details The copy continues with the heads of the buckets, the records, and the sessions. Offsets are relative to the start of the copy, so `0` denotes no record.
+ */
+typedef struct {
+	uint64_t buckets; ///< Number of buckets, a power of two.
+	uint64_t entries; ///< Number of records.
+	uint64_t sessions; ///< Number of sessions.
+	uint64_t sessions_offset; ///< Offset of the sessions.
+	uint8_t key[HASH_KEY_SIZE]; ///< Key hashing usernames to buckets.
+} replica_copy_t;
+
+/**
+ * @brief A record of a copy, which is followed by the secret.
+ */
+typedef struct {
+	uint64_t next; ///< Offset of the next record of the bucket, `0` if there is none.
+	uint64_t version; ///< Version of the secret.
+	uint32_t expires; ///< Time in seconds since the epoch at which the secret expires, `0` if it does not.
+	uint32_t bucket; ///< Bucket of the watch table of the user.
+	uint32_t sequence; ///< Value of the counter of the bucket when the record was written.
+	uint32_t secret_len; ///< Length of the secret.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
+} replica_record_t;
+
+/**
+ * @brief Round `len` up to a multiple of eight bytes.
+ */
+#define REPLICA_ALIGN(len) (((len) + 7) & ~(size_t) 7)
+
+/**
+ * @brief Map the shared memory object `fd`.
+ * @param fd The shared memory object.
+ * @param primary Whether to map it writable.
+ * @return The copy, or `NULL` on failure. The copy takes ownership of `fd` on success.
+ */
+static replica_t *replica_map(int fd, bool primary)
+{
+	replica_t *replica = calloc(1, sizeof(replica_t));
+	if (replica == NULL)
+		return NULL;
+
+	int prot = primary ? PROT_READ | PROT_WRITE : PROT_READ;
+
+	// pages past the end of the object are never touched
+	replica->map = mmap(NULL, REPLICA_MAP_LEN, prot, MAP_SHARED | MAP_NORESERVE, fd, 0);
+	if (replica->map == MAP_FAILED) {
+		free(replica);
+		return NULL;
+	}
+
+	replica->fd = fd;
+	replica->header = (struct replica_header_s *) replica->map;
+	replica->primary = primary;
+
+	return replica;
+}
+
+replica_t *replica_create(size_t secret_cap)
+{
+	int fd = shm_open(shard_name(REPLICA_SHM_NAME), O_RDWR | O_CREAT, 0640);
+	if (fd == -1)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return NULL;
+	}
+
+	// the header is only set up if nobody published before
+	bool fresh = st.st_size < REPLICA_HEADER_LEN;
+	if (fresh && ftruncate(fd, REPLICA_HEADER_LEN) == -1) {
+		close(fd);
+		return NULL;
+	}
+
+	replica_t *replica = replica_map(fd, true);
+	if (replica == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	struct replica_header_s *h = replica->header;
+
+	if (hash_key_generate(replica->key) != 0 ||
+		(!fresh && (h->magic != REPLICA_MAGIC || h->secret_cap != secret_cap))) {
+		replica_destroy(replica, false);
+		return NULL;
+	}
+
+	if (fresh) {
+		h->secret_cap = secret_cap;
+		h->size = REPLICA_HEADER_LEN;
+		__atomic_store_n(&h->magic, REPLICA_MAGIC, __ATOMIC_RELEASE);
+	}
+
+	replica->secret_cap = secret_cap;
+	replica->dirty = true;
+	replica->rebuild[0] = true;
+	replica->rebuild[1] = true;
+
+	return replica;
+}
+
+replica_t *replica_open(void)
+{
+	int fd = shm_open(shard_name(REPLICA_SHM_NAME), O_RDONLY, 0);
+	if (fd == -1)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < REPLICA_HEADER_LEN) {
+		close(fd);
+		return NULL;
+	}
+
+	replica_t *replica = replica_map(fd, false);
+	if (replica == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	if (__atomic_load_n(&replica->header->magic, __ATOMIC_ACQUIRE) != REPLICA_MAGIC ||
+		replica->header->secret_cap < MAX_SECRET_LEN ||
+		replica->header->secret_cap >= UINT32_MAX) {
+		replica_destroy(replica, false);
+		return NULL;
+	}
+
+	replica->secret_cap = replica->header->secret_cap;
+
+	return replica;
+}
+
+void replica_destroy(replica_t *replica, bool unlink)
+{
+	if (replica == NULL)
+		return;
+
+	// replicas still mapping the copy stop serving it right away
+	if (unlink && replica->primary) {
+		__atomic_store_n(&replica->header->slots[0].fresh, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&replica->header->slots[1].fresh, 0, __ATOMIC_RELEASE);
+	}
+
+	munmap(replica->map, REPLICA_MAP_LEN);
+	close(replica->fd);
+
+	if (unlink)
+		shm_unlink(shard_name(REPLICA_SHM_NAME));
+
+	for (int i = 0; i < 2; i++) {
+		free(replica->records[i]);
+		free(replica->queue[i]);
+	}
+
+	free(replica->pending);
+	free(replica);
+}
+
+/**
+ * @brief Make sure the arrays tracking the entries have room for `n` entries.
+ * @param replica The copy to consider.
+ * @param n The number of entries.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool replica_track(replica_t *replica, size_t n)
+{
+	if (n <= replica->tracked)
+		return true;
+
+	size_t tracked = replica->tracked;
+	size_t capacity = tracked > 0 ? tracked : REPLICA_MIN_BUCKETS;
+	while (capacity < n)
+		capacity *= 2;
+
+	uint8_t *pending = realloc(replica->pending, capacity);
+	if (pending == NULL)
+		return false;
+
+	memset(pending + tracked, 0, capacity - tracked);
+	replica->pending = pending;
+
+	for (int i = 0; i < 2; i++) {
+		uint64_t *records = realloc(replica->records[i], capacity * sizeof(uint64_t));
+		if (records == NULL)
+			return false;
+
+		memset(records + tracked, 0, (capacity - tracked) * sizeof(uint64_t));
+		replica->records[i] = records;
+
+		size_t *queue = realloc(replica->queue[i], capacity * sizeof(size_t));
+		if (queue == NULL)
+			return false;
+
+		replica->queue[i] = queue;
+	}
+
+	replica->tracked = capacity;
+	return true;
+}
+
+void replica_touch_entry(replica_t *replica, database_t *database, entry_t *e)
+{
+	if (replica == NULL)
+		return;
+
+	replica->dirty = true;
+
+	size_t i = e - database->entries;
+
+	// the slots are written from scratch if the entry cannot be tracked
+	if (!replica_track(replica, i + 1)) {
+		replica->rebuild[0] = true;
+		replica->rebuild[1] = true;
+		return;
+	}
+
+	for (int index = 0; index < 2; index++) {
+		if (replica->pending[i] & (1 << index))
+			continue;
+
+		replica->pending[i] |= 1 << index;
+		replica->queue[index][replica->queued[index]++] = i;
+	}
+}
+
+void replica_touch_sessions(replica_t *replica)
+{
+	if (replica == NULL)
+		return;
+
+	replica->dirty = true;
+	replica->sessions_changed[0] = true;
+	replica->sessions_changed[1] = true;
+}
+
+/**
+ * @brief Make sure a slot has room for a copy.
+ * @details A slot that is too small is moved to the end of the shared memory object, with room for twice the length.
+ * @param replica The copy to consider.
+ * @param slot The slot to prepare.
+ * @param len The length of the copy.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool replica_reserve(replica_t *replica, replica_slot_t *slot, size_t len)
+{
+	struct replica_header_s *h = replica->header;
+
+	if (slot->capacity >= len)
+		return true;
+
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t capacity = (2 * len + page - 1) / page * page;
+
+	if (capacity > REPLICA_MAP_LEN - h->size)
+		return false;
+
+	if (ftruncate(replica->fd, h->size + capacity) == -1)
+		return false;
+
+	slot->offset = h->size;
+	slot->capacity = capacity;
+	__atomic_store_n(&h->size, h->size + capacity, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * @brief Write the record of an entry.
+ * @details The link to the next record of the bucket is left as is.
+ * @param r The record to write, which must have room for the secret.
+ * @param e The entry to copy.
+ */
+static void replica_write_record(replica_record_t *r, entry_t *e)
+{
+	memset(r->username, 0, sizeof(r->username));
+	memcpy(r->username, e->username, strnlen(e->username, MAX_USERNAME_LEN));
+	r->version = e->version;
+	r->expires = e->expires;
+	r->bucket = user_watch_bucket(e->username);
+	r->sequence = __atomic_load_n(&watch_table[r->bucket], __ATOMIC_ACQUIRE);
+	r->secret_len = e->secret.len;
+	memcpy((char *) r + sizeof(replica_record_t), secret_data(&e->secret), e->secret.len);
+}
+
+/**
+ * @brief Append the sessions to a copy.
+ * @param slot The slot holding the copy, which must have room for the sessions.
+ * @param base The start of the copy.
+ * @param clients The sessions to copy.
+ */
+static void replica_append_sessions(replica_slot_t *slot, char *base, list_t *clients)
+{
+	replica_copy_t *copy = (replica_copy_t *) base;
+	client_t *c = (client_t *) (base + slot->len);
+
+	for (element_t *curr = clients->head; curr != NULL; curr = curr->next)
+		memcpy(c++, curr->data, sizeof(client_t));
+
+	copy->sessions_offset = slot->len;
+	copy->sessions = list_size(clients);
+	slot->len += REPLICA_ALIGN(copy->sessions * sizeof(client_t));
+}
+
+/**
+ * @brief Write a copy of the database and the sessions from scratch.
+ * @details The slot is given room for a quarter more than the copy, which later updates append to.
+ * @param replica The copy to consider.
+ * @param database The database to copy.
+ * @param clients The sessions to copy.
+ * @param index The index of the slot.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool replica_rebuild(replica_t *replica, database_t *database, list_t *clients, int index)
+{
+	replica_slot_t *slot = &replica->header->slots[index];
+
+	if (!replica_track(replica, database->length))
+		return false;
+
+	size_t buckets = REPLICA_MIN_BUCKETS;
+	while (buckets < database->length)
+		buckets *= 2;
+
+	size_t sessions = list_size(clients);
+	size_t len = sizeof(replica_copy_t) + buckets * sizeof(uint64_t);
+
+	for (size_t i = 0; i < database->length; i++)
+		len += sizeof(replica_record_t) + REPLICA_ALIGN(database->entries[i].secret.len);
+
+	len += REPLICA_ALIGN(sessions * sizeof(client_t));
+
+	if (!replica_reserve(replica, slot, len + len / 4))
+		return false;
+
+	char *base = replica->map + slot->offset;
+	uint64_t *heads = (uint64_t *) (base + sizeof(replica_copy_t));
+	uint64_t *records = replica->records[index];
+
+	replica_copy_t *copy = (replica_copy_t *) base;
+	copy->buckets = buckets;
+	copy->entries = database->length;
+	memcpy(copy->key, replica->key, HASH_KEY_SIZE);
+
+	memset(heads, 0, buckets * sizeof(uint64_t));
+	memset(records, 0, replica->tracked * sizeof(uint64_t));
+
+	size_t at = sizeof(replica_copy_t) + buckets * sizeof(uint64_t);
+
+	for (size_t i = 0; i < database->length; i++) {
+		entry_t *e = &database->entries[i];
+		uint64_t hash = siphash(replica->key, e->username, strnlen(e->username, MAX_USERNAME_LEN)) & (buckets - 1);
+
+		replica_record_t *r = (replica_record_t *) (base + at);
+		replica_write_record(r, e);
+
+		r->next = heads[hash];
+		heads[hash] = at;
+		records[i] = at;
+		replica->pending[i] &= ~(1 << index);
+		at += sizeof(replica_record_t) + REPLICA_ALIGN(e->secret.len);
+	}
+
+	slot->len = at;
+	replica_append_sessions(slot, base, clients);
+
+	replica->queued[index] = 0;
+	replica->sessions_changed[index] = false;
+	replica->rebuild[index] = false;
+	replica->rebuilds++;
+
+	return true;
+}
+
+/**
+ * @brief Bring a copy up to date with the entries changed since it was written.
+ * @details A record whose secret takes the same room is rewritten in place. Otherwise, a new record is appended and takes the place of the old one in its bucket.
+ * @param replica The copy to consider.
+ * @param database The database to copy.
+ * @param clients The sessions to copy.
+ * @param index The index of the slot.
+ * @return `true` on success, `false` if the slot has to be written from scratch.
+ */
+static bool replica_update(replica_t *replica, database_t *database, list_t *clients, int index)
+{
+	replica_slot_t *slot = &replica->header->slots[index];
+	char *base = replica->map + slot->offset;
+	replica_copy_t *copy = (replica_copy_t *) base;
+	uint64_t *heads = (uint64_t *) (base + sizeof(replica_copy_t));
+	uint64_t *records = replica->records[index];
+
+	// long buckets slow down replicas, and many changes are copied faster from scratch
+	if (database->length > 2 * copy->buckets || replica->queued[index] > database->length / 2)
+		return false;
+
+	for (size_t q = 0; q < replica->queued[index]; q++) {
+		size_t i = replica->queue[index][q];
+		entry_t *e = &database->entries[i];
+		uint64_t old = records[i];
+		replica_record_t *r = old != 0 ? (replica_record_t *) (base + old) : NULL;
+
+		if (r != NULL && REPLICA_ALIGN(r->secret_len) == REPLICA_ALIGN(e->secret.len)) {
+			replica_write_record(r, e);
+			replica->pending[i] &= ~(1 << index);
+			continue;
+		}
+
+		size_t len = sizeof(replica_record_t) + REPLICA_ALIGN(e->secret.len);
+		if (len > slot->capacity - slot->len)
+			return false;
+
+		uint64_t hash = siphash(replica->key, e->username, strnlen(e->username, MAX_USERNAME_LEN)) & (copy->buckets - 1);
+		uint64_t *link = &heads[hash];
+
+		// the old record is unlinked by the new one
+		while (r != NULL && *link != old) {
+			if (*link == 0)
+				return false;
+
+			link = &((replica_record_t *) (base + *link))->next;
+		}
+
+		uint64_t at = slot->len;
+		replica_record_t *n = (replica_record_t *) (base + at);
+		replica_write_record(n, e);
+		n->next = r != NULL ? r->next : *link;
+		*link = at;
+
+		records[i] = at;
+		replica->pending[i] &= ~(1 << index);
+		slot->len += len;
+	}
+
+	replica->queued[index] = 0;
+	copy->entries = database->length;
+
+	if (replica->sessions_changed[index]) {
+		if (REPLICA_ALIGN(list_size(clients) * sizeof(client_t)) > slot->capacity - slot->len)
+			return false;
+
+		replica_append_sessions(slot, base, clients);
+		replica->sessions_changed[index] = false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Bring the slot not currently read up to date, and switch over to it.
+ * @param replica The copy to consider.
+ * @param database The database to copy.
+ * @param clients The sessions to copy.
+ * @param now The current time in milliseconds.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool replica_publish(replica_t *replica, database_t *database, list_t *clients, uint64_t now)
+{
+	struct replica_header_s *h = replica->header;
+	uint32_t next = (h->current + 1) & 1;
+	replica_slot_t *slot = &h->slots[next];
+
+	// readers of the slot notice that it is being written, even if a previous primary stopped halfway
+	uint32_t sequence = slot->sequence | 1;
+	__atomic_store_n(&slot->sequence, sequence, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	// an update that failed halfway is overwritten
+	bool written = !replica->rebuild[next] && replica_update(replica, database, clients, next);
+	if (!written)
+		written = replica_rebuild(replica, database, clients, next);
+
+	if (!written) {
+		replica->rebuild[next] = true;
+		__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+		return false;
+	}
+
+	__atomic_store_n(&slot->fresh, now, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+
+	// replicas read the new copy from now on
+	__atomic_store_n(&h->current, next, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+void replica_refresh(replica_t *replica, database_t *database, list_t *clients)
+{
+	uint64_t now = clock_ms();
+
+	if (!replica->dirty) {
+		struct replica_header_s *h = replica->header;
+		__atomic_store_n(&h->slots[h->current].fresh, now, __ATOMIC_RELEASE);
+		return;
+	}
+
+	if (now - replica->published_at < REPLICA_INTERVAL)
+		return;
+
+	uint64_t start = clock_us();
+
+	if (replica_publish(replica, database, clients, now)) {
+		replica->dirty = false;
+		replica->published_at = now;
+		__atomic_add_fetch(&replica->publishes, 1, __ATOMIC_RELAXED);
+	}
+
+	replica->publish_us = clock_us() - start;
+	if (replica->publish_us > replica->publish_us_max)
+		replica->publish_us_max = replica->publish_us;
+}
+
+/**
+ * @brief Look up the secret of a packet in a copy.
+ * @details The copy may be written concurrently, so every offset is checked before it is followed.
+ * @param base The start of the copy.
+ * @param len The length of the copy.
+ * @param p The packet, which receives the secret.
+ * @param message The message holding the packet.
+ * @param size The size of the buffer holding the message.
+ * @param reply Set to the length of the response.
+ * @return The status of the request.
+ */
+static enum request_status_e replica_lookup(const char *base, size_t len, struct packet_secret_read *p, char *message, size_t size, size_t *reply)
+{
+	if (len < sizeof(replica_copy_t))
+		return STALE;
+
+	const replica_copy_t *copy = (const replica_copy_t *) base;
+	uint64_t buckets = copy->buckets;
+	uint64_t sessions = copy->sessions;
+	uint64_t sessions_offset = copy->sessions_offset;
+
+	if (buckets == 0 || (buckets & (buckets - 1)) != 0 ||
+		buckets > (len - sizeof(replica_copy_t)) / sizeof(uint64_t) ||
+		sessions_offset > len || sessions > (len - sessions_offset) / sizeof(client_t))
+		return STALE;
+
+	// a session unknown to the copy may have been established since
+	const client_t *c = (const client_t *) (base + sessions_offset);
+	uint64_t i = 0;
+
+	while (i < sessions &&
+		(strncmp(c[i].session_id, p->session_id, SESSION_ID_SIZE) != 0 ||
+		strncmp(c[i].username, p->username, MAX_USERNAME_LEN) != 0))
+		i++;
+
+	if (i == sessions)
+		return STALE;
+
+	size_t username_len = strnlen(p->username, MAX_USERNAME_LEN);
+	uint64_t hash = siphash(copy->key, p->username, username_len) & (buckets - 1);
+	const uint64_t *heads = (const uint64_t *) (base + sizeof(replica_copy_t));
+	const replica_record_t *r = NULL;
+	uint64_t at = heads[hash];
+
+	for (uint64_t steps = 0; at != 0 && r == NULL && steps < copy->entries; steps++) {
+		if (at % 8 != 0 || at > len - sizeof(replica_record_t))
+			return STALE;
+
+		const replica_record_t *candidate = (const replica_record_t *) (base + at);
+
+		if (strncmp(candidate->username, p->username, MAX_USERNAME_LEN) == 0)
+			r = candidate;
+		else
+			at = candidate->next;
+	}
+
+	if (r == NULL)
+		return STALE;
+
+	uint32_t secret_len = r->secret_len;
+	if (secret_len > len - at - sizeof(replica_record_t) || r->bucket >= WATCH_BUCKETS)
+		return STALE;
+
+	// the secret changed since it was copied
+	if (__atomic_load_n(&watch_table[r->bucket], __ATOMIC_ACQUIRE) != r->sequence)
+		return STALE;
+
+	// only the server clears expired secrets
+	if (r->expires != 0 && r->expires <= time(NULL))
+		return STALE;
+
+	const char *data = base + at + sizeof(replica_record_t);
+
+	if (secret_len <= MAX_SECRET_LEN) {
+		memcpy(p->secret, data, secret_len);
+		p->secret[secret_len] = '\0';
+	} else if (secret_len < size - SHM_ARENA_OFFSET) {
+		memcpy(message + SHM_ARENA_OFFSET, data, secret_len);
+		message[SHM_ARENA_OFFSET + secret_len] = '\0';
+		p->secret_offset = SHM_ARENA_OFFSET;
+		*reply = SHM_ARENA_OFFSET + secret_len + 1;
+	} else {
+		return ERROR;
+	}
+
+	p->version = r->version;
+	p->expires = r->expires;
+	p->bucket = r->bucket;
+	p->sequence = r->sequence;
+	p->secret_len = secret_len;
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Read the secret of a packet from the copy currently published.
+ * @param replica The copy to read from.
+ * @param p The packet, which receives the secret.
+ * @param message The message holding the packet.
+ * @param size The size of the buffer holding the message.
+ * @param reply Set to the length of the response.
+ * @return `true` if the read is consistent, `false` if the copy was replaced meanwhile.
+ */
+static bool replica_read(replica_t *replica, struct packet_secret_read *p, char *message, size_t size, size_t *reply)
+{
+	struct replica_header_s *h = replica->header;
+	replica_slot_t *slot = &h->slots[__atomic_load_n(&h->current, __ATOMIC_ACQUIRE) & 1];
+
+	uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	if (sequence % 2 != 0)
+		return false;
+
+	memset(p->secret, '\0', MAX_SECRET_LEN + 1);
+	p->secret_len = 0;
+	p->secret_offset = 0;
+	*reply = SHM_LEN;
+
+	uint64_t now = clock_ms();
+	uint64_t fresh = __atomic_load_n(&slot->fresh, __ATOMIC_ACQUIRE);
+	uint64_t staleness = now > fresh ? now - fresh : 0;
+	uint64_t offset = slot->offset;
+	uint64_t len = slot->len;
+	uint64_t total = __atomic_load_n(&h->size, __ATOMIC_ACQUIRE);
+
+	p->staleness = staleness < UINT32_MAX ? staleness : UINT32_MAX;
+
+	if (staleness > REPLICA_MAX_STALENESS)
+		p->rstatus = STALE;
+	else if (offset < REPLICA_HEADER_LEN || offset > total || len > total - offset)
+		p->rstatus = STALE;
+	else
+		p->rstatus = replica_lookup(replica->map + offset, len, p, message, size, reply);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+size_t replica_handle(void *message, size_t len, size_t size)
+{
+	if (len < sizeof(struct packet_generic))
+		return 0;
+
+	// fields the client did not send are empty
+	if (len < SHM_ARENA_OFFSET)
+		memset((char *) message + len, 0, SHM_ARENA_OFFSET - len);
+
+	struct packet_secret_read *p = message;
+	p->status = ONLINE;
+
+	// everything else is served by the primary
+	if (p->type != SECRET_READ) {
+		p->rstatus = ERROR;
+		return SHM_LEN;
+	}
+
+	p->session_id[SESSION_ID_SIZE] = '\0';
+	p->username[MAX_USERNAME_LEN] = '\0';
+	p->transfer = TRANSFER_SHM;
+
+	size_t reply = SHM_LEN;
+	bool consistent = false;
+
+	for (int i = 0; i < REPLICA_RETRIES && !consistent; i++) {
+		consistent = replica_read(replica, p, message, size, &reply);
+
+		if (!consistent)
+			__atomic_add_fetch(&replica->retries, 1, __ATOMIC_RELAXED);
+	}
+
+	if (!consistent) {
+		p->rstatus = STALE;
+		reply = SHM_LEN;
+	}
+
+	if (p->rstatus == SUCCESS)
+		__atomic_add_fetch(&replica->reads, 1, __ATOMIC_RELAXED);
+	else if (p->rstatus == STALE)
+		__atomic_add_fetch(&replica->stale, 1, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&replica->staleness, p->staleness, __ATOMIC_RELAXED);
+
+	return reply;
+}
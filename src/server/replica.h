@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for read-only replicas of the server.
+ * @details The primary server publishes the secrets and sessions in the shared memory object `REPLICA_SHM_NAME`. Replica processes map it read-only and serve `SECRET_READ` packets over their own socket transport, while all other packets still go to the primary.
+ */
+
+#ifndef __REPLICA_H__
+#define __REPLICA_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "database.h"
+#include "hash.h"
+
+/**
+ * @brief The name of the shared memory object the primary publishes to.
+ */
+#define REPLICA_SHM_NAME "authme_replica"
+
+/**
+ * @brief Time in milliseconds between two publications of a changed database.
+ */
+#define REPLICA_INTERVAL 100
+
+/**
+ * @brief Time in milliseconds a published copy may lag behind the database before replicas stop serving it.
+ */
+#define REPLICA_MAX_STALENESS 1000
+
+/**
+ * @brief Forward declaration of the header of the published copy.
+ */
+struct replica_header_s;
+
+/**
+ * @brief Representation of the published copy, on either side.
+ */
+typedef struct {
+	int fd; ///< The shared memory object.
+	char *map; ///< Mapping of the object, of which the size of the object is accessible.
+	struct replica_header_s *header; ///< Header at the start of the mapping.
+	bool primary; ///< Whether this process publishes the copy.
+	size_t secret_cap; ///< Maximum length of a secret.
+	bool dirty; ///< Whether the database changed since the copy was published.
+	uint64_t published_at; ///< Time in milliseconds at which the copy was last published.
+	uint8_t key[HASH_KEY_SIZE]; ///< Key of the hash function of the buckets.
+	size_t tracked; ///< Number of entries the arrays below have room for.
+	uint8_t *pending; ///< Per entry, the slots the entry still has to be written to, one bit per slot.
+	uint64_t *records[2]; ///< Per slot and entry, the offset of the record of the entry in the copy, `0` if there is none.
+	size_t *queue[2]; ///< Per slot, the entries still to be written to it.
+	size_t queued[2]; ///< Per slot, the number of entries in `queue`.
+	bool rebuild[2]; ///< Per slot, whether the copy has to be written from scratch.
+	bool sessions_changed[2]; ///< Per slot, whether the sessions changed since the copy was written.
+	unsigned long publishes; ///< Number of copies published.
+	unsigned long rebuilds; ///< Number of copies written from scratch.
+	uint64_t publish_us; ///< Time in microseconds the last publication held the server.
+	uint64_t publish_us_max; ///< Longest time in microseconds a publication held the server.
+	unsigned long reads; ///< Number of secrets read from the copy.
+	unsigned long stale; ///< Number of reads refused because the copy was too old.
+	unsigned long retries; ///< Number of reads repeated because the copy was replaced meanwhile.
+	uint32_t staleness; ///< Age in milliseconds of the copy at the last read.
+} replica_t;
+
+/**
+ * @brief Create or take over the published copy as primary.
+ * @details An existing object is reused, so that running replicas keep their mapping across a handover.
+ * @param secret_cap The maximum length of a secret.
+ * @return The memory address of the copy, or `NULL` on failure.
+ */
+replica_t *replica_create(size_t secret_cap);
+
+/**
+ * @brief Map the copy published by the primary read-only.
+ * @return The memory address of the copy, or `NULL` if no copy is published.
+ */
+replica_t *replica_open(void);
+
+/**
+ * @brief Unmap the copy.
+ * @param replica The copy to unmap, may be `NULL`.
+ * @param unlink Whether to remove the shared memory object.
+ */
+void replica_destroy(replica_t *replica, bool unlink);
+
+/**
+ * @brief Record that the entry `e` was added or its secret changed.
+ * @param replica The copy to consider, may be `NULL`.
+ * @param database The database holding the entry.
+ * @param e The entry.
+ */
+void replica_touch_entry(replica_t *replica, database_t *database, entry_t *e);
+
+/**
+ * @brief Record that a session was established or ended.
+ * @param replica The copy to consider, may be `NULL`.
+ */
+void replica_touch_sessions(replica_t *replica);
+
+/**
+ * @brief Keep the copy up to date.
+ * @details A changed database is published at most once per `REPLICA_INTERVAL`. Otherwise, the copy is marked as current, which bounds the staleness replicas report. A publication writes the entries changed since the slot it writes was last written, and all sessions if any changed, so it holds the server for time proportional to the changes and, if sessions changed, the sessions. A slot is only written from scratch, taking time proportional to the database, once it runs out of room, which happens at most once per quarter of its size appended.
+ * @param replica The copy to consider.
+ * @param database The database to publish.
+ * @param clients The sessions to publish.
+ */
+void replica_refresh(replica_t *replica, database_t *database, list_t *clients);
+
+/**
+ * @brief Handle a message received by a replica.
+ * @details Only `SECRET_READ` packets are served. A copy older than `REPLICA_MAX_STALENESS`, or holding an expired secret, is refused with `STALE`, so that the client asks the primary. This function makes use of the global variable `replica`.
+ * @param message The message, which is replaced by the response.
+ * @param len The length of the message.
+ * @param size The size of the buffer holding the message.
+ * @return The length of the response, or `0` if the message is invalid.
+ */
+size_t replica_handle(void *message, size_t len, size_t size);
+
+#endif
@@ -0,0 +1,336 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for server statistics.
+ * @details Statistics are printed on request, e.g. when the server receives `SIGUSR1`.
+ */
+
+#include <unistd.h>
+
+#include "stats.h"
+#include "ipc.h"
+#include "list.h"
+#include "bloom.h"
+#include "database.h"
+#include "index.h"
+#include "transport.h"
+#include "replica.h"
+#include "journal.h"
+#include "lane.h"
+#include "ratelimit.h"
+#include "reaper.h"
+#include "placement.h"
+
+/**
+ * @brief The client list.
+ * @details This variable is required for the use of this module.
+ */
+extern list_t *clients;
+
+/**
+ * @brief The database.
+ * @details This variable is required for the use of this module.
+ */
+extern database_t *database;
+
+/**
+ * @brief The username filter.
+ * @details This variable is required for the use of this module.
+ */
+extern bloom_t *usernames;
+
+/**
+ * @brief The username index.
+ * @details This variable is required for the use of this module.
+ */
+extern index_t *user_index;
+
+/**
+ * @brief The socket transport.
+ * @details This variable is required for the use of this module. It is `NULL` if the transport is disabled.
+ */
+extern transport_t *transport;
+
+/**
+ * @brief The copy of the database published for read-only replicas.
+ * @details This variable is required for the use of this module. It is `NULL` if nothing is published.
+ */
+extern replica_t *replica;
+
+/**
+ * @brief The journal shipped to a standby server.
+ * @details This variable is required for the use of this module. It is `NULL` if no journal is kept.
+ */
+extern journal_t *journal;
+
+/**
+ * @brief The lanes clients queue in.
+ * @details This variable is required for the use of this module. It is `NULL` for a replica.
+ */
+extern lanes_t *lanes;
+
+/**
+ * @brief The rate limiter of logins per username.
+ * @details This variable is required for the use of this module.
+ */
+extern ratelimit_t *user_limits;
+
+/**
+ * @brief The rate limiter of logins per client.
+ * @details This variable is required for the use of this module.
+ */
+extern ratelimit_t *client_limits;
+
+/**
+ * @brief The rate limiter of logins over the shared memory as a whole.
+ * @details This variable is required for the use of this module.
+ */
+extern ratelimit_t *shared_limits;
+
+/**
+ * @brief The reaper of sessions whose client exited.
+ * @details This variable is required for the use of this module.
+ */
+extern reaper_t *reaper;
+
+/**
+ * @brief Retrieve the resident set size of the process.
+ * @return The resident set size in bytes, or `0` if it is unknown.
+ */
+static size_t resident_size(void)
+{
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp == NULL)
+		return 0;
+
+	unsigned long pages_total, pages_resident;
+	int n = fscanf(fp, "%lu %lu", &pages_total, &pages_resident);
+	fclose(fp);
+
+	if (n != 2)
+		return 0;
+
+	return pages_resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief Print the memory statistics of the database.
+ * @param fp The stream to print to.
+ */
+static void print_memory_stats(FILE *fp)
+{
+	size_t bytes = database_memory(database);
+
+	// count what the records occupy, ignoring spare capacity
+	size_t per_user = 0;
+	if (database->length > 0)
+		per_user = (database->length * sizeof(entry_t) +
+			database->strings->used + database->blob_bytes +
+			database->memfd_bytes) / database->length;
+
+	fprintf(fp, "database_bytes: %zu\n", bytes);
+	fprintf(fp, "database_bytes_per_user: %zu\n", per_user);
+	fprintf(fp, "database_string_bytes: %zu\n", database->strings->used);
+	fprintf(fp, "database_blob_bytes: %zu\n", database->blob_bytes);
+	fprintf(fp, "database_memfd_bytes: %zu\n", database->memfd_bytes);
+	fprintf(fp, "secrets_expiring: %zu\n", database->expiring);
+	fprintf(fp, "secrets_expired: %lu\n", database->expired);
+	fprintf(fp, "process_resident_bytes: %zu\n", resident_size());
+
+	placement_stats_t placement;
+	placement_get_stats(&placement);
+	fprintf(fp, "memory_huge_bytes: %zu\n", placement.huge_bytes);
+	fprintf(fp, "memory_locked: %d\n", placement.locked);
+}
+
+/**
+ * @brief Print the statistics of the username filter.
+ * @param fp The stream to print to.
+ */
+static void print_filter_stats(FILE *fp)
+{
+	if (usernames == NULL)
+		return;
+
+	unsigned long misses = usernames->rejections + usernames->false_positives;
+	double observed = 0;
+	if (misses > 0)
+		observed = (double) usernames->false_positives / misses;
+
+	fprintf(fp, "filter_capacity: %zu\n", usernames->capacity);
+	fprintf(fp, "filter_items: %zu\n", usernames->count);
+	fprintf(fp, "filter_lookups: %lu\n", usernames->lookups);
+	fprintf(fp, "filter_rejections: %lu\n", usernames->rejections);
+	fprintf(fp, "filter_false_positives: %lu\n", usernames->false_positives);
+	fprintf(fp, "filter_fp_rate_estimated: %f\n", bloom_fp_rate(usernames));
+	fprintf(fp, "filter_fp_rate_observed: %f\n", observed);
+}
+
+/**
+ * @brief Print the statistics of the username index.
+ * @param fp The stream to print to.
+ */
+static void print_index_stats(FILE *fp)
+{
+	if (user_index == NULL)
+		return;
+
+	fprintf(fp, "index_capacity: %zu\n", user_index->capacity);
+	fprintf(fp, "index_items: %zu\n", user_index->count);
+	fprintf(fp, "index_group_size: %d\n", INDEX_GROUP_SIZE);
+	fprintf(fp, "index_lookups: %lu\n", user_index->lookups);
+	fprintf(fp, "index_groups_probed: %lu\n", user_index->groups_probed);
+	fprintf(fp, "index_false_matches: %lu\n", user_index->false_matches);
+}
+
+/**
+ * @brief Print the statistics of the socket transport.
+ * @param fp The stream to print to.
+ */
+static void print_transport_stats(FILE *fp)
+{
+	if (transport == NULL)
+		return;
+
+	fprintf(fp, "transport_connections: %zu\n", __atomic_load_n(&transport->connection_count, __ATOMIC_RELAXED));
+	fprintf(fp, "transport_accepted: %lu\n", __atomic_load_n(&transport->accepted, __ATOMIC_RELAXED));
+	fprintf(fp, "transport_requests: %lu\n", __atomic_load_n(&transport->requests, __ATOMIC_RELAXED));
+	fprintf(fp, "transport_ring: %d\n", transport->uring);
+
+	if (transport->ring != NULL)
+		fprintf(fp, "transport_ring_enters: %lu\n", __atomic_load_n(&transport->ring->enters, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Print the statistics of the copy published for read-only replicas.
+ * @details The server prints what it published, how often it wrote a copy from scratch, and how long publishing held it, a replica what it served.
+ * @param fp The stream to print to.
+ */
+static void print_replica_stats(FILE *fp)
+{
+	if (replica == NULL)
+		return;
+
+	if (replica->primary) {
+		fprintf(fp, "replica_publishes: %lu\n", replica->publishes);
+		fprintf(fp, "replica_rebuilds: %lu\n", replica->rebuilds);
+		fprintf(fp, "replica_publish_us: %lu\n", (unsigned long) replica->publish_us);
+		fprintf(fp, "replica_publish_us_max: %lu\n", (unsigned long) replica->publish_us_max);
+		return;
+	}
+
+	fprintf(fp, "replica_reads: %lu\n", __atomic_load_n(&replica->reads, __ATOMIC_RELAXED));
+	fprintf(fp, "replica_stale: %lu\n", __atomic_load_n(&replica->stale, __ATOMIC_RELAXED));
+	fprintf(fp, "replica_retries: %lu\n", __atomic_load_n(&replica->retries, __ATOMIC_RELAXED));
+	fprintf(fp, "replica_staleness_ms: %u\n", __atomic_load_n(&replica->staleness, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Print the statistics of the journal.
+ * @details The server prints what it sent to its standby, a standby what it applied and how far it lags behind.
+ * @param fp The stream to print to.
+ */
+static void print_journal_stats(FILE *fp)
+{
+	if (journal == NULL)
+		return;
+
+	fprintf(fp, "journal_records: %lu\n", journal->records);
+	fprintf(fp, "journal_bytes: %lu\n", journal->bytes);
+	fprintf(fp, "journal_syncs: %lu\n", journal->syncs);
+
+	if (!journal->standby) {
+		fprintf(fp, "journal_standby: %d\n", journal->fd != -1);
+		fprintf(fp, "journal_pending_bytes: %zu\n", journal->len - journal->sent);
+		fprintf(fp, "journal_drops: %lu\n", journal->drops);
+		return;
+	}
+
+	fprintf(fp, "journal_sequence: %llu\n", (unsigned long long) journal->sequence);
+	fprintf(fp, "journal_lag_ms: %llu\n", (unsigned long long) journal_lag(journal));
+}
+
+/**
+ * @brief Print the statistics of the lanes.
+ * @param fp The stream to print to.
+ */
+static void print_lane_stats(FILE *fp)
+{
+	if (lanes == NULL)
+		return;
+
+	fprintf(fp, "lane_weight: %u\n", lanes->weight);
+	fprintf(fp, "lane_depth: %u\n", lanes->depth);
+	fprintf(fp, "lane_interactive_requests: %lu\n", lanes->requests[LANE_INTERACTIVE]);
+	fprintf(fp, "lane_interactive_queued: %u\n", lanes_queued(lanes, LANE_INTERACTIVE));
+	fprintf(fp, "lane_interactive_queued_max: %u\n", lanes->peak[LANE_INTERACTIVE]);
+	fprintf(fp, "lane_bulk_requests: %lu\n", lanes->requests[LANE_BULK]);
+	fprintf(fp, "lane_bulk_queued: %u\n", lanes_queued(lanes, LANE_BULK));
+	fprintf(fp, "lane_bulk_queued_max: %u\n", lanes->peak[LANE_BULK]);
+	fprintf(fp, "lane_bulk_deferred: %lu\n", lanes->deferred);
+	fprintf(fp, "lane_revoked: %lu\n", lanes->revoked);
+}
+
+/**
+ * @brief Print the statistics of the requests whose deadline passed.
+ * @param fp The stream to print to.
+ */
+static void print_deadline_stats(FILE *fp)
+{
+	if (database == NULL)
+		return;
+
+	ipc_stats_t stats;
+	ipc_get_stats(&stats);
+
+	fprintf(fp, "requests_dropped: %lu\n", stats.dropped);
+	fprintf(fp, "requests_late: %lu\n", stats.late);
+}
+
+/**
+ * @brief Print the statistics of a rate limiter of logins.
+ * @param fp The stream to print to.
+ * @param name The name of the rate limiter.
+ * @param limiter The rate limiter, may be `NULL`.
+ */
+static void print_limiter_stats(FILE *fp, const char *name, ratelimit_t *limiter)
+{
+	if (limiter == NULL)
+		return;
+
+	fprintf(fp, "%s_rate: %u\n", name, limiter->rate);
+	fprintf(fp, "%s_buckets: %zu\n", name, limiter->count);
+	fprintf(fp, "%s_limited: %lu\n", name, limiter->limited);
+	fprintf(fp, "%s_evictions: %lu\n", name, limiter->evictions);
+}
+
+void print_stats(FILE *fp)
+{
+	if (database != NULL) {
+		fprintf(fp, "users: %zu\n", database->length);
+		print_memory_stats(fp);
+	}
+
+	if (clients != NULL)
+		fprintf(fp, "sessions: %d\n", list_size(clients));
+
+	if (reaper != NULL) {
+		fprintf(fp, "sessions_watched: %zu\n", reaper->watched);
+		fprintf(fp, "sessions_unwatched: %lu\n", reaper->unwatched);
+		fprintf(fp, "sessions_reaped: %lu\n", reaper->reaped);
+	}
+
+	print_filter_stats(fp);
+	print_index_stats(fp);
+	print_lane_stats(fp);
+	print_deadline_stats(fp);
+	print_limiter_stats(fp, "ratelimit_user", user_limits);
+	print_limiter_stats(fp, "ratelimit_client", client_limits);
+	print_limiter_stats(fp, "ratelimit_shared", shared_limits);
+	print_transport_stats(fp);
+	print_replica_stats(fp);
+	print_journal_stats(fp);
+
+	fflush(fp);
+}
@@ -0,0 +1,21 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for server statistics.
+ * @details Statistics are printed on request, e.g. when the server receives `SIGUSR1`.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+
+/**
+ * @brief Print the current server statistics.
+ * @details Each line holds one statistic as name and value, separated by a colon.
+ * @param fp The stream to print to.
+ */
+void print_stats(FILE *fp);
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for session resumption tokens.
+ * @details A token consists of the expiry time, the token generation of the user and a SipHash signature over both and the username, all hex encoded.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "token.h"
+#include "hash.h"
+
+/**
+ * @brief The number of hex digits encoding the expiry time.
+ */
+#define TOKEN_EXPIRY_DIGITS 16
+
+/**
+ * @brief The key used to sign resumption tokens.
+ */
+static uint8_t token_key[HASH_KEY_SIZE];
+
+/**
+ * @brief Compute the signature of a token.
+ * @param username The username the token is issued for.
+ * @param expiry The expiry time of the token.
+ * @param generation The token generation of the user.
+ * @return The signature.
+ */
+static uint64_t token_sign(char *username, uint64_t expiry, uint32_t generation)
+{
+	uint8_t msg[MAX_USERNAME_LEN + 1 + 8 + 4];
+	size_t len = strnlen(username, MAX_USERNAME_LEN);
+
+	memcpy(msg, username, len);
+	msg[len++] = '\0';
+
+	for (int i = 0; i < 8; i++)
+		msg[len++] = (uint8_t) (expiry >> (8 * i));
+
+	for (int i = 0; i < 4; i++)
+		msg[len++] = (uint8_t) (generation >> (8 * i));
+
+	return siphash(token_key, msg, len);
+}
+
+int token_init(void)
+{
+	return hash_key_generate(token_key);
+}
+
+void token_export(uint8_t key[HASH_KEY_SIZE])
+{
+	memcpy(key, token_key, HASH_KEY_SIZE);
+}
+
+void token_import(const uint8_t key[HASH_KEY_SIZE])
+{
+	memcpy(token_key, key, HASH_KEY_SIZE);
+}
+
+void token_issue(char *username, uint32_t generation, char token[TOKEN_SIZE + 1])
+{
+	uint64_t expiry = (uint64_t) time(NULL) + TOKEN_LIFETIME;
+	uint64_t mac = token_sign(username, expiry, generation);
+
+	snprintf(token, TOKEN_SIZE + 1, "%016llx%08lx%016llx",
+		(unsigned long long) expiry,
+		(unsigned long) generation,
+		(unsigned long long) mac);
+}
+
+bool token_verify(char *username, uint32_t generation, char *token)
+{
+	char field[TOKEN_EXPIRY_DIGITS + 1];
+	char expected[TOKEN_SIZE + 1];
+	char *end;
+
+	if (strnlen(token, TOKEN_SIZE + 1) != TOKEN_SIZE)
+		return false;
+
+	memcpy(field, token, TOKEN_EXPIRY_DIGITS);
+	field[TOKEN_EXPIRY_DIGITS] = '\0';
+	uint64_t expiry = strtoull(field, &end, 16);
+	if (*end != '\0')
+		return false;
+
+	if (expiry < (uint64_t) time(NULL))
+		return false;
+
+	uint64_t mac = token_sign(username, expiry, generation);
+	snprintf(expected, sizeof(expected), "%016llx%08lx%016llx",
+		(unsigned long long) expiry,
+		(unsigned long) generation,
+		(unsigned long long) mac);
+
+	// compare without an early exit, so the timing does not leak the signature
+	unsigned char diff = 0;
+	for (int i = 0; i < TOKEN_SIZE; i++)
+		diff |= (unsigned char) (expected[i] ^ token[i]);
+
+	return diff == 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for session resumption tokens.
+ * @details A token is issued on login and allows a client to resume a session without sending the password again.
+ */
+
+#ifndef __TOKEN_H__
+#define __TOKEN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hash.h"
+
+#include "../share/protocol.h"
+
+/**
+ * @brief The number of seconds a resumption token stays valid.
+ */
+#define TOKEN_LIFETIME 3600
+
+/**
+ * @brief Initialize the key used to sign resumption tokens.
+ * @details A fresh key is generated on every server start, so tokens do not survive a restart, unless the key is handed over to the new server.
+ * @return `0` on success, `-1` on failure.
+ */
+int token_init(void);
+
+/**
+ * @brief Copy the key used to sign resumption tokens.
+ * @param key The buffer to copy the key to.
+ */
+void token_export(uint8_t key[HASH_KEY_SIZE]);
+
+/**
+ * @brief Replace the key used to sign resumption tokens.
+ * @details Tokens signed with `key` are accepted afterwards.
+ * @param key The new key.
+ */
+void token_import(const uint8_t key[HASH_KEY_SIZE]);
+
+/**
+ * @brief Issue a resumption token for the user `username`.
+ * @param username The username to issue the token for.
+ * @param generation The current token generation of the user.
+ * @param token The buffer to write the token to.
+ */
+void token_issue(char *username, uint32_t generation, char token[TOKEN_SIZE + 1]);
+
+/**
+ * @brief Verify the resumption token `token` for the user `username`.
+ * @details The signature is compared in constant time.
+ * @param username The username to verify the token for.
+ * @param generation The current token generation of the user.
+ * @param token The token to verify.
+ * @return `true` if the token is valid, `false` otherwise.
+ */
+bool token_verify(char *username, uint32_t generation, char *token);
+
+#endif
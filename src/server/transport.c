@@ -0,0 +1,818 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for the socket transport.
+ * @details Besides the shared memory, the server can serve requests over a `SOCK_SEQPACKET` Unix domain socket. Each message holds a packet of `protocol.h`, optionally followed by the data arena. A dedicated thread multiplexes all connections with `epoll`, serving at most one message per ready connection and wakeup, so busy clients cannot starve others. Alternatively, the connections are driven by a submission ring, where each connection has one receive or send in flight and all of them are submitted with one system call per wakeup. The thread can be paused, which leaves every connection between two messages, so the connections can be handed over to another process.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "transport.h"
+#include "ipc.h"
+
+#include "../share/fdpass.h"
+
+/**
+ * @brief Kinds of requests of the submission ring.
+ * @details The kind is stored in the low bits of the request data, the rest holds the connection.
+ */
+enum ring_tag_e {
+	TAG_RECV, ///< Receive a message over a connection.
+	TAG_SEND, ///< Send a response over a connection.
+	TAG_LISTEN, ///< Wait for new connections.
+	TAG_STOP, ///< Wait for the signal to stop.
+	TAG_BUFFERS, ///< Hand message buffers to the kernel.
+	TAG_CANCEL ///< Cancel a receive.
+};
+
+/**
+ * @brief Mask of the request data holding the kind of request.
+ */
+#define TAG_MASK 7
+
+static void connection_close(transport_t *transport, connection_t *conn);
+
+/**
+ * @brief Queue a request for the submission ring.
+ * @param transport The transport to consider.
+ * @param opcode The operation to perform.
+ * @param fd The file descriptor to operate on.
+ * @param conn The connection the request belongs to, or `NULL`.
+ * @param tag The kind of request.
+ * @return The submission entry, or `NULL` on failure.
+ */
+static struct io_uring_sqe *ring_prepare(transport_t *transport, uint8_t opcode, int fd, connection_t *conn, enum ring_tag_e tag)
+{
+	struct io_uring_sqe *sqe = uring_sqe(transport->ring);
+	if (sqe == NULL)
+		return NULL;
+
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = (uintptr_t) conn | tag;
+
+	return sqe;
+}
+
+/**
+ * @brief Wait for input on the file descriptor `fd` over the submission ring.
+ * @param transport The transport to consider.
+ * @param fd The file descriptor to watch for input.
+ * @param tag The kind of request.
+ * @return `0` on success, `-1` on failure.
+ */
+static int ring_poll(transport_t *transport, int fd, enum ring_tag_e tag)
+{
+	struct io_uring_sqe *sqe = ring_prepare(transport, IORING_OP_POLL_ADD, fd, NULL, tag);
+	if (sqe == NULL)
+		return -1;
+
+	sqe->poll32_events = POLLIN;
+	return 0;
+}
+
+/**
+ * @brief Receive the next message of the connection `conn` over the submission ring.
+ * @details The kernel picks a free message buffer once the message arrives.
+ * @param transport The transport to consider.
+ * @param conn The connection to receive from.
+ * @return `0` on success, `-1` on failure.
+ */
+static int ring_receive(transport_t *transport, connection_t *conn)
+{
+	struct io_uring_sqe *sqe = ring_prepare(transport, IORING_OP_RECV, conn->fd, conn, TAG_RECV);
+	if (sqe == NULL)
+		return -1;
+
+	sqe->len = transport->size;
+	sqe->msg_flags = MSG_TRUNC;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+
+	transport->inflight += 1;
+	return 0;
+}
+
+/**
+ * @brief Hand the message buffers `first` to `first + count - 1` to the kernel.
+ * @param transport The transport to consider.
+ * @param first The first buffer.
+ * @param count The number of buffers.
+ * @return `0` on success, `-1` on failure.
+ */
+static int ring_provide(transport_t *transport, int first, int count)
+{
+	struct io_uring_sqe *sqe = ring_prepare(transport, IORING_OP_PROVIDE_BUFFERS, count, NULL, TAG_BUFFERS);
+	if (sqe == NULL)
+		return -1;
+
+	sqe->addr = (uintptr_t) (transport->buffer + first * transport->size);
+	sqe->len = transport->size;
+	sqe->off = first;
+	sqe->buf_group = 0;
+	return 0;
+}
+
+/**
+ * @brief Clear the message buffer held by the connection `conn` and hand it back to the kernel.
+ * @details All connections that found no free buffer receive again. Requests are issued in the order they were submitted, and handing over buffers completes immediately, so the buffer is available to them.
+ * @param transport The transport to consider.
+ * @param conn The connection holding the buffer.
+ */
+static void ring_release(transport_t *transport, connection_t *conn)
+{
+	// make sure the next message cannot read other secrets
+	memset(transport->buffer + conn->buffer * transport->size, 0, conn->used);
+	ring_provide(transport, conn->buffer, 1);
+	conn->buffer = -1;
+
+	while (transport->starved != NULL) {
+		connection_t *starved = transport->starved;
+		transport->starved = starved->starved;
+		starved->starved = NULL;
+
+		if (ring_receive(transport, starved) != 0)
+			connection_close(transport, starved);
+	}
+}
+
+/**
+ * @brief Start waiting for new connections.
+ * @param transport The transport to consider.
+ * @return `0` on success, `-1` on failure.
+ */
+static int transport_listen(transport_t *transport)
+{
+	struct epoll_event event;
+
+	if (transport->ring != NULL)
+		return ring_poll(transport, transport->listen_fd, TAG_LISTEN);
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+
+	return epoll_ctl(transport->epoll_fd, EPOLL_CTL_ADD, transport->listen_fd, &event);
+}
+
+/**
+ * @brief Start waiting for messages of the connection `conn`.
+ * @param transport The transport to consider.
+ * @param conn The connection to consider.
+ * @return `0` on success, `-1` on failure.
+ */
+static int connection_watch(transport_t *transport, connection_t *conn)
+{
+	struct epoll_event event;
+
+	if (transport->ring != NULL)
+		return ring_receive(transport, conn);
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = conn;
+
+	return epoll_ctl(transport->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event);
+}
+
+/**
+ * @brief Bind the session `session_id` of the user `username` to the connection.
+ * @details A session previously established over the connection is ended.
+ * @param conn The connection to modify.
+ * @param username The username of the session.
+ * @param session_id The session id.
+ */
+static void connection_bind(connection_t *conn, char *username, char *session_id)
+{
+	if (conn->session_id[0] != '\0' && strcmp(conn->session_id, session_id) != 0)
+		end_session(conn->username, conn->session_id);
+
+	strncpy(conn->username, username, MAX_USERNAME_LEN);
+	conn->username[MAX_USERNAME_LEN] = '\0';
+	strncpy(conn->session_id, session_id, SESSION_ID_SIZE);
+	conn->session_id[SESSION_ID_SIZE] = '\0';
+}
+
+/**
+ * @brief Add the connection `conn` to the open connections.
+ * @param transport The transport to consider.
+ * @param conn The connection to add.
+ */
+static void connection_link(transport_t *transport, connection_t *conn)
+{
+	conn->next = transport->connections;
+	if (conn->next != NULL)
+		conn->next->prev = conn;
+	transport->connections = conn;
+
+	__atomic_add_fetch(&transport->connection_count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Close the connection `conn`.
+ * @details A session established over the connection is ended, since no other client knows about it. The connection must not have requests in flight.
+ * @param transport The transport the connection belongs to.
+ * @param conn The connection to close.
+ */
+static void connection_close(transport_t *transport, connection_t *conn)
+{
+	if (conn->session_id[0] != '\0')
+		end_session(conn->username, conn->session_id);
+
+	if (conn->buffer >= 0)
+		ring_release(transport, conn);
+
+	close(conn->fd);
+
+	if (conn->prev != NULL)
+		conn->prev->next = conn->next;
+	else
+		transport->connections = conn->next;
+
+	if (conn->next != NULL)
+		conn->next->prev = conn->prev;
+
+	free(conn);
+	__atomic_sub_fetch(&transport->connection_count, 1, __ATOMIC_RELAXED);
+
+	// there is room again for connections which had to wait
+	if (!transport->listening && transport_listen(transport) == 0)
+		transport->listening = true;
+}
+
+/**
+ * @brief Accept the pending connections.
+ * @details Once `TRANSPORT_MAX_CONNECTIONS` connections are open, further connections wait in the backlog of the listening socket.
+ * @param transport The transport to consider.
+ */
+static void transport_accept(transport_t *transport)
+{
+	// the kernel waits for input on blocking sockets itself when driven by the ring
+	int flags = SOCK_CLOEXEC;
+	if (transport->ring == NULL)
+		flags |= SOCK_NONBLOCK;
+
+	for (int i = 0; i < TRANSPORT_EVENTS; i++) {
+		if (transport->connection_count >= TRANSPORT_MAX_CONNECTIONS) {
+			if (transport->ring == NULL)
+				epoll_ctl(transport->epoll_fd, EPOLL_CTL_DEL, transport->listen_fd, NULL);
+
+			transport->listening = false;
+			return;
+		}
+
+		int fd = accept4(transport->listen_fd, NULL, NULL, flags);
+		if (fd == -1)
+			break;
+
+		struct ucred cred;
+		socklen_t len = sizeof(cred);
+		connection_t *conn = calloc(1, sizeof(connection_t));
+
+		if (conn == NULL || getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+			free(conn);
+			close(fd);
+			continue;
+		}
+
+		// responses carrying the data arena are sent as one message
+		int sndbuf = transport->size;
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+		conn->fd = fd;
+		conn->pid = cred.pid;
+		conn->uid = cred.uid;
+		conn->gid = cred.gid;
+		conn->buffer = -1;
+
+		if (connection_watch(transport, conn) == -1) {
+			free(conn);
+			close(fd);
+			continue;
+		}
+
+		connection_link(transport, conn);
+		__atomic_add_fetch(&transport->accepted, 1, __ATOMIC_RELAXED);
+	}
+
+	// requests of the ring fire only once
+	if (transport->ring != NULL && transport_listen(transport) != 0)
+		transport->listening = false;
+}
+
+/**
+ * @brief Handle the message `buffer` received over the connection `conn`.
+ * @details The response is written to the same buffer.
+ * @param transport The transport the connection belongs to.
+ * @param conn The connection the message was received over.
+ * @param buffer The message.
+ * @param len The length of the message.
+ * @return The length of the response, or `0` if the message is invalid.
+ */
+static size_t connection_handle(transport_t *transport, connection_t *conn, char *buffer, size_t len)
+{
+	union packet_u *p = (union packet_u *) buffer;
+
+	// the peer credentials identify the client, not the process id it claims
+	if (len >= sizeof(struct packet_login) && p->generic.type == LOGIN)
+		p->login.pid = conn->pid;
+
+	size_t reply = transport->handler(buffer, len, transport->size);
+	if (reply == 0)
+		return 0;
+
+	// keep track of the session to end it once the client disconnects
+	if (p->generic.rstatus == SUCCESS) {
+		switch (p->generic.type) {
+		case LOGIN:
+			connection_bind(conn, p->login.username, p->login.session_id);
+			break;
+		case RESUME:
+			connection_bind(conn, p->resume.username, p->resume.session_id);
+			break;
+		case LOGOUT:
+			if (strcmp(conn->session_id, p->logout.session_id) == 0)
+				conn->session_id[0] = '\0';
+			break;
+		default:
+			break;
+		}
+	}
+
+	conn->requests += 1;
+	__atomic_add_fetch(&transport->requests, 1, __ATOMIC_RELAXED);
+
+	return reply;
+}
+
+/**
+ * @brief Serve one message received over the connection `conn`.
+ * @details The connection is closed if the peer hung up, the message is invalid, or the response cannot be sent without blocking.
+ * @param transport The transport the connection belongs to.
+ * @param conn The connection to serve.
+ */
+static void connection_serve(transport_t *transport, connection_t *conn)
+{
+	char *buffer = transport->buffer;
+
+	ssize_t len = recv(conn->fd, buffer, transport->size, MSG_TRUNC);
+	if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return;
+
+	if (len <= 0 || (size_t) len > transport->size) {
+		connection_close(transport, conn);
+		return;
+	}
+
+	size_t reply = connection_handle(transport, conn, buffer, len);
+	ssize_t sent = -1;
+
+	if (reply > 0)
+		sent = send(conn->fd, buffer, reply, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+	// make sure the next message cannot read other secrets
+	memset(buffer, 0, (size_t) len > reply ? (size_t) len : reply);
+
+	if (reply == 0 || sent != (ssize_t) reply)
+		connection_close(transport, conn);
+}
+
+/**
+ * @brief Handle a message received over the submission ring.
+ * @details The response is sent from the message buffer, which the connection holds until the response is sent. If no buffer was free, the connection receives again once a buffer is released.
+ * @param transport The transport the connection belongs to.
+ * @param conn The connection the message was received over.
+ * @param res The result of the receive.
+ * @param flags The flags of the completion.
+ */
+static void ring_received(transport_t *transport, connection_t *conn, int res, unsigned flags)
+{
+	// a draining connection receives again once the thread is resumed
+	if (res == -ECANCELED || (res == -ENOBUFS && transport->draining))
+		return;
+
+	if (res == -ENOBUFS) {
+		conn->starved = transport->starved;
+		transport->starved = conn;
+		return;
+	}
+
+	if (flags & IORING_CQE_F_BUFFER) {
+		conn->buffer = flags >> IORING_CQE_BUFFER_SHIFT;
+		conn->used = (size_t) res < transport->size ? (size_t) res : transport->size;
+	}
+
+	if (res <= 0 || (size_t) res > transport->size || conn->buffer < 0) {
+		connection_close(transport, conn);
+		return;
+	}
+
+	char *buffer = transport->buffer + conn->buffer * transport->size;
+	conn->reply = connection_handle(transport, conn, buffer, res);
+
+	if (conn->reply == 0) {
+		connection_close(transport, conn);
+		return;
+	}
+
+	if (conn->reply > conn->used)
+		conn->used = conn->reply;
+
+	struct io_uring_sqe *sqe = ring_prepare(transport, IORING_OP_SEND, conn->fd, conn, TAG_SEND);
+	if (sqe == NULL) {
+		connection_close(transport, conn);
+		return;
+	}
+
+	sqe->addr = (uintptr_t) buffer;
+	sqe->len = conn->reply;
+	sqe->msg_flags = MSG_NOSIGNAL;
+
+	transport->inflight += 1;
+}
+
+/**
+ * @brief Handle a response sent over the submission ring.
+ * @details The message buffer is released, and the connection receives its next message unless the ring is draining.
+ * @param transport The transport the connection belongs to.
+ * @param conn The connection the response was sent over.
+ * @param res The result of the send.
+ */
+static void ring_sent(transport_t *transport, connection_t *conn, int res)
+{
+	ring_release(transport, conn);
+
+	if (res != (int) conn->reply || (!transport->draining && ring_receive(transport, conn) != 0))
+		connection_close(transport, conn);
+}
+
+/**
+ * @brief Stop receiving over the submission ring.
+ * @details Pending receives are cancelled, and no connection receives again. Messages that arrived before the cancellation are still served.
+ * @param transport The transport to consider.
+ */
+static void ring_drain(transport_t *transport)
+{
+	transport->draining = true;
+
+	while (transport->starved != NULL) {
+		connection_t *starved = transport->starved;
+		transport->starved = starved->starved;
+		starved->starved = NULL;
+	}
+
+	// connections sending a response have no receive to cancel
+	for (connection_t *conn = transport->connections; conn != NULL; conn = conn->next) {
+		struct io_uring_sqe *sqe = ring_prepare(transport, IORING_OP_ASYNC_CANCEL, -1, NULL, TAG_CANCEL);
+		if (sqe != NULL)
+			sqe->addr = (uintptr_t) conn | TAG_RECV;
+	}
+}
+
+/**
+ * @brief The main loop of the serving thread when using the submission ring.
+ * @param transport The transport to serve.
+ */
+static void transport_run_ring(transport_t *transport)
+{
+	uring_t *ring = transport->ring;
+
+	transport->inflight = 0;
+	transport->draining = false;
+
+	if (ring_provide(transport, 0, TRANSPORT_BUFFERS) != 0 ||
+		ring_poll(transport, transport->stop_fd, TAG_STOP) != 0 ||
+		(transport->listening && transport_listen(transport) != 0))
+		return;
+
+	// the connections were adopted or the thread was paused
+	connection_t *conn = transport->connections;
+	while (conn != NULL) {
+		connection_t *next = conn->next;
+		if (ring_receive(transport, conn) != 0)
+			connection_close(transport, conn);
+		conn = next;
+	}
+
+	// submit the requests queued while handling completions, and wait for the next ones
+	while (!transport->draining || transport->inflight > 0) {
+		if (uring_enter(ring, 1) != 0 && errno != EINTR)
+			return;
+
+		struct io_uring_cqe *cqe;
+
+		while ((cqe = uring_cqe(ring)) != NULL) {
+			uint64_t data = cqe->user_data;
+			int res = cqe->res;
+			unsigned flags = cqe->flags;
+			uring_cqe_seen(ring);
+
+			connection_t *conn = (connection_t *) (uintptr_t) (data & ~(uint64_t) TAG_MASK);
+
+			switch (data & TAG_MASK) {
+			case TAG_RECV:
+				transport->inflight -= 1;
+				ring_received(transport, conn, res, flags);
+				break;
+			case TAG_SEND:
+				transport->inflight -= 1;
+				ring_sent(transport, conn, res);
+				break;
+			case TAG_LISTEN:
+				if (!transport->draining)
+					transport_accept(transport);
+				break;
+			case TAG_STOP:
+				if (!transport->pausing)
+					return;
+
+				ring_drain(transport);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief The main loop of the serving thread when using `epoll`.
+ * @param transport The transport to serve.
+ */
+static void transport_run_epoll(transport_t *transport)
+{
+	struct epoll_event events[TRANSPORT_EVENTS];
+
+	while (true) {
+		int n = epoll_wait(transport->epoll_fd, events, TRANSPORT_EVENTS, -1);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		for (int i = 0; i < n; i++) {
+			void *ptr = events[i].data.ptr;
+
+			if (ptr == transport)
+				return;
+			else if (ptr == NULL)
+				transport_accept(transport);
+			else
+				connection_serve(transport, ptr);
+		}
+	}
+}
+
+/**
+ * @brief The main function of the serving thread.
+ * @param arg The transport to serve.
+ * @return Always `NULL`.
+ */
+static void *transport_run(void *arg)
+{
+	transport_t *transport = arg;
+
+	if (transport->ring != NULL)
+		transport_run_ring(transport);
+	else
+		transport_run_epoll(transport);
+
+	return NULL;
+}
+
+/**
+ * @brief Set up the submission ring of the transport.
+ * @details The ring is only used if the kernel supports all operations needed.
+ * @param transport The transport to modify.
+ * @return `true` if the ring is used, `false` otherwise.
+ */
+static bool transport_ring(transport_t *transport)
+{
+	static const uint8_t ops[] = {
+		IORING_OP_POLL_ADD,
+		IORING_OP_RECV,
+		IORING_OP_SEND,
+		IORING_OP_PROVIDE_BUFFERS,
+		IORING_OP_ASYNC_CANCEL
+	};
+
+	transport->ring = uring_initialize(TRANSPORT_RING_ENTRIES, ops, sizeof(ops) / sizeof(ops[0]));
+	if (transport->ring == NULL)
+		return false;
+
+	char *buffer = calloc(TRANSPORT_BUFFERS, transport->size);
+	if (buffer == NULL) {
+		uring_destroy(transport->ring);
+		transport->ring = NULL;
+		return false;
+	}
+
+	free(transport->buffer);
+	transport->buffer = buffer;
+	return true;
+}
+
+/**
+ * @brief Close all connections and release the resources of the transport.
+ * @param transport The transport to release.
+ */
+static void transport_free(transport_t *transport)
+{
+	// pending requests refer to the connections and buffers
+	uring_destroy(transport->ring);
+
+	connection_t *conn = transport->connections;
+	while (conn != NULL) {
+		connection_t *next = conn->next;
+		close(conn->fd);
+		free(conn);
+		conn = next;
+	}
+
+	if (transport->stop_fd != -1)
+		close(transport->stop_fd);
+	if (transport->epoll_fd != -1)
+		close(transport->epoll_fd);
+	if (transport->listen_fd != -1)
+		close(transport->listen_fd);
+
+	free(transport->buffer);
+	free(transport);
+}
+
+/**
+ * @brief Set the blocking mode of all connections.
+ * @details The kernel waits for input on blocking sockets itself when driven by the ring, whereas `epoll` needs non-blocking sockets. The mode belongs to the socket, so it is shared with other processes holding the connection.
+ * @param transport The transport to consider.
+ */
+static void transport_blocking(transport_t *transport)
+{
+	for (connection_t *conn = transport->connections; conn != NULL; conn = conn->next) {
+		int flags = fcntl(conn->fd, F_GETFL);
+		if (flags == -1)
+			continue;
+
+		if (transport->uring)
+			flags &= ~O_NONBLOCK;
+		else
+			flags |= O_NONBLOCK;
+
+		fcntl(conn->fd, F_SETFL, flags);
+	}
+}
+
+transport_t *transport_create(const char *name, transport_handler_t handler, size_t secret_cap, bool uring, int listen_fd)
+{
+	transport_t *transport = calloc(1, sizeof(transport_t));
+	if (transport == NULL) {
+		if (listen_fd != -1)
+			close(listen_fd);
+		return NULL;
+	}
+
+	transport->listen_fd = listen_fd;
+	transport->epoll_fd = -1;
+	transport->stop_fd = -1;
+	transport->handler = handler;
+	transport->size = SHM_ARENA_OFFSET + secret_cap + 1;
+
+	if (transport->listen_fd == -1)
+		transport->listen_fd = unix_listen(name, SOCK_SEQPACKET);
+
+	transport->buffer = calloc(transport->size, 1);
+	transport->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	if (transport->buffer == NULL || transport->listen_fd == -1 || transport->stop_fd == -1) {
+		transport_free(transport);
+		return NULL;
+	}
+
+	// fall back to epoll on kernels without the operations needed
+	transport->uring = uring && transport_ring(transport);
+
+	if (!transport->uring) {
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = transport;
+
+		transport->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+		if (transport->epoll_fd == -1 ||
+			transport_listen(transport) == -1 ||
+			epoll_ctl(transport->epoll_fd, EPOLL_CTL_ADD, transport->stop_fd, &event) == -1) {
+			transport_free(transport);
+			return NULL;
+		}
+	}
+
+	transport->listening = true;
+
+	return transport;
+}
+
+bool transport_adopt(transport_t *transport, int fd, const connection_t *peer)
+{
+	if (transport->running || transport->connection_count >= TRANSPORT_MAX_CONNECTIONS)
+		return false;
+
+	connection_t *conn = calloc(1, sizeof(connection_t));
+	if (conn == NULL)
+		return false;
+
+	conn->fd = fd;
+	conn->pid = peer->pid;
+	conn->uid = peer->uid;
+	conn->gid = peer->gid;
+	conn->buffer = -1;
+	memcpy(conn->session_id, peer->session_id, sizeof(conn->session_id));
+	memcpy(conn->username, peer->username, sizeof(conn->username));
+
+	// the ring receives over all connections once the thread starts
+	if (!transport->uring && connection_watch(transport, conn) == -1) {
+		free(conn);
+		return false;
+	}
+
+	connection_link(transport, conn);
+	return true;
+}
+
+int transport_resume(transport_t *transport)
+{
+	if (transport->running)
+		return 0;
+
+	if (transport->uring && transport->ring == NULL && !transport_ring(transport))
+		return -1;
+
+	transport_blocking(transport);
+
+	// the main thread handles all signals
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	int errind = pthread_create(&transport->thread, NULL, transport_run, transport);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (errind != 0)
+		return -1;
+
+	transport->running = true;
+	return 0;
+}
+
+int transport_pause(transport_t *transport)
+{
+	if (transport == NULL || !transport->running)
+		return 0;
+
+	transport->pausing = true;
+
+	uint64_t one = 1;
+	if (write(transport->stop_fd, &one, sizeof(one)) != sizeof(one)) {
+		transport->pausing = false;
+		return -1;
+	}
+
+	pthread_join(transport->thread, NULL);
+	transport->running = false;
+	transport->pausing = false;
+
+	// reset the signal for the next run
+	if (read(transport->stop_fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+		return -1;
+
+	// the buffers of the ring are handed to the kernel again by a new ring
+	uring_destroy(transport->ring);
+	transport->ring = NULL;
+
+	return 0;
+}
+
+void transport_stop(transport_t *transport)
+{
+	if (transport == NULL)
+		return;
+
+	uint64_t one = 1;
+	if (transport->running && write(transport->stop_fd, &one, sizeof(one)) == sizeof(one))
+		pthread_join(transport->thread, NULL);
+
+	transport_free(transport);
+}
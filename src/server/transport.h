@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for the socket transport.
+ * @details Besides the shared memory, the server can serve requests over a `SOCK_SEQPACKET` Unix domain socket. Each message holds a packet of `protocol.h`, optionally followed by the data arena. A dedicated thread multiplexes all connections with either `epoll` or a submission ring.
+ */
+
+#ifndef __TRANSPORT_H__
+#define __TRANSPORT_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+
+#include "uring.h"
+
+#include "../share/protocol.h"
+
+/**
+ * @brief The maximum number of connections served at the same time.
+ */
+#define TRANSPORT_MAX_CONNECTIONS 4096
+
+/**
+ * @brief The maximum number of events handled per wakeup.
+ */
+#define TRANSPORT_EVENTS 64
+
+/**
+ * @brief The number of entries of the submission ring.
+ */
+#define TRANSPORT_RING_ENTRIES 256
+
+/**
+ * @brief The number of message buffers the kernel picks from when receiving over the submission ring.
+ */
+#define TRANSPORT_BUFFERS 16
+
+/**
+ * @brief Function handling a message received over a connection.
+ * @details The response is written to the same buffer, see `handle_message()`.
+ */
+typedef size_t (*transport_handler_t)(void *message, size_t len, size_t size);
+
+/**
+ * @brief Representation of a connection.
+ */
+typedef struct connection_s {
+	int fd; ///< The connected socket.
+	pid_t pid; ///< Process id of the peer at the time it connected.
+	uid_t uid; ///< User id of the peer.
+	gid_t gid; ///< Group id of the peer.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id established over the connection, empty if none.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the session.
+	unsigned long requests; ///< Number of requests served over the connection.
+	int buffer; ///< Message buffer held while the response is sent over the submission ring, `-1` if none.
+	size_t used; ///< Number of bytes of `buffer` holding the message or the response.
+	size_t reply; ///< Length of the response being sent.
+	struct connection_s *starved; ///< Next connection waiting for a message buffer.
+	struct connection_s *prev; ///< Previous connection.
+	struct connection_s *next; ///< Next connection.
+} connection_t;
+
+/**
+ * @brief Representation of the socket transport.
+ */
+typedef struct {
+	int listen_fd; ///< The listening socket.
+	int epoll_fd; ///< The epoll instance, `-1` if the submission ring is used.
+	uring_t *ring; ///< The submission ring, `NULL` if `epoll` is used or the thread is paused.
+	bool uring; ///< Whether the connections are driven by a submission ring.
+	int stop_fd; ///< Event file descriptor signalling the thread to stop.
+	transport_handler_t handler; ///< Function handling the messages.
+	pthread_t thread; ///< The thread serving the connections.
+	bool running; ///< Whether the thread is running.
+	bool pausing; ///< Whether the thread is asked to pause rather than to stop.
+	bool draining; ///< Whether the ring waits for the requests in flight before pausing.
+	size_t inflight; ///< Number of receives and sends in flight on the ring.
+	bool listening; ///< Whether new connections are accepted.
+	char *buffer; ///< Buffer holding the current message, or the message buffers of the submission ring.
+	size_t size; ///< Size of a message buffer.
+	connection_t *starved; ///< Connections waiting for a message buffer.
+	connection_t *connections; ///< List of open connections.
+	size_t connection_count; ///< Number of open connections.
+	unsigned long accepted; ///< Number of connections accepted.
+	unsigned long requests; ///< Number of requests served.
+} transport_t;
+
+/**
+ * @brief Create the socket transport on the socket `name`.
+ * @details No requests are served before `transport_resume()` is called. If the submission ring is requested but not supported by the kernel, `epoll` is used instead.
+ * @param name The name of the socket in the abstract namespace, used if `listen_fd` is `-1`.
+ * @param handler The function handling the messages, usually `handle_message()`.
+ * @param secret_cap The maximum length of a secret.
+ * @param uring Whether to drive the connections with a submission ring.
+ * @param listen_fd The listening socket to use, or `-1` to open a new one. The transport takes ownership of it.
+ * @return The memory address of the transport, or `NULL` on failure.
+ */
+transport_t *transport_create(const char *name, transport_handler_t handler, size_t secret_cap, bool uring, int listen_fd);
+
+/**
+ * @brief Serve the connection `fd` established with another process.
+ * @details The thread must not be running. The session bound to the connection is ended once the peer disconnects.
+ * @param transport The transport to add the connection to.
+ * @param fd The connected socket. The transport takes ownership of it on success.
+ * @param peer The identity of the peer and the session bound to the connection.
+ * @return `true` on success, `false` otherwise.
+ */
+bool transport_adopt(transport_t *transport, int fd, const connection_t *peer);
+
+/**
+ * @brief Start or continue serving requests.
+ * @details Signals are blocked in the serving thread, so they are delivered to the main thread.
+ * @param transport The transport to serve.
+ * @return `0` on success, `-1` on failure.
+ */
+int transport_resume(transport_t *transport);
+
+/**
+ * @brief Stop serving requests, keeping all connections open.
+ * @details The function returns once no message is in flight, so every connection is left between two messages. Sessions bound to the connections are kept.
+ * @param transport The transport to pause, may be `NULL`.
+ * @return `0` on success, `-1` on failure.
+ */
+int transport_pause(transport_t *transport);
+
+/**
+ * @brief Stop serving requests and close all connections.
+ * @details Sessions established over the connections are kept, as the server is shutting down.
+ * @param transport The transport to stop.
+ */
+void transport_stop(transport_t *transport);
+
+#endif
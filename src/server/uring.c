@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for submission rings of the kernel.
+ * @details The ring is driven with the raw `io_uring` system calls. Requests are queued in the submission ring, and a single call to `uring_enter()` both submits them and waits for completions.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+/**
+ * @brief Check if the kernel supports the operations `ops`.
+ * @param fd The file descriptor of a ring.
+ * @param ops The operations needed.
+ * @param count The number of operations in `ops`.
+ * @return `true` if all operations are supported, `false` otherwise.
+ */
+static bool uring_probe(int fd, const uint8_t *ops, size_t count)
+{
+	size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe *probe = calloc(1, len);
+	if (probe == NULL)
+		return false;
+
+	bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+
+	for (size_t i = 0; i < count && supported; i++) {
+		if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+			supported = false;
+	}
+
+	free(probe);
+	return supported;
+}
+
+uring_t *uring_initialize(unsigned entries, const uint8_t *ops, size_t count)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	int fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (fd == -1)
+		return NULL;
+
+	uring_t *ring = calloc(1, sizeof(uring_t));
+	if (ring == NULL || !uring_probe(fd, ops, count)) {
+		free(ring);
+		close(fd);
+		return NULL;
+	}
+
+	ring->fd = fd;
+	ring->sq_entries = params.sq_entries;
+	ring->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	// older kernels map both rings separately
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_len > ring->sq_ring_len)
+			ring->sq_ring_len = ring->cq_ring_len;
+		ring->cq_ring_len = ring->sq_ring_len;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	ring->cq_ring = ring->sq_ring;
+	if (ring->sq_ring != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+		ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+	if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+		if (ring->sqes != MAP_FAILED)
+			munmap(ring->sqes, ring->sqes_len);
+		if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+			munmap(ring->cq_ring, ring->cq_ring_len);
+		if (ring->sq_ring != MAP_FAILED)
+			munmap(ring->sq_ring, ring->sq_ring_len);
+		free(ring);
+		close(fd);
+		return NULL;
+	}
+
+	char *sq = ring->sq_ring;
+	ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+	ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+
+	char *cq = ring->cq_ring;
+	ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+	ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+	return ring;
+}
+
+void uring_destroy(uring_t *ring)
+{
+	if (ring == NULL)
+		return;
+
+	munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_len);
+	munmap(ring->sq_ring, ring->sq_ring_len);
+	close(ring->fd);
+	free(ring);
+}
+
+struct io_uring_sqe *uring_sqe(uring_t *ring)
+{
+	unsigned tail = *ring->sq_tail;
+
+	if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+		if (uring_enter(ring, 0) != 0)
+			return NULL;
+
+		if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries)
+			return NULL;
+	}
+
+	unsigned index = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+	// the kernel reads the entry once it is submitted by `uring_enter()`
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->queued += 1;
+
+	return sqe;
+}
+
+int uring_enter(uring_t *ring, unsigned wait)
+{
+	unsigned flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+	__atomic_add_fetch(&ring->enters, 1, __ATOMIC_RELAXED);
+	long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait, flags, NULL, 0);
+	if (submitted == -1)
+		return -1;
+
+	ring->queued -= submitted;
+	return 0;
+}
+
+struct io_uring_cqe *uring_cqe(uring_t *ring)
+{
+	unsigned head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(uring_t *ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for submission rings of the kernel.
+ * @details The ring is driven with the raw `io_uring` system calls. Requests are queued in the submission ring, and a single call to `uring_enter()` both submits them and waits for completions.
+ */
+
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/io_uring.h>
+
+/**
+ * @brief Representation of a ring.
+ */
+typedef struct {
+	int fd; ///< File descriptor of the ring.
+	unsigned *sq_head; ///< Head of the submission ring, advanced by the kernel.
+	unsigned *sq_tail; ///< Tail of the submission ring.
+	unsigned *sq_mask; ///< Mask of the submission ring indices.
+	unsigned *sq_array; ///< Indices of the submitted entries.
+	unsigned sq_entries; ///< Number of entries of the submission ring.
+	struct io_uring_sqe *sqes; ///< Submission entries.
+	unsigned *cq_head; ///< Head of the completion ring.
+	unsigned *cq_tail; ///< Tail of the completion ring, advanced by the kernel.
+	unsigned *cq_mask; ///< Mask of the completion ring indices.
+	struct io_uring_cqe *cqes; ///< Completion entries.
+	void *sq_ring; ///< Mapping of the submission ring.
+	size_t sq_ring_len; ///< Length of `sq_ring`.
+	void *cq_ring; ///< Mapping of the completion ring, may equal `sq_ring`.
+	size_t cq_ring_len; ///< Length of `cq_ring`.
+	size_t sqes_len; ///< Length of the mapping of `sqes`.
+	unsigned queued; ///< Number of entries queued but not submitted.
+	unsigned long enters; ///< Number of calls to `io_uring_enter`.
+} uring_t;
+
+/**
+ * @brief Create a new ring.
+ * @details The ring is only created if the kernel supports all operations in `ops`.
+ * @param entries The number of entries of the submission ring.
+ * @param ops The operations needed.
+ * @param count The number of operations in `ops`.
+ * @return The memory address of the ring, or `NULL` if rings are not supported.
+ */
+uring_t *uring_initialize(unsigned entries, const uint8_t *ops, size_t count);
+
+/**
+ * @brief Destroy the ring `ring`.
+ * @details Pending requests are cancelled.
+ * @param ring The ring to destroy.
+ */
+void uring_destroy(uring_t *ring);
+
+/**
+ * @brief Get an empty submission entry.
+ * @details The entry is queued, so it has to be filled in before the next call to `uring_enter()`. Queued entries are submitted first if the submission ring is full.
+ * @param ring The ring to consider.
+ * @return The entry, or `NULL` if the ring is still full.
+ */
+struct io_uring_sqe *uring_sqe(uring_t *ring);
+
+/**
+ * @brief Submit the queued entries and wait for completions.
+ * @param ring The ring to consider.
+ * @param wait The number of completions to wait for.
+ * @return `0` on success, `-1` on failure.
+ */
+int uring_enter(uring_t *ring, unsigned wait);
+
+/**
+ * @brief Get the oldest completion that has not been consumed yet.
+ * @param ring The ring to consider.
+ * @return The completion, or `NULL` if there is none.
+ */
+struct io_uring_cqe *uring_cqe(uring_t *ring);
+
+/**
+ * @brief Consume the completion returned by `uring_cqe()`.
+ * @param ring The ring to consider.
+ */
+void uring_cqe_seen(uring_t *ring);
+
+#endif
@@ -6,37 +6,188 @@
  * @details Basic user operations include user registration, verification, and secret manipulation.
  */
 
+#include <ctype.h>
 #include <string.h>
+#include <unistd.h>
+#include <time.h>
 
 #include "user.h"
 #include "ipc.h"
 #include "database.h"
+#include "token.h"
+#include "bloom.h"
+#include "index.h"
+#include "kvmap.h"
+#include "critbit.h"
+#include "replica.h"
+#include "journal.h"
+#include "reaper.h"
 
 #include "../share/utils.h"
+#include "../share/watch.h"
+#include "../share/shard.h"
+
+/**
+ * @brief The username filter.
+ * @details This variable is required for the use of this module.
+ */
+extern bloom_t *usernames;
+
+/**
+ * @brief The username index.
+ * @details This variable is required for the use of this module.
+ */
+extern index_t *user_index;
+
+/**
+ * @brief The watch table.
+ * @details This variable is required for the use of this module.
+ */
+extern uint32_t *watch_table;
+
+/**
+ * @brief The user directory.
+ * @details This variable is required for the use of this module.
+ */
+extern critbit_t *user_order;
+
+/**
+ * @brief The published copy.
+ * @details This variable is required for the use of this module. It is `NULL` if nothing is published.
+ */
+extern replica_t *replica;
+
+/**
+ * @brief The journal shipped to a standby server.
+ * @details This variable is required for the use of this module. It is `NULL` if no journal is kept.
+ */
+extern journal_t *journal;
+
+/**
+ * @brief The reaper of sessions whose client exited.
+ * @details This variable is required for the use of this module. It is `NULL` until the server serves clients.
+ */
+extern reaper_t *reaper;
+
+/**
+ * @brief Position of the next entry the sweeper checks for an expired secret.
+ */
+static size_t sweep_position = 0;
+
+/**
+ * @brief Record a change of the secret of an entry.
+ * @details The version is incremented and the clients watching the user are woken up. A standby server has no watch table until it takes over.
+ * @param database The database holding the entry.
+ * @param e The entry whose secret changed.
+ */
+static void user_secret_changed(database_t *database, entry_t *e)
+{
+	e->version += 1;
+
+	if (watch_table != NULL)
+		watch_notify(&watch_table[user_watch_bucket(e->username)]);
+
+	replica_touch_entry(replica, database, e);
+	journal_secret(journal, e);
+}
+
+/**
+ * @brief Clear the secret of an entry if it is expired.
+ * @param database The database the entry belongs to.
+ * @param e The entry to check.
+ * @param now The current time in seconds since the epoch.
+ */
+static void user_secret_expire(database_t *database, entry_t *e, time_t now)
+{
+	if (!entry_expired(e, now))
+		return;
+
+	secret_clear(database, &e->secret);
+	entry_set_expiry(database, e, 0);
+	database->expired += 1;
+	user_secret_changed(database, e);
+}
+
+entry_t *user_find(database_t *database, char *username)
+{
+	size_t len = strnlen(username, MAX_USERNAME_LEN + 1);
+
+	entry_t *e = index_find(user_index, database, username, len);
+
+	// expired secrets are cleared when they are looked up
+	if (e != NULL && e->expires != 0)
+		user_secret_expire(database, e, time(NULL));
+
+	return e;
+}
 
 /**
  * @brief Check if a user exists in the database `database`.
- * @details Iterates through the whole list.
+ * @details The username filter is consulted first, so that the database is only searched if the user might exist.
  * @param database The database to look for the user in.
  * @param username The username to look for in the database.
  * @return `true` if the user was found, `false` otherwise.
  */
-static bool user_exists(list_t *database, char *username)
+static bool user_exists(database_t *database, char *username)
 {
-	for (element_t *curr = database->head; curr != NULL; curr = curr->next) {
-		entry_t *e = (entry_t *) curr->data;
-		if (strncmp(e->username, username, MAX_USERNAME_LEN + 1) == 0)
-			return true;
-	}
+	if (!bloom_contains(usernames, username))
+		return false;
+
+	if (user_find(database, username) != NULL)
+		return true;
 
+	usernames->false_positives += 1;
 	return false;
 }
 
-bool user_register(list_t *database, char *username, char *password)
+uint32_t user_watch_bucket(char *username)
 {
-	if (user_exists(database, username))
+	size_t len = strnlen(username, MAX_USERNAME_LEN + 1);
+
+	return siphash(user_index->key, username, len) & (WATCH_BUCKETS - 1);
+}
+
+bool user_filter_build(database_t *database)
+{
+	bloom_t *bloom = bloom_initialize(2 * database->length);
+	if (bloom == NULL)
 		return false;
 
+	for (size_t i = 0; i < database->length; i++)
+		bloom_add(bloom, database->entries[i].username);
+
+	// keep the counters of the previous filter
+	if (usernames != NULL) {
+		bloom->lookups = usernames->lookups;
+		bloom->rejections = usernames->rejections;
+		bloom->false_positives = usernames->false_positives;
+		bloom_destroy(usernames);
+	}
+
+	usernames = bloom;
+	return true;
+}
+
+bool user_directory_build(database_t *database)
+{
+	critbit_t *tree = critbit_initialize();
+	if (tree == NULL)
+		return false;
+
+	for (size_t i = 0; i < database->length; i++) {
+		if (!critbit_insert(tree, database->entries[i].username)) {
+			critbit_destroy(tree);
+			return false;
+		}
+	}
+
+	critbit_destroy(user_order);
+	user_order = tree;
+	return true;
+}
+
+bool user_register(database_t *database, char *username, char *password)
+{
 	str_strip(username);
 	str_strip(password);
 
@@ -44,35 +195,104 @@ bool user_register(list_t *database, char *username, char *password)
 		!is_valid_field(password, false))
 		return false;
 
-	entry_t e;
-	memset(&e, 0, sizeof(e));
-	strncpy(e.username, username, MAX_USERNAME_LEN + 1);
-	strncpy(e.password, password, MAX_PASSWORD_LEN + 1);
+	// the user is registered by the server of its shard
+	if (!shard_owns(username))
+		return false;
+
+	if (user_exists(database, username))
+		return false;
 
-	bool success = list_add(database, &e, sizeof(e));
-	return success;
+	// the strings of the user are given back if it cannot be registered
+	arena_mark_t mark = arena_mark(database->strings);
+
+	entry_t *e = database_add(database, username, password, "");
+	if (e == NULL)
+		return false;
+
+	if (!critbit_insert(user_order, e->username)) {
+		database->length -= 1;
+		arena_rewind(database->strings, mark);
+		return false;
+	}
+
+	if (!index_insert(user_index, database, database->length - 1)) {
+		critbit_remove(user_order, e->username);
+		database->length -= 1;
+		arena_rewind(database->strings, mark);
+		return false;
+	}
+
+	bloom_add(usernames, e->username);
+	replica_touch_entry(replica, database, e);
+	journal_register(journal, e->username, e->password);
+
+	// grow the filter before its false positive rate degrades
+	if (usernames->count > usernames->capacity)
+		user_filter_build(database);
+
+	return true;
 }
 
-bool user_verify_credentials(list_t *database, char *username, char *password)
+bool user_verify_credentials(database_t *database, char *username, char *password)
 {
-	for (element_t *curr = database->head; curr != NULL; curr = curr->next) {
-		entry_t *e = (entry_t *) curr->data;
-		if (strncmp(e->username, username, MAX_USERNAME_LEN) == 0 &&
-			strncmp(e->password, password, MAX_PASSWORD_LEN) == 0)
-			return true;
-	}
+	entry_t *e = user_find(database, username);
+	if (e == NULL)
+		return false;
 
-	return false;
+	return strncmp(e->password, password, MAX_PASSWORD_LEN) == 0;
 }
 
-bool user_login(list_t *clients, char *username, char *session_id)
+bool user_issue_token(database_t *database, char *username, char *token)
+{
+	entry_t *e = user_find(database, username);
+	if (e == NULL)
+		return false;
+
+	token_issue(e->username, e->generation, token);
+	return true;
+}
+
+bool user_verify_token(database_t *database, char *username, char *token)
+{
+	entry_t *e = user_find(database, username);
+	if (e == NULL)
+		return false;
+
+	return token_verify(e->username, e->generation, token);
+}
+
+void user_revoke_tokens(database_t *database, char *username)
+{
+	entry_t *e = user_find(database, username);
+	if (e == NULL)
+		return;
+
+	e->generation += 1;
+	journal_revoke(journal, e->username);
+}
+
+bool user_login(list_t *clients, char *username, char *session_id, pid_t pid)
 {
 	client_t c;
 	memset(&c, 0, sizeof(c));
 	strncpy(c.session_id, session_id, SESSION_ID_SIZE + 1);
 	strncpy(c.username, username, MAX_USERNAME_LEN + 1);
+	c.pid = pid;
+	c.pidfd = -1;
+
+	// the reaper refers to the copy kept in the list
+	client_t *added = list_add(clients, &c, sizeof(client_t));
+	if (added == NULL)
+		return false;
+
+	if (!reaper_watch(reaper, added)) {
+		list_remove(clients, added);
+		return false;
+	}
 
-	return list_add(clients, &c, sizeof(client_t));
+	replica_touch_sessions(replica);
+	journal_session(journal, c.username, c.session_id, c.pid, true);
+	return true;
 }
 
 bool user_logout(list_t *clients, char *username, char *session_id)
@@ -82,6 +302,9 @@ bool user_logout(list_t *clients, char *username, char *session_id)
 
 		if (strncmp(e->username, username, MAX_USERNAME_LEN) == 0 &&
 			strncmp(e->session_id, session_id, SESSION_ID_SIZE) == 0) {
+			replica_touch_sessions(replica);
+			journal_session(journal, username, session_id, e->pid, false);
+			reaper_forget(reaper, e);
 			return list_remove(clients, e);
 		}
 	}
@@ -89,32 +312,195 @@ bool user_logout(list_t *clients, char *username, char *session_id)
 	return false;
 }
 
-char *user_secret_read(list_t *database, char *username)
+secret_t *user_secret_read(entry_t *e)
 {
-	for (element_t *curr = database->head; curr != NULL; curr = curr->next) {
-		entry_t *e = (entry_t *) curr->data;
-		if (strncmp(e->username, username, MAX_USERNAME_LEN) == 0) {
-			return e->secret;
-		}
+	return &e->secret;
+}
+
+bool user_secret_write(database_t *database, entry_t *e, char *secret, uint32_t ttl)
+{
+	str_strip(secret);
+
+	if (!is_valid_field(secret, true))
+		return false;
+
+	if (!secret_set(database, &e->secret, secret, strlen(secret)))
+		return false;
+
+	entry_set_expiry(database, e, ttl != 0 ? time(NULL) + ttl : 0);
+	user_secret_changed(database, e);
+	return true;
+}
+
+bool user_secret_write_memfd(database_t *database, entry_t *e, int fd, size_t len, uint32_t ttl)
+{
+	secret_t s;
+	memset(&s, 0, sizeof(s));
+
+	if (!secret_set_memfd(database, &s, fd, len)) {
+		close(fd);
+		return false;
+	}
+
+	// the contents are stripped and validated like any other secret
+	char *data = secret_data(&s);
+	size_t start = 0, end = len;
+
+	while (start < end && isspace((unsigned char) data[start]))
+		start++;
+
+	while (end > start && isspace((unsigned char) data[end - 1]))
+		end--;
+
+	if (memchr(data + start, '\0', end - start) != NULL ||
+		memchr(data + start, '\n', end - start) != NULL ||
+		memchr(data + start, ';', end - start) != NULL) {
+		secret_clear(database, &s);
+		return false;
+	}
+
+	if (start == 0 && end == len) {
+		secret_clear(database, &e->secret);
+		e->secret = s;
+	} else {
+		// the file is sealed, so a stripped secret is kept as a copy
+		bool stored = secret_set(database, &e->secret, data + start, end - start);
+		secret_clear(database, &s);
+
+		if (!stored)
+			return false;
+	}
+
+	entry_set_expiry(database, e, ttl != 0 ? time(NULL) + ttl : 0);
+	user_secret_changed(database, e);
+	return true;
+}
+
+bool user_secret_restore(database_t *database, char *username, const char *secret, size_t len, uint64_t version, uint32_t expires)
+{
+	size_t ulen = strnlen(username, MAX_USERNAME_LEN + 1);
+
+	// the secret is taken as is, even if it already expired
+	entry_t *e = index_find(user_index, database, username, ulen);
+	if (e == NULL || !secret_set(database, &e->secret, secret, len))
+		return false;
+
+	entry_set_expiry(database, e, expires);
+	e->version = version;
+	replica_touch_entry(replica, database, e);
+	return true;
+}
+
+void user_expire_sweep(database_t *database, size_t batch)
+{
+	if (database->expiring == 0 || database->length == 0)
+		return;
+
+	time_t now = time(NULL);
+
+	for (size_t i = 0; i < batch && i < database->length; i++) {
+		if (sweep_position >= database->length)
+			sweep_position = 0;
+
+		user_secret_expire(database, &database->entries[sweep_position], now);
+		sweep_position += 1;
 	}
+}
+
+uint64_t user_secret_version(entry_t *e)
+{
+	return e->version;
+}
 
-	return NULL;
+uint32_t user_secret_expiry(entry_t *e)
+{
+	return e->expires;
 }
 
-bool user_secret_write(list_t *database, char *username, char *secret)
+secret_t *user_key_read(database_t *database, char *username, char *key)
 {
+	entry_t *e = user_find(database, username);
+	if (e == NULL || e->keys == NULL)
+		return NULL;
+
+	return kvmap_get(e->keys, key);
+}
+
+bool user_key_write(database_t *database, char *username, char *key, char *secret)
+{
+	str_strip(key);
 	str_strip(secret);
 
-	if (!is_valid_field(secret, true))
+	if (!is_valid_key(key) || !is_valid_field(secret, true))
 		return false;
 
-	for (element_t *curr = database->head; curr != NULL; curr = curr->next) {
-		entry_t *e = (entry_t *) curr->data;
-		if (strncmp(e->username, username, MAX_USERNAME_LEN) == 0) {
-			strncpy(e->secret, secret, MAX_SECRET_LEN + 1);
-			return true;
-		}
+	entry_t *e = user_find(database, username);
+	if (e == NULL)
+		return false;
+
+	if (e->keys == NULL) {
+		e->keys = kvmap_initialize();
+		if (e->keys == NULL)
+			return false;
 	}
 
-	return false;
+	// a key added for a value that cannot be stored is removed again
+	bool added = kvmap_get(e->keys, key) == NULL;
+
+	secret_t *s = kvmap_put(e->keys, database, key);
+	if (s == NULL)
+		return false;
+
+	if (!secret_set(database, s, secret, strlen(secret))) {
+		if (added)
+			kvmap_delete(e->keys, database, key);
+
+		return false;
+	}
+
+	journal_key(journal, e->username, key, secret);
+	return true;
+}
+
+bool user_key_delete(database_t *database, char *username, char *key)
+{
+	entry_t *e = user_find(database, username);
+	if (e == NULL || e->keys == NULL)
+		return false;
+
+	if (!kvmap_delete(e->keys, database, key))
+		return false;
+
+	journal_key_delete(journal, e->username, key);
+	return true;
+}
+
+uint32_t user_scan(database_t *database, char *username, enum scan_e target, char *cursor, uint32_t limit, char names[][MAX_CURSOR_LEN + 1])
+{
+	critbit_t *tree = user_order;
+
+	if (target == SCAN_KEYS) {
+		entry_t *e = user_find(database, username);
+		tree = (e != NULL && e->keys != NULL) ? e->keys->order : NULL;
+	}
+
+	uint32_t count = 0;
+	const char *after = cursor[0] != '\0' ? cursor : NULL;
+	const char *name = tree != NULL ? critbit_next(tree, after) : NULL;
+
+	while (name != NULL && count < limit) {
+		strncpy(names[count], name, MAX_CURSOR_LEN + 1);
+		count += 1;
+
+		after = name;
+		name = critbit_next(tree, after);
+	}
+
+	// the cursor is the last name returned, as long as there are more
+	if (name != NULL)
+		strncpy(cursor, after, MAX_CURSOR_LEN + 1);
+	else
+		cursor[0] = '\0';
+
+	return count;
 }
@@ -10,6 +10,31 @@
 #define __USER_H__
 
 #include "list.h"
+#include "database.h"
+
+#include "../share/protocol.h"
+
+/**
+ * @brief Build the username filter from the database.
+ * @details The filter is sized for twice the number of users in the database. An existing filter is replaced, keeping its counters.
+ * @param database The database to consider for this operation.
+ * @return `true` on success, `false` otherwise.
+ */
+bool user_filter_build(database_t *database);
+
+/**
+ * @brief Build the user directory from the database.
+ * @param database The database to consider for this operation.
+ * @return `true` on success, `false` otherwise.
+ */
+bool user_directory_build(database_t *database);
+
+/**
+ * @brief Determine the bucket of the watch table of the user `username`.
+ * @param username The username to consider for this operation.
+ * @return The index of the bucket.
+ */
+uint32_t user_watch_bucket(char *username);
 
 /**
  * @brief Register the user `username` in the database.
@@ -18,7 +43,7 @@
  * @param password The password to assign the username to.
  * @return `true` on success, `false` otherwise.
  */
-bool user_register(list_t *database, char *username, char *password);
+bool user_register(database_t *database, char *username, char *password);
 
 /**
  * @brief Verify if `password` is the password for the user `username`.
@@ -27,16 +52,44 @@ bool user_register(list_t *database, char *username, char *password);
  * @param password The password to use for the verification.
  * @return `true` on success, `false` otherwise.
  */
-bool user_verify_credentials(list_t *database, char *username, char *password);
+bool user_verify_credentials(database_t *database, char *username, char *password);
+
+/**
+ * @brief Issue a resumption token for the user `username`.
+ * @param database The database to consider for this operation.
+ * @param username The username to consider for this operation.
+ * @param token The buffer to write the token to.
+ * @return `true` on success, `false` otherwise.
+ */
+bool user_issue_token(database_t *database, char *username, char *token);
+
+/**
+ * @brief Verify if `token` is a valid resumption token for the user `username`.
+ * @details The password of the user is not consulted.
+ * @param database The database to consider for this operation.
+ * @param username The username to consider for this operation.
+ * @param token The token to use for the verification.
+ * @return `true` on success, `false` otherwise.
+ */
+bool user_verify_token(database_t *database, char *username, char *token);
+
+/**
+ * @brief Invalidate all resumption tokens issued to the user `username`.
+ * @param database The database to consider for this operation.
+ * @param username The username to consider for this operation.
+ */
+void user_revoke_tokens(database_t *database, char *username);
 
 /**
  * @brief Add the user to the clients list.
+ * @details The owner of the session is watched, so that the session ends once it exits.
  * @param clients The clients list to consider for this operation.
  * @param username The username to consider for this operation.
  * @param session_id Session id associated with this user.
- * @return `true` on success, `false` otherwise.
+ * @param pid Process id of the client owning the session, `0` if it has none.
+ * @return `true` on success, `false` otherwise, also if the owner has exited already.
  */
-bool user_login(list_t *clients, char *username, char *session_id);
+bool user_login(list_t *clients, char *username, char *session_id, pid_t pid);
 
 /**
  * @brief Remove the user from the clients list.
@@ -48,20 +101,118 @@ bool user_login(list_t *clients, char *username, char *session_id);
 bool user_logout(list_t *database, char *username, char *session_id);
 
 /**
- * @brief Read the secret of the user `username` from the database.
+ * @brief Look up the entry of user `username` in the database `database`.
+ * @details The lookup is done through the username index. An expired secret of the user is cleared. A request looks the user up once and passes the entry to the functions below, which is valid until the next user is registered.
+ * @param database The database to look for the user in.
+ * @param username The username to look for in the database.
+ * @return The entry of the user, or `NULL` if the user was not found.
+ */
+entry_t *user_find(database_t *database, char *username);
+
+/**
+ * @brief Read the secret of a user.
+ * @param e The entry of the user.
+ * @return A pointer to the secret.
+ */
+secret_t *user_secret_read(entry_t *e);
+
+/**
+ * @brief Write a new secret for a user to the database.
+ * @param database The database to consider for this operation.
+ * @param e The entry of the user.
+ * @param secret The secret to write into the database.
+ * @param ttl Lifetime of the secret in seconds, `0` if it does not expire.
+ * @return `true` on success, `false` otherwise.
+ */
+bool user_secret_write(database_t *database, entry_t *e, char *secret, uint32_t ttl);
+
+/**
+ * @brief Write a new secret passed as sealed memory file descriptor for a user to the database.
+ * @details The secret is stripped and validated like any other secret. If stripping changed it, a copy is stored instead of the file. The function takes ownership of `fd`, which is closed unless the file itself is stored.
+ * @param database The database to consider for this operation.
+ * @param e The entry of the user.
+ * @param fd The sealed memory file descriptor holding the secret.
+ * @param len The length of the secret.
+ * @param ttl Lifetime of the secret in seconds, `0` if it does not expire.
+ * @return `true` on success, `false` otherwise.
+ */
+bool user_secret_write_memfd(database_t *database, entry_t *e, int fd, size_t len, uint32_t ttl);
+
+/**
+ * @brief Replace the secret of the user `username` as it is stored on another server.
+ * @details The version and the expiry are taken over, and no client is woken up.
+ * @param database The database to consider for this operation.
+ * @param username The user whose secret to replace.
+ * @param secret The secret, which does not need to be terminated.
+ * @param len The length of `secret`.
+ * @param version The version of the secret.
+ * @param expires Time in seconds since the epoch at which the secret expires, `0` if it does not.
+ * @return `true` on success, `false` otherwise.
+ */
+bool user_secret_restore(database_t *database, char *username, const char *secret, size_t len, uint64_t version, uint32_t expires);
+
+/**
+ * @brief Clear expired secrets.
+ * @details Only `batch` entries are checked per call, continuing where the previous call stopped, so that a full pass is spread over many calls.
+ * @param database The database to consider for this operation.
+ * @param batch The number of entries to check.
+ */
+void user_expire_sweep(database_t *database, size_t batch);
+
+/**
+ * @brief Read the version of the secret of a user.
+ * @details The version increases with every write of the secret.
+ * @param e The entry of the user.
+ * @return The version of the secret.
+ */
+uint64_t user_secret_version(entry_t *e);
+
+/**
+ * @brief Read the expiry time of the secret of a user.
+ * @param e The entry of the user.
+ * @return The time in seconds since the epoch at which the secret expires, `0` if it does not.
+ */
+uint32_t user_secret_expiry(entry_t *e);
+
+/**
+ * @brief Read the secret named `key` of the user `username` from the database.
  * @param database The database to consider for this operation.
  * @param username The username to consider for this operation.
- * @return A pointer to the secret string.
+ * @param key The name of the secret.
+ * @return A pointer to the secret, or `NULL` if there is none.
  */
-char *user_secret_read(list_t *database, char *username);
+secret_t *user_key_read(database_t *database, char *username, char *key);
 
 /**
- * @brief Write a new secret for the user `username` to the database.
+ * @brief Write the secret named `key` of the user `username` to the database.
  * @param database The database to consider for this operation.
  * @param username The username to consider for this operation.
+ * @param key The name of the secret.
  * @param secret The secret to write into the database.
  * @return `true` on success, `false` otherwise.
  */
-bool user_secret_write(list_t *database, char *username, char *secret);
+bool user_key_write(database_t *database, char *username, char *key, char *secret);
+
+/**
+ * @brief Delete the secret named `key` of the user `username` from the database.
+ * @param database The database to consider for this operation.
+ * @param username The username to consider for this operation.
+ * @param key The name of the secret.
+ * @return `true` on success, `false` if there is no such secret.
+ */
+bool user_key_delete(database_t *database, char *username, char *key);
+
+/**
+ * @brief Read a page of usernames or of names of the secrets of the user `username`.
+ * @details At most `limit` names following `cursor` are looked up, so the work is bounded by the page size.
+ * @param database The database to consider for this operation.
+ * @param username The username to consider for this operation.
+ * @param target What to scan.
+ * @param cursor The cursor of the page, empty for the first page. Set to the cursor of the next page, which is empty after the last page.
+ * @param limit The maximum number of names to return, between `1` and `SCAN_PAGE_SIZE`.
+ * @param names Set to the names of the page.
+ * @return The number of names returned.
+ */
+uint32_t user_scan(database_t *database, char *username, enum scan_e target, char *cursor, uint32_t limit, char names[][MAX_CURSOR_LEN + 1]);
 
 #endif
@@ -0,0 +1,281 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for passing file descriptors between processes.
+ * @details Descriptors are passed over Unix domain sockets in the abstract namespace. Sealed memory file descriptors are used to hand over long secrets without copying them.
+ */
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "fdpass.h"
+#include "utils.h"
+
+/**
+ * @brief The seals a memory file descriptor must carry.
+ */
+#define MEMFD_SEALS (F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+/**
+ * @brief Fill in the address of a socket in the abstract namespace.
+ * @param addr The address to fill in.
+ * @param name Name of the socket.
+ * @return The length of the address.
+ */
+static socklen_t unix_address(struct sockaddr_un *addr, const char *name)
+{
+	size_t len = strnlen(name, sizeof(addr->sun_path) - 1);
+
+	memset(addr, 0, sizeof(struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+	memcpy(addr->sun_path + 1, name, len);
+
+	return offsetof(struct sockaddr_un, sun_path) + 1 + len;
+}
+
+int unix_listen(const char *name, int type)
+{
+	struct sockaddr_un addr;
+	socklen_t len = unix_address(&addr, name);
+
+	int sock = socket(AF_UNIX, type | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (sock == -1)
+		return -1;
+
+	if (bind(sock, (struct sockaddr *) &addr, len) == -1 ||
+		listen(sock, 16) == -1) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+int unix_connect(const char *name, int type)
+{
+	struct sockaddr_un addr;
+	socklen_t len = unix_address(&addr, name);
+
+	int sock = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+	if (sock == -1)
+		return -1;
+
+	if (connect(sock, (struct sockaddr *) &addr, len) == -1) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+int unix_accept_pid(int sock, pid_t pid, int timeout)
+{
+	struct pollfd pfd = { .fd = sock, .events = POLLIN };
+	uint64_t expires = clock_ms() + timeout;
+	uint64_t now;
+
+	// connections of other processes must not extend the wait
+	while ((now = clock_ms()) < expires && poll(&pfd, 1, expires - now) > 0) {
+		int conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+		if (conn == -1)
+			continue;
+
+		struct ucred cred;
+		socklen_t len = sizeof(cred);
+
+		if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+			cred.pid == pid) {
+			// the peer has the rest of the time to send or receive
+			uint64_t left = expires > clock_ms() ? expires - clock_ms() : 1;
+			struct timeval tv = { .tv_sec = left / 1000, .tv_usec = (left % 1000) * 1000 };
+
+			if (setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0 &&
+				setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == 0)
+				return conn;
+		}
+
+		close(conn);
+	}
+
+	return -1;
+}
+
+int send_fds(int sock, const void *data, size_t len, const int *fds, size_t count)
+{
+	if (len == 0 || count > FDPASS_MAX)
+		return -1;
+
+	struct iovec iov = { .iov_base = (void *) data, .iov_len = len };
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * FDPASS_MAX)];
+		struct cmsghdr align;
+	} control;
+
+	memset(&control, 0, sizeof(control));
+
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buf,
+		.msg_controllen = CMSG_SPACE(sizeof(int) * count),
+	};
+
+	if (count > 0) {
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+	} else {
+		msg.msg_control = NULL;
+		msg.msg_controllen = 0;
+	}
+
+	ssize_t sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+	if (sent <= 0)
+		return -1;
+
+	// the descriptors travel with the first part of a stream
+	const char *rest = (const char *) data + sent;
+	len -= sent;
+
+	while (len > 0) {
+		sent = send(sock, rest, len, MSG_NOSIGNAL);
+		if (sent <= 0)
+			return -1;
+
+		rest += sent;
+		len -= sent;
+	}
+
+	return 0;
+}
+
+int recv_fds(int sock, void *data, size_t len, int *fds, size_t *count)
+{
+	struct iovec iov = { .iov_base = data, .iov_len = len };
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * FDPASS_MAX)];
+		struct cmsghdr align;
+	} control;
+
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buf,
+		.msg_controllen = sizeof(control.buf),
+	};
+
+	size_t max = *count;
+	*count = 0;
+
+	ssize_t received = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	if (received <= 0)
+		return -1;
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+		size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		int *passed = (int *) CMSG_DATA(cmsg);
+
+		for (size_t i = 0; i < n; i++) {
+			int fd;
+			memcpy(&fd, passed + i, sizeof(int));
+
+			if (i < max)
+				fds[(*count)++] = fd;
+			else
+				close(fd);
+		}
+
+		if (n > max || (msg.msg_flags & MSG_CTRUNC)) {
+			for (size_t i = 0; i < *count; i++)
+				close(fds[i]);
+			*count = 0;
+			return -1;
+		}
+	}
+
+	// the rest of a stream comes without descriptors
+	if ((size_t) received < len &&
+		recv(sock, (char *) data + received, len - received, MSG_WAITALL) != (ssize_t) (len - received)) {
+		for (size_t i = 0; i < *count; i++)
+			close(fds[i]);
+		*count = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+int send_fd(int sock, int fd)
+{
+	char byte = 0;
+
+	return send_fds(sock, &byte, 1, &fd, 1);
+}
+
+int recv_fd(int sock)
+{
+	char byte;
+	int fd;
+	size_t count = 1;
+
+	if (recv_fds(sock, &byte, 1, &fd, &count) != 0)
+		return -1;
+
+	if (count != 1)
+		return -1;
+
+	return fd;
+}
+
+int memfd_sealed(const char *data, size_t len)
+{
+	int fd = memfd_create("authme_secret", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd == -1)
+		return -1;
+
+	size_t done = 0;
+	while (done < len) {
+		ssize_t n = write(fd, data + done, len - done);
+		if (n <= 0) {
+			close(fd);
+			return -1;
+		}
+
+		done += n;
+	}
+
+	if (fcntl(fd, F_ADD_SEALS, MEMFD_SEALS) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+bool memfd_is_sealed(int fd, size_t len)
+{
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (seals == -1 || (seals & MEMFD_SEALS) != MEMFD_SEALS)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1)
+		return false;
+
+	return (size_t) st.st_size == len;
+}
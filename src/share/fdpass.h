@@ -0,0 +1,102 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for passing file descriptors between processes.
+ * @details Descriptors are passed over Unix domain sockets in the abstract namespace. Sealed memory file descriptors are used to hand over long secrets without copying them.
+ */
+
+#ifndef __FDPASS_H_SHARE__
+#define __FDPASS_H_SHARE__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <sys/types.h>
+
+/**
+ * @brief The maximum number of file descriptors passed with one message.
+ */
+#define FDPASS_MAX 64
+
+/**
+ * @brief Create a non-blocking listening socket in the abstract namespace.
+ * @param name Name of the socket.
+ * @param type The socket type, either `SOCK_STREAM` or `SOCK_SEQPACKET`.
+ * @return The socket, or `-1` on failure.
+ */
+int unix_listen(const char *name, int type);
+
+/**
+ * @brief Connect to a listening socket in the abstract namespace.
+ * @param name Name of the socket.
+ * @param type The socket type, which must match the one of the listening socket.
+ * @return The connected socket, or `-1` on failure.
+ */
+int unix_connect(const char *name, int type);
+
+/**
+ * @brief Accept a connection from process `pid`.
+ * @details Connections of other processes are closed. The function gives up after `timeout` milliseconds, and sending or receiving over the connection fails once that time has passed, so that a peer which stops sending cannot stall the caller.
+ * @param sock The listening socket.
+ * @param pid The process id of the expected peer.
+ * @param timeout Maximum time to wait in milliseconds.
+ * @return The connected socket, or `-1` on failure.
+ */
+int unix_accept_pid(int sock, pid_t pid, int timeout);
+
+/**
+ * @brief Send `len` bytes of `data` together with the file descriptors `fds` over the socket `sock`.
+ * @param sock The connected socket.
+ * @param data The data to send, at least one byte.
+ * @param len The length of `data`.
+ * @param fds The file descriptors to send.
+ * @param count The number of file descriptors, at most `FDPASS_MAX`.
+ * @return `0` on success, `-1` on failure.
+ */
+int send_fds(int sock, const void *data, size_t len, const int *fds, size_t count);
+
+/**
+ * @brief Receive `len` bytes of data together with file descriptors over the socket `sock`.
+ * @param sock The connected socket.
+ * @param data The buffer to receive the data into.
+ * @param len The length of the data.
+ * @param fds The buffer to receive the file descriptors into.
+ * @param count The number of file descriptors `fds` has room for, set to the number received.
+ * @return `0` on success, `-1` on failure, in which case no file descriptors are kept.
+ */
+int recv_fds(int sock, void *data, size_t len, int *fds, size_t *count);
+
+/**
+ * @brief Send the file descriptor `fd` over the socket `sock`.
+ * @param sock The connected socket.
+ * @param fd The file descriptor to send.
+ * @return `0` on success, `-1` on failure.
+ */
+int send_fd(int sock, int fd);
+
+/**
+ * @brief Receive a file descriptor over the socket `sock`.
+ * @param sock The connected socket.
+ * @return The file descriptor received, or `-1` on failure.
+ */
+int recv_fd(int sock);
+
+/**
+ * @brief Create a sealed memory file descriptor holding `len` bytes of `data`.
+ * @details The file can neither be written, nor be resized after it is sealed.
+ * @param data The data to store.
+ * @param len The number of bytes to store.
+ * @return The file descriptor, or `-1` on failure.
+ */
+int memfd_sealed(const char *data, size_t len);
+
+/**
+ * @brief Check if `fd` is a sealed memory file descriptor of size `len`.
+ * @param fd The file descriptor to check.
+ * @param len The expected size of the file.
+ * @return `true` if the file is sealed and of size `len`, `false` otherwise.
+ */
+bool memfd_is_sealed(int fd, size_t len);
+
+#endif
@@ -9,6 +9,10 @@
 #ifndef __PROTOCOL_H_SHARE__
 #define __PROTOCOL_H_SHARE__
 
+#include <stdint.h>
+
+#include <sys/types.h>
+
 /**
  * @brief The filename of the shared memory.
  */
@@ -25,19 +29,80 @@
 #define MAX_PASSWORD_LEN 32
 
 /**
- * @brief The maximum size of the secret field.
+ * @brief The maximum size of a secret transferred inline in a packet.
+ * @details Longer secrets are transferred through the data arena of the shared memory.
  */
 #define MAX_SECRET_LEN 128
 
+/**
+ * @brief The default maximum size of a secret.
+ * @details The server can be configured to use a different limit, which determines the size of the data arena.
+ */
+#define SECRET_CAP_DEFAULT 65536
+
 /**
  * @brief The length of a session id.
  */
 #define SESSION_ID_SIZE 32
 
 /**
- * @brief The size of the shared memory.
+ * @brief The length of a session resumption token.
+ */
+#define TOKEN_SIZE 40
+
+/**
+ * @brief The maximum size of the name of a key.
+ */
+#define MAX_KEY_LEN 32
+
+/**
+ * @brief The maximum number of names returned by a scan.
+ */
+#define SCAN_PAGE_SIZE 16
+
+/**
+ * @brief The maximum size of a scan cursor.
+ * @details Must be large enough for both usernames and names of keys.
+ */
+#define MAX_CURSOR_LEN 32
+
+/**
+ * @brief The name of the socket used to pass secrets as file descriptors.
+ * @details The socket lives in the abstract namespace and only exists if the server offers descriptor passing.
+ */
+#define FD_SOCKET_NAME "authme_fd"
+
+/**
+ * @brief The minimum length of a secret to be written as file descriptor.
+ */
+#define SECRET_FD_THRESHOLD 16384
+
+/**
+ * @brief The name of the socket serving requests as messages.
+ * @details The socket lives in the abstract namespace and only exists if the server offers the socket transport. Each message holds a packet, optionally followed by the data arena.
+ */
+#define TRANSPORT_SOCKET_NAME "authme_sock"
+
+/**
+ * @brief The format of the names of the sockets of read-only replicas, given the index of the replica.
+ * @details A replica serves `SECRET_READ` packets from a copy of the database published by the server, like the socket transport does.
+ */
+#define REPLICA_SOCKET_FORMAT "authme_replica_%u"
+
+/**
+ * @brief The maximum number of read-only replicas.
+ */
+#define MAX_REPLICAS 16
+
+/**
+ * @brief The name of the shared memory holding the watch table.
+ */
+#define WATCH_SHM_NAME "authme_watch"
+
+/**
+ * @brief The number of buckets of the watch table, a power of two.
  */
-#define SHM_LEN (10 + MAX_USERNAME_LEN + MAX_PASSWORD_LEN + MAX_SECRET_LEN + SESSION_ID_SIZE)
+#define WATCH_BUCKETS 1024
 
 /**
  * @brief The name of the first server semaphore.
@@ -50,10 +115,48 @@
 #define SEM_SERVER2 "authme_server2"
 
 /**
- * @brief The name of the client semaphore.
+ * @brief The name of the third server semaphore.
+ * @details Posted by every client that reached the head of its lane.
+ */
+#define SEM_SERVER3 "authme_server3"
+
+/**
+ * @brief The name of the client semaphore of the interactive lane.
  */
 #define SEM_CLIENT1 "authme_client1"
 
+/**
+ * @brief The name of the client semaphore of the bulk lane.
+ */
+#define SEM_CLIENT2 "authme_client2"
+
+/**
+ * @brief The name of the semaphore granting the shared memory to the interactive lane.
+ */
+#define SEM_GRANT1 "authme_grant1"
+
+/**
+ * @brief The name of the semaphore granting the shared memory to the bulk lane.
+ */
+#define SEM_GRANT2 "authme_grant2"
+
+/**
+ * @brief The name of the semaphore admitting clients to the interactive lane.
+ * @details Its value is the number of clients the lane can still take.
+ */
+#define SEM_ADMIT1 "authme_admit1"
+
+/**
+ * @brief The name of the semaphore admitting clients to the bulk lane.
+ * @details Its value is the number of clients the lane can still take.
+ */
+#define SEM_ADMIT2 "authme_admit2"
+
+/**
+ * @brief The number of lanes of the shared memory.
+ */
+#define LANES 2
+
 /**
  * @brief The name of the exit semaphore.
  */
@@ -74,7 +177,37 @@ enum server_status_e {
  */
 enum request_status_e {
 	SUCCESS, ///< The request was successfully executed.
-	ERROR ///< The request could not be fullfilled.
+	ERROR, ///< The request could not be fullfilled.
+	CONFLICT, ///< The conditional write was rejected, because the secret has a different version.
+	STALE, ///< The replica cannot serve the request from its copy of the database, so the server has to be asked.
+	BUSY, ///< The request was not admitted, because the queue of its lane is full.
+	TIMEOUT, ///< The request was not served before its deadline.
+	LIMITED ///< The login was rejected, because the client or the user exceeded its rate of logins.
+};
+
+/**
+ * @brief Enum for the lanes clients queue in for the shared memory.
+ * @details Every packet type belongs to one lane, and the server takes turns between the clients at the head of the lanes.
+ */
+enum lane_e {
+	LANE_INTERACTIVE, ///< Lane of requests on the data of a session, which are cheap and latency-sensitive.
+	LANE_BULK ///< Lane of registrations, logins, resumptions and scans, which check credentials or walk the database.
+};
+
+/**
+ * @brief Enum for secret transfer modes.
+ */
+enum transfer_e {
+	TRANSFER_SHM, ///< The secret is transferred inline or through the data arena.
+	TRANSFER_MEMFD ///< The secret is transferred as sealed memory file descriptor over `FD_SOCKET_NAME`.
+};
+
+/**
+ * @brief Enum for the targets of a scan.
+ */
+enum scan_e {
+	SCAN_USERS, ///< Scan the usernames of all users.
+	SCAN_KEYS ///< Scan the names of the secrets of the user.
 };
 
 /**
@@ -85,7 +218,14 @@ enum packet_e {
 	LOGIN, ///< Packet to perform login of a user.
 	LOGOUT, ///< Packet to perform logout of a user.
 	SECRET_WRITE, ///< Packet to write a new secret to the database.
-	SECRET_READ ///< Packet to read the stored secret.
+	SECRET_READ, ///< Packet to read the stored secret.
+	RESUME, ///< Packet to resume a session using a resumption token.
+	KEY_WRITE, ///< Packet to write a named secret to the database.
+	KEY_READ, ///< Packet to read a named secret.
+	KEY_DELETE, ///< Packet to delete a named secret.
+	SCAN, ///< Packet to read a page of usernames or names of secrets.
+	SECRET_WRITE_IF, ///< Packet to write a new secret to the database, if it still has a given version.
+	WATCH ///< Packet to set up a watch for changes of the secret.
 };
 
 /**
@@ -96,6 +236,7 @@ struct packet_generic {
 	enum server_status_e status; ///< Current server status.
 	enum request_status_e rstatus; ///< Current request status.
 	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
 };
 
 /**
@@ -105,6 +246,7 @@ struct packet_registration {
 	enum server_status_e status; ///< Current server status.
 	enum request_status_e rstatus; ///< Current request status.
 	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
 	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
 	char password[MAX_PASSWORD_LEN + 1]; ///< Password of the user.
 };
@@ -116,8 +258,26 @@ struct packet_login {
 	enum server_status_e status; ///< Current server status.
 	enum request_status_e rstatus; ///< Current request status.
 	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
 	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
 	char password[MAX_PASSWORD_LEN + 1]; ///< Password of the user.
+	pid_t pid; ///< Process id of the client, which owns the session and is used to limit its rate of logins. Replaced by the peer credentials over the socket transport.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
+	char token[TOKEN_SIZE + 1]; ///< Resumption token issued to the client.
+};
+
+/**
+ * @brief Packet to resume a session of a user.
+ * @details The token must have been issued on a previous login of the same user.
+ */
+struct packet_resume {
+	enum server_status_e status; ///< Current server status.
+	enum request_status_e rstatus; ///< Current request status.
+	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
+	char token[TOKEN_SIZE + 1]; ///< Resumption token of the user.
+	pid_t pid; ///< Process id of the client, which owns the session.
 	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
 };
 
@@ -128,20 +288,29 @@ struct packet_logout {
 	enum server_status_e status; ///< Current server status.
 	enum request_status_e rstatus; ///< Current request status.
 	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
 	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
 	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
 };
 
 /**
  * @brief Packet to write a new secret to the database.
+ * @details Used for both `SECRET_WRITE` and `SECRET_WRITE_IF` packets.
  */
 struct packet_secret_write {
 	enum server_status_e status; ///< Current server status.
 	enum request_status_e rstatus; ///< Current request status.
 	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
 	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
 	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
-	char secret[MAX_SECRET_LEN + 1]; ///< Secret to write to the database.
+	pid_t pid; ///< Process id of the client, used to authenticate descriptor passing.
+	enum transfer_e transfer; ///< Transfer mode of the secret.
+	uint64_t version; ///< Version the secret must have for a `SECRET_WRITE_IF` packet. Set to the new version on success, and to the current version on a conflict.
+	uint32_t ttl; ///< Lifetime of the secret in seconds, `0` if it does not expire.
+	uint32_t secret_len; ///< Length of the secret.
+	uint32_t secret_offset; ///< Offset of the secret in the shared memory, if it does not fit inline.
+	char secret[MAX_SECRET_LEN + 1]; ///< Secret to write to the database, if it fits inline.
 };
 
 /**
@@ -151,9 +320,130 @@ struct packet_secret_read {
 	enum server_status_e status; ///< Current server status.
 	enum request_status_e rstatus; ///< Current request status.
 	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
+	pid_t pid; ///< Process id of the client, used to authenticate descriptor passing.
+	enum transfer_e transfer; ///< Transfer mode of the secret. Set by the client to accept a descriptor, and by the server if it sends one.
+	uint64_t version; ///< Version of the secret.
+	uint32_t expires; ///< Time in seconds since the epoch at which the secret expires, `0` if it does not.
+	uint32_t bucket; ///< Bucket of the watch table of the user.
+	uint32_t sequence; ///< Value of the counter of the bucket when the secret was read, which changes with the secret.
+	uint32_t staleness; ///< Age in milliseconds of the copy of the database a replica read the secret from, `0` if read by the server.
+	uint32_t secret_len; ///< Length of the secret.
+	uint32_t secret_offset; ///< Offset of the secret in the shared memory, if it does not fit inline.
+	char secret[MAX_SECRET_LEN + 1]; ///< Secret read from the database, if it fits inline.
+};
+
+/**
+ * @brief Packet to write a named secret to the database.
+ * @details Long values are transferred like long secrets of a `packet_secret_write`.
+ */
+struct packet_key_write {
+	enum server_status_e status; ///< Current server status.
+	enum request_status_e rstatus; ///< Current request status.
+	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
+	char key[MAX_KEY_LEN + 1]; ///< Name of the secret.
+	uint32_t secret_len; ///< Length of the secret.
+	uint32_t secret_offset; ///< Offset of the secret in the shared memory, if it does not fit inline.
+	char secret[MAX_SECRET_LEN + 1]; ///< Secret to write to the database, if it fits inline.
+};
+
+/**
+ * @brief Packet to read a named secret.
+ * @details Long values are transferred like long secrets of a `packet_secret_read`.
+ */
+struct packet_key_read {
+	enum server_status_e status; ///< Current server status.
+	enum request_status_e rstatus; ///< Current request status.
+	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
+	char key[MAX_KEY_LEN + 1]; ///< Name of the secret.
+	uint32_t secret_len; ///< Length of the secret.
+	uint32_t secret_offset; ///< Offset of the secret in the shared memory, if it does not fit inline.
+	char secret[MAX_SECRET_LEN + 1]; ///< Secret read from the database, if it fits inline.
+};
+
+/**
+ * @brief Packet to delete a named secret.
+ */
+struct packet_key_delete {
+	enum server_status_e status; ///< Current server status.
+	enum request_status_e rstatus; ///< Current request status.
+	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
 	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
 	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
-	char secret[MAX_SECRET_LEN + 1]; ///< Secret read from the database.
+	char key[MAX_KEY_LEN + 1]; ///< Name of the secret.
 };
 
+/**
+ * @brief Packet to read a page of usernames or names of secrets.
+ * @details Names are returned in bytewise order. The cursor is opaque to the client. An empty cursor starts a new scan, and the server returns the cursor of the next page, which is empty after the last page.
+ */
+struct packet_scan {
+	enum server_status_e status; ///< Current server status.
+	enum request_status_e rstatus; ///< Current request status.
+	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
+	enum scan_e target; ///< What to scan.
+	uint32_t limit; ///< Maximum number of names to return, at most `SCAN_PAGE_SIZE`.
+	char cursor[MAX_CURSOR_LEN + 1]; ///< Position of the page to read.
+	uint32_t count; ///< Number of names returned.
+	char names[SCAN_PAGE_SIZE][MAX_CURSOR_LEN + 1]; ///< Names returned.
+};
+
+/**
+ * @brief Packet to set up a watch for changes of the secret.
+ * @details If the secret still has the given version, the server returns the bucket of the watch table to wait on, and the value its counter had when the version was checked. Otherwise, the status is `CONFLICT` and the packet carries the current version.
+ */
+struct packet_watch {
+	enum server_status_e status; ///< Current server status.
+	enum request_status_e rstatus; ///< Current request status.
+	enum packet_e type; ///< Type of the packet.
+	uint64_t deadline; ///< Time in milliseconds, as returned by `clock_ms()`, after which the response is of no use to the client anymore, `0` if there is no such time.
+	char session_id[SESSION_ID_SIZE + 1]; ///< Session id of the client.
+	char username[MAX_USERNAME_LEN + 1]; ///< Username of the user.
+	uint64_t version; ///< Version of the secret known to the client.
+	uint32_t bucket; ///< Bucket of the watch table to wait on.
+	uint32_t sequence; ///< Value of the counter of the bucket.
+};
+
+/**
+ * @brief Union of all packets.
+ * @details Used to determine the size of the packet area of the shared memory.
+ */
+union packet_u {
+	struct packet_generic generic; ///< Generic packet.
+	struct packet_registration registration; ///< Registration packet.
+	struct packet_login login; ///< Login packet.
+	struct packet_resume resume; ///< Resume packet.
+	struct packet_logout logout; ///< Logout packet.
+	struct packet_secret_write secret_write; ///< Secret write packet.
+	struct packet_secret_read secret_read; ///< Secret read packet.
+	struct packet_key_write key_write; ///< Key write packet.
+	struct packet_key_read key_read; ///< Key read packet.
+	struct packet_key_delete key_delete; ///< Key delete packet.
+	struct packet_scan scan; ///< Scan packet.
+	struct packet_watch watch; ///< Watch packet.
+};
+
+/**
+ * @brief The size of the packet area of the shared memory.
+ */
+#define SHM_LEN (sizeof(union packet_u))
+
+/**
+ * @brief The offset of the data arena in the shared memory.
+ * @details The arena follows the packet area and extends to the end of the shared memory. It holds secrets that do not fit inline, followed by a null byte.
+ */
+#define SHM_ARENA_OFFSET ((SHM_LEN + 63) & ~(size_t) 63)
+
 #endif
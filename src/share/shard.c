@@ -0,0 +1,215 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for sharding users across several servers.
+ * @details The description of the cluster holds the number of shards and the process id of the server of every shard. It is created by the first server and removed by the last one, and a description left behind by servers that are gone is ignored by clients and replaced by servers.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shard.h"
+#include "utils.h"
+
+/**
+ * @brief The maximum number of names of resources of a shard.
+ */
+#define SHARD_NAMES 32
+
+/**
+ * @brief The maximum length of a name of a resource of a shard.
+ */
+#define SHARD_NAME_LEN 64
+
+/**
+ * @brief The description of the cluster.
+ */
+typedef struct {
+	uint32_t count; ///< The number of shards, `0` while the description is created.
+	pid_t servers[MAX_SHARDS]; ///< Process id of the server of every shard, `0` if none.
+} cluster_t;
+
+/**
+ * @brief A name of a resource of the selected shard.
+ */
+typedef struct {
+	char base[SHARD_NAME_LEN]; ///< The name without shards.
+	char name[SHARD_NAME_LEN]; ///< The name of the shard.
+} shard_name_t;
+
+/**
+ * @brief The index of the selected shard.
+ */
+static unsigned shard_index = 0;
+
+/**
+ * @brief The number of shards.
+ */
+static unsigned shard_count = 1;
+
+/**
+ * @brief The names determined so far.
+ */
+static shard_name_t shard_names[SHARD_NAMES];
+
+/**
+ * @brief The description of the cluster, if the server joined it.
+ */
+static cluster_t *cluster = NULL;
+
+/**
+ * @brief Check if any server of the cluster is alive.
+ * @param c The description of the cluster.
+ * @return `true` if a server is alive, `false` otherwise.
+ */
+static bool cluster_alive(cluster_t *c)
+{
+	for (unsigned i = 0; i < MAX_SHARDS; i++) {
+		pid_t pid = __atomic_load_n(&c->servers[i], __ATOMIC_ACQUIRE);
+
+		if (pid != 0 && (kill(pid, 0) == 0 || errno == EPERM))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Map the description of the cluster.
+ * @param create Whether to create the description writable or to open it read-only.
+ * @return The description, or `NULL` on failure.
+ */
+static cluster_t *cluster_map(bool create)
+{
+	int fd = shm_open(CLUSTER_SHM_NAME, create ? O_RDWR | O_CREAT : O_RDONLY, 0640);
+	if (fd == -1)
+		return NULL;
+
+	// the description is zeroed when it is created
+	struct stat st;
+	if (fstat(fd, &st) == -1 ||
+		(create && st.st_size < (off_t) sizeof(cluster_t) && ftruncate(fd, sizeof(cluster_t)) == -1) ||
+		(!create && st.st_size < (off_t) sizeof(cluster_t))) {
+		close(fd);
+		return NULL;
+	}
+
+	int prot = create ? PROT_READ | PROT_WRITE : PROT_READ;
+	cluster_t *c = mmap(NULL, sizeof(cluster_t), prot, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return c == MAP_FAILED ? NULL : c;
+}
+
+void shard_select(unsigned index, unsigned count)
+{
+	shard_index = index;
+	shard_count = count;
+}
+
+char *shard_name(const char *base)
+{
+	size_t i = 0;
+
+	for (; i < SHARD_NAMES && shard_names[i].base[0] != '\0'; i++) {
+		if (strcmp(shard_names[i].base, base) == 0)
+			return shard_names[i].name;
+	}
+
+	if (i == SHARD_NAMES || strlen(base) >= SHARD_NAME_LEN)
+		print_error_plain_exit("too many or too long names of shared resources");
+
+	strcpy(shard_names[i].base, base);
+
+	if (shard_count > 1)
+		snprintf(shard_names[i].name, SHARD_NAME_LEN, "%s_shard%u", base, shard_index);
+	else
+		strcpy(shard_names[i].name, base);
+
+	return shard_names[i].name;
+}
+
+unsigned shard_of(const char *username, unsigned count)
+{
+	uint32_t hash = 2166136261u;
+
+	for (const char *c = username; *c != '\0'; c++) {
+		hash ^= (unsigned char) *c;
+		hash *= 16777619u;
+	}
+
+	return hash % count;
+}
+
+bool shard_owns(const char *username)
+{
+	return shard_count <= 1 || shard_of(username, shard_count) == shard_index;
+}
+
+unsigned cluster_shards(void)
+{
+	cluster_t *c = cluster_map(false);
+	if (c == NULL)
+		return 1;
+
+	unsigned count = __atomic_load_n(&c->count, __ATOMIC_ACQUIRE);
+	if (count == 0 || count > MAX_SHARDS || !cluster_alive(c))
+		count = 1;
+
+	munmap(c, sizeof(cluster_t));
+	return count;
+}
+
+int cluster_join(void)
+{
+	if (shard_count <= 1)
+		return 0;
+
+	cluster_t *c = cluster_map(true);
+	if (c == NULL)
+		return -1;
+
+	uint32_t count = 0;
+	if (!__atomic_compare_exchange_n(&c->count, &count, shard_count, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) &&
+		count != shard_count) {
+		if (cluster_alive(c)) {
+			munmap(c, sizeof(cluster_t));
+			return -2;
+		}
+
+		// the servers of a previous cluster are gone
+		for (unsigned i = 0; i < MAX_SHARDS; i++)
+			__atomic_store_n(&c->servers[i], 0, __ATOMIC_RELEASE);
+
+		__atomic_store_n(&c->count, shard_count, __ATOMIC_RELEASE);
+	}
+
+	__atomic_store_n(&c->servers[shard_index], getpid(), __ATOMIC_RELEASE);
+	cluster = c;
+	return 0;
+}
+
+void cluster_leave(void)
+{
+	if (cluster == NULL)
+		return;
+
+	// a server that took over on a handover has replaced the process id already
+	pid_t self = getpid();
+	__atomic_compare_exchange_n(&cluster->servers[shard_index], &self, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+
+	if (!cluster_alive(cluster))
+		shm_unlink(CLUSTER_SHM_NAME);
+
+	munmap(cluster, sizeof(cluster_t));
+	cluster = NULL;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for sharding users across several servers.
+ * @details Every server of a cluster owns the users whose username hashes to its shard, and serves them under its own names of the shared memory, the semaphores and the sockets, which carry the suffix of the shard. The servers of a cluster announce the number of shards in the shared memory `CLUSTER_SHM_NAME`, from which clients learn where to send their requests.
+ */
+
+#ifndef __SHARD_H_SHARE__
+#define __SHARD_H_SHARE__
+
+#include <stdbool.h>
+
+/**
+ * @brief The name of the shared memory describing the cluster.
+ */
+#define CLUSTER_SHM_NAME "authme_cluster"
+
+/**
+ * @brief The maximum number of shards of a cluster.
+ */
+#define MAX_SHARDS 64
+
+/**
+ * @brief Select the shard of this process.
+ * @details Names returned by `shard_name()` refer to the shard from then on. With a single shard, names are not changed.
+ * @param index The index of the shard.
+ * @param count The number of shards.
+ */
+void shard_select(unsigned index, unsigned count);
+
+/**
+ * @brief Determine the name of a resource of the selected shard.
+ * @param base The name of the resource without shards.
+ * @return The name, which stays valid until the program terminates.
+ */
+char *shard_name(const char *base);
+
+/**
+ * @brief Determine the shard a user belongs to.
+ * @details The username is hashed with FNV-1a, which gives the same result in every process.
+ * @param username The username to consider.
+ * @param count The number of shards.
+ * @return The index of the shard.
+ */
+unsigned shard_of(const char *username, unsigned count);
+
+/**
+ * @brief Check if a user belongs to the selected shard.
+ * @param username The username to consider.
+ * @return `true` if the user belongs to the shard, or if there is a single shard, `false` otherwise.
+ */
+bool shard_owns(const char *username);
+
+/**
+ * @brief Retrieve the number of shards of the running cluster.
+ * @details A cluster none of whose servers is alive anymore is not considered.
+ * @return The number of shards, or `1` if no cluster is running.
+ */
+unsigned cluster_shards(void);
+
+/**
+ * @brief Announce the server of the selected shard in the cluster.
+ * @details Nothing is announced with a single shard.
+ * @return `0` on success, `-1` on failure, or `-2` if the running cluster has a different number of shards.
+ */
+int cluster_join(void);
+
+/**
+ * @brief Withdraw the server from the cluster.
+ * @details The description of the cluster is removed once the last server withdrew. A server that was replaced by another one on a handover does not withdraw the new one.
+ */
+void cluster_leave(void);
+
+#endif
@@ -19,19 +19,26 @@
  */
 extern void *shmem;
 
-int create_shared_memory(char *name, size_t len, bool master)
+int create_shared_memory(char *name, size_t *len, bool master)
 {
 	int fd = shm_open(name, O_RDWR | O_CREAT, 0640);
 	if (fd == -1)
 		return -1;
 
 	if (master) {
-		int errind = ftruncate(fd, len);
+		int errind = ftruncate(fd, *len);
 		if (errind == -1)
 			return -2;
+	} else {
+		struct stat st;
+		int errind = fstat(fd, &st);
+		if (errind == -1)
+			return -2;
+
+		*len = st.st_size;
 	}
 
-	shmem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	shmem = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 	if (shmem == MAP_FAILED) {
 		return -3;
 	}
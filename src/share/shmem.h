@@ -16,11 +16,11 @@
  * @brief Function to create and set up shared memory.
  * @details This function uses the global variable `shmem` as memory pointer.
  * @param name Filename of the shared memory.
- * @param len Size of the memory to create.
+ * @param len Size of the memory to create. If not `master`, the size of the existing memory is stored here instead.
  * @param master Specifies whether to truncate the memory or not.
  * @return File descriptor or negative value in case of error.
  */
-int create_shared_memory(char *name, size_t len, bool master);
+int create_shared_memory(char *name, size_t *len, bool master);
 
 /**
  * @brief Function to close an clean up a shared memory.
@@ -11,6 +11,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
 
 #include "utils.h"
 
@@ -69,6 +70,55 @@ int sem_wait_exit(sem_t *sem, bool error_only)
 	return 0;
 }
 
+uint64_t clock_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t clock_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void deadline_after(struct timespec *deadline, long timeout_ms)
+{
+	clock_gettime(CLOCK_REALTIME, deadline);
+
+	deadline->tv_sec += timeout_ms / 1000;
+	deadline->tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec += 1;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+int sem_timedwait_exit(sem_t *sem, int timeout_ms)
+{
+	struct timespec deadline;
+	deadline_after(&deadline, timeout_ms);
+
+	int errind = sem_timedwait(sem, &deadline);
+
+	if (errind != 0) {
+		switch (errno) {
+		case EINTR:
+			return 1;
+		case ETIMEDOUT:
+			return 2;
+		default:
+			print_error_exit("failed waiting for semaphore");
+		}
+	}
+
+	return 0;
+}
+
 void sem_settle(sem_t *sem)
 {
 	int errind, sval;
@@ -11,7 +11,9 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
+#include <time.h>
 #include <semaphore.h>
 
 /**
@@ -45,6 +47,35 @@ void sem_cleanup(sem_t *sem, char *sem_path);
  */
 int sem_wait_exit(sem_t *sem, bool error_only);
 
+/**
+ * @brief Retrieve the current time, which is shared by all processes.
+ * @return The time in milliseconds.
+ */
+uint64_t clock_ms(void);
+
+/**
+ * @brief Retrieve the current time with a finer resolution, as measured by `clock_ms()`.
+ * @return The time in microseconds.
+ */
+uint64_t clock_us(void);
+
+/**
+ * @brief Determine the point in time `timeout_ms` milliseconds from now.
+ * @details The point in time is measured by `CLOCK_REALTIME`, as expected by `sem_timedwait()`.
+ * @param deadline Set to the point in time.
+ * @param timeout_ms The number of milliseconds from now.
+ */
+void deadline_after(struct timespec *deadline, long timeout_ms);
+
+/**
+ * @brief Wait for semaphore `sem` for at most `timeout_ms` milliseconds and exit, if an error occures.
+ * @details When exiting, an error message will be printed to `stderr`. This function makes use of the global variable `progname` in order to print the program name along with the error message. A signal interruption is not treated as error.
+ * @param sem Semaphore to wait for.
+ * @param timeout_ms Maximum time to wait in milliseconds.
+ * @return `0` on success, `1` if interrupted by a signal, `2` if the time ran out.
+ */
+int sem_timedwait_exit(sem_t *sem, int timeout_ms);
+
 /**
  * @brief Settle a semaphore.
  * @details This function posts as many times as needed in order for the semaphore value to become positive.
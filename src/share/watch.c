@@ -0,0 +1,78 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function definitions for the watch table.
+ * @details The watch table is a shared memory of counters, each used as futex word. The server increments the counter of a bucket whenever the secret of a user hashed to it changes, and wakes the clients waiting on it. Clients map the table read-only.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "watch.h"
+#include "protocol.h"
+#include "shard.h"
+
+/**
+ * @brief The size of the watch table.
+ */
+#define WATCH_LEN (WATCH_BUCKETS * sizeof(uint32_t))
+
+uint32_t *watch_open(bool master)
+{
+	int fd = shm_open(shard_name(WATCH_SHM_NAME), master ? O_RDWR | O_CREAT : O_RDONLY, 0640);
+	if (fd == -1)
+		return NULL;
+
+	if (master && ftruncate(fd, WATCH_LEN) == -1) {
+		close(fd);
+		return NULL;
+	}
+
+	int prot = master ? PROT_READ | PROT_WRITE : PROT_READ;
+	uint32_t *table = mmap(NULL, WATCH_LEN, prot, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (table == MAP_FAILED)
+		return NULL;
+
+	return table;
+}
+
+void watch_close(uint32_t *table, bool master)
+{
+	if (table != NULL)
+		munmap(table, WATCH_LEN);
+
+	if (master)
+		shm_unlink(shard_name(WATCH_SHM_NAME));
+}
+
+void watch_notify(uint32_t *word)
+{
+	__atomic_add_fetch(word, 1, __ATOMIC_RELEASE);
+	syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+int watch_wait(const uint32_t *word, uint32_t sequence, int timeout_ms)
+{
+	struct timespec timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+	if (syscall(SYS_futex, word, FUTEX_WAIT, sequence, &timeout, NULL, 0) == 0)
+		return 0;
+
+	// the counter changed before the client went to sleep
+	if (errno == EAGAIN)
+		return 0;
+
+	return -1;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @author eikendev, https://eiken.dev/
+ * @date 2018-01-04
+ * @brief This module contains function declarations for the watch table.
+ * @details The watch table is a shared memory of counters, each used as futex word. The server increments the counter of a bucket whenever the secret of a user hashed to it changes, and wakes the clients waiting on it. Clients map the table read-only.
+ */
+
+#ifndef __WATCH_H_SHARE__
+#define __WATCH_H_SHARE__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Map the watch table.
+ * @param master Specifies whether to create the table writable or to open it read-only.
+ * @return The table, or `NULL` on failure.
+ */
+uint32_t *watch_open(bool master);
+
+/**
+ * @brief Unmap the watch table.
+ * @param table The table to unmap.
+ * @param master Specifies whether to unlink the table or not.
+ */
+void watch_close(uint32_t *table, bool master);
+
+/**
+ * @brief Increment the counter `word` and wake all clients waiting on it.
+ * @param word The counter of the bucket.
+ */
+void watch_notify(uint32_t *word);
+
+/**
+ * @brief Wait for the counter `word` to change.
+ * @details Returns immediately if the counter does not equal `sequence` anymore.
+ * @param word The counter of the bucket.
+ * @param sequence The value of the counter when the watch was set up.
+ * @param timeout_ms Maximum time to wait in milliseconds.
+ * @return `0` if woken up or if the counter changed, `-1` otherwise, with `errno` set.
+ */
+int watch_wait(const uint32_t *word, uint32_t sequence, int timeout_ms);
+
+#endif